@@ -0,0 +1,432 @@
+/*
+ * Copyright (c) 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <debug.h>
+#include <string.h>
+#include <malloc.h>
+#include <app/tests.h>
+#include <compiler.h>
+#include <kernel/thread.h>
+#include <lib/arena.h>
+#include <lib/heap.h>
+#include <lib/kmem_cache.h>
+#include <lib/page_alloc.h>
+#include <platform.h>
+
+#define CACHE_OBJECTS 200
+#define BENCH_ITERATIONS 10000
+
+struct cache_test_obj {
+	uint32_t cookie;
+	uint32_t serial;
+	uint8_t payload[40];
+};
+
+#define COOKIE 0x6b6d656d
+
+static uint ctor_calls;
+
+static void cache_test_ctor(void *_obj)
+{
+	struct cache_test_obj *obj = _obj;
+
+	obj->cookie = COOKIE;
+	ctor_calls++;
+}
+
+static void kmem_cache_test(void)
+{
+	kmem_cache_t cache;
+	struct cache_test_obj *objs[CACHE_OBJECTS];
+	uint errors = 0;
+	uint i, j;
+
+	printf("testing kmem_cache\n");
+
+	kmem_cache_init(&cache, "test", sizeof(struct cache_test_obj), 16, &cache_test_ctor);
+	ctor_calls = 0;
+
+	for (i = 0; i < CACHE_OBJECTS; i++) {
+		objs[i] = kmem_cache_alloc(&cache);
+		if (!objs[i]) {
+			printf("kmem_cache_alloc failed after %u objects\n", i);
+			errors++;
+			break;
+		}
+		if (((addr_t)objs[i] & 15) != 0 || objs[i]->cookie != COOKIE)
+			errors++;
+		objs[i]->serial = i;
+		memset(objs[i]->payload, i, sizeof(objs[i]->payload));
+	}
+	printf("allocated %u objects in %u slabs, %u constructor calls\n", i, cache.slabs, ctor_calls);
+
+	/* nobody stepped on anybody else */
+	for (j = 0; j < i; j++) {
+		if (objs[j]->serial != j || objs[j]->payload[sizeof(objs[j]->payload) - 1] != (uint8_t)j)
+			errors++;
+	}
+
+	/* free every other object and get them back, the constructor shouldn't run again */
+	uint ctor_before = ctor_calls;
+	for (j = 0; j < i; j += 2)
+		kmem_cache_free(&cache, objs[j]);
+	for (j = 0; j < i; j += 2) {
+		objs[j] = kmem_cache_alloc(&cache);
+		if (!objs[j] || objs[j]->cookie != COOKIE)
+			errors++;
+	}
+	if (ctor_calls != ctor_before)
+		errors++;
+
+	for (j = 0; j < i; j++)
+		kmem_cache_free(&cache, objs[j]);
+
+	kmem_cache_dump();
+
+	if (cache.active != 0 || cache.slabs > 1)
+		errors++;
+
+	/* compare a tight alloc/free loop against the heap */
+	bigtime_t t = current_time_hires();
+	for (j = 0; j < BENCH_ITERATIONS; j++)
+		kmem_cache_free(&cache, kmem_cache_alloc(&cache));
+	bigtime_t cache_time = current_time_hires() - t;
+
+	t = current_time_hires();
+	for (j = 0; j < BENCH_ITERATIONS; j++)
+		free(malloc(sizeof(struct cache_test_obj)));
+	bigtime_t heap_time = current_time_hires() - t;
+
+	printf("%d alloc/free pairs: kmem_cache %llu usecs, heap %llu usecs\n",
+		BENCH_ITERATIONS, cache_time, heap_time);
+
+	kmem_cache_destroy(&cache);
+
+	printf("kmem_cache test: %u errors\n", errors);
+}
+
+static bool check_pattern(const uint8_t *buf, size_t len, uint8_t seed)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		if (buf[i] != (uint8_t)(seed + i))
+			return false;
+	}
+	return true;
+}
+
+static void fill_pattern(uint8_t *buf, size_t len, uint8_t seed)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = (uint8_t)(seed + i);
+}
+
+static void realloc_test(void)
+{
+	uint8_t *a, *b, *p;
+	uint errors = 0;
+
+	printf("testing realloc\n");
+
+	/* shrinking splits the tail off in place */
+	a = malloc(2048);
+	fill_pattern(a, 2048, 1);
+	p = realloc(a, 128);
+	printf("shrink 2048 -> 128: %s (should be in place)\n", (p == a) ? "in place" : "moved");
+	if (p != a || !check_pattern(p, 128, 1))
+		errors++;
+
+	/* which leaves a free chunk right behind it to grow back into */
+	a = p;
+	p = realloc(a, 1024);
+	printf("grow 128 -> 1024: %s (should be in place)\n", (p == a) ? "in place" : "moved");
+	if (p != a || !check_pattern(p, 128, 1))
+		errors++;
+	free(p);
+
+	/* with the neighbor in use it has to move, and only the old size is copied */
+	a = malloc(256);
+	b = malloc(256);
+	fill_pattern(a, 256, 2);
+	p = realloc(a, 65536);
+	printf("grow 256 -> 65536 with a busy neighbor: %s (should be moved)\n", (p == a) ? "in place" : "moved");
+	if (!p || !check_pattern(p, 256, 2))
+		errors++;
+	free(p);
+	free(b);
+
+	/* the usual corner cases */
+	p = realloc(NULL, 32);
+	if (!p)
+		errors++;
+	if (realloc(p, 0) != NULL)
+		errors++;
+
+	printf("realloc test: %u errors\n", errors);
+}
+
+static uint8_t fast_region[4 * PAGE_SIZE] __ALIGNED(PAGE_SIZE);
+
+static void region_test(void)
+{
+	static bool region_added;
+	uint errors = 0;
+
+	printf("testing heap regions\n");
+
+	/* regions can't be taken away again, only add it the first time through */
+	if (!region_added) {
+		if (heap_add_region(fast_region, sizeof(fast_region), HEAP_REGION_FAST) < 0) {
+			printf("failed to add test region\n");
+			return;
+		}
+		region_added = true;
+	}
+
+	addr_t start = (addr_t)fast_region;
+	addr_t end = start + sizeof(fast_region);
+#define IN_FAST_REGION(p) ((addr_t)(p) >= start && (addr_t)(p) < end)
+
+	void *fast = heap_alloc_etc(64, 0, HEAP_REGION_FAST);
+	void *plain = heap_alloc(64, 0);
+	void *dma = heap_alloc_etc(64, 0, HEAP_REGION_DMA | HEAP_REGION_FAST);
+
+	printf("fast hint %p: %s (should be fast)\n", fast, IN_FAST_REGION(fast) ? "fast" : "not fast");
+	printf("no hint %p: %s (should not be fast)\n", plain, IN_FAST_REGION(plain) ? "fast" : "not fast");
+	printf("fast dma hint %p: %s (should not be fast)\n", dma, IN_FAST_REGION(dma) ? "fast" : "not fast");
+
+	if (!IN_FAST_REGION(fast) || IN_FAST_REGION(plain) || IN_FAST_REGION(dma))
+		errors++;
+
+	/* a fast request that doesn't fit spills over into other memory */
+	void *big = heap_alloc_etc(sizeof(fast_region), 0, HEAP_REGION_FAST);
+	if (!big || IN_FAST_REGION(big))
+		errors++;
+
+	free(fast);
+	free(plain);
+	free(dma);
+	free(big);
+#undef IN_FAST_REGION
+
+	printf("region test: %u errors\n", errors);
+}
+
+static void page_test(void)
+{
+	uint errors = 0;
+
+	printf("testing page allocations\n");
+
+	/* strict alignment comes for free from the page allocator */
+	void *fb = memalign(65536, 65536);
+	printf("64KB aligned 64KB buffer at %p, block size %zu (should be 65536)\n", fb, page_alloc_size(fb));
+	if (!fb || ((addr_t)fb & 0xffff) != 0 || page_alloc_size(fb) != 65536)
+		errors++;
+
+	/* sizes round up to a power of two pages */
+	uint8_t *buf = malloc(3 * PAGE_SIZE);
+	fill_pattern(buf, 3 * PAGE_SIZE, 3);
+	if (page_alloc_size(buf) != 4 * PAGE_SIZE)
+		errors++;
+
+	/* which leaves room to grow into without moving */
+	uint8_t *p = realloc(buf, 4 * PAGE_SIZE);
+	printf("grow 3 -> 4 pages: %s (should be in place)\n", (p == buf) ? "in place" : "moved");
+	if (p != buf || !check_pattern(p, 3 * PAGE_SIZE, 3))
+		errors++;
+
+	/* and shrinking a lot moves it into a smaller block */
+	buf = realloc(p, 100);
+	if (!buf || page_alloc_size(buf) != 0 || !check_pattern(buf, 100, 3))
+		errors++;
+
+	free(buf);
+	free(fb);
+
+	/*
+	 * aligned small allocations out of a pool can start right on one of the
+	 * pool's pages, and must still not be taken for a page allocation.
+	 */
+	void *aligned[64];
+	uint i;
+	for (i = 0; i < countof(aligned); i++) {
+		aligned[i] = memalign(2048, 100);
+		if (!aligned[i] || ((addr_t)aligned[i] & 2047) != 0 || page_alloc_size(aligned[i]) != 0)
+			errors++;
+	}
+	for (i = 0; i < countof(aligned); i++)
+		free(aligned[i]);
+
+	printf("page test: %u errors\n", errors);
+}
+
+static void stats_test(void)
+{
+	struct heap_stats before, during, after;
+	void *ptr[8];
+	uint errors = 0;
+	uint i;
+
+	printf("testing heap stats\n");
+
+	heap_get_stats(&before);
+	for (i = 0; i < countof(ptr); i++)
+		ptr[i] = malloc(100 + i * 1000);
+	heap_get_stats(&during);
+	for (i = 0; i < countof(ptr); i++)
+		free(ptr[i]);
+	heap_get_stats(&after);
+
+	printf("used %zu -> %zu -> %zu, free %zu -> %zu -> %zu\n",
+		before.used, during.used, after.used, before.free, during.free, after.free);
+	printf("largest free %zu, fragmentation %u%%\n", after.largest_free, after.fragmentation);
+
+	if (during.allocs - before.allocs < countof(ptr) || after.frees - during.frees < countof(ptr))
+		errors++;
+	if (during.used < before.used + 28000 || during.max_used < during.used)
+		errors++;
+	if (during.free >= before.free || after.largest_free > after.free || after.fragmentation > 100)
+		errors++;
+
+	/* freeing next to a free neighbour merges over the header, used must still come back down */
+	heap_get_stats(&before);
+	void *a = malloc(100);
+	void *b = malloc(100);
+	void *c = malloc(100);
+	free(b);
+	free(a);
+	free(c);
+	heap_get_stats(&after);
+
+	printf("used %zu -> %zu after freeing next to a free chunk\n", before.used, after.used);
+	if (after.used != before.used)
+		errors++;
+
+	/* nothing was written through a stale header on the way, so the pool still hands out memory */
+	void *a2 = malloc(100);
+	void *b2 = malloc(100);
+	void *c2 = malloc(100);
+	if (!a2 || !b2 || !c2)
+		errors++;
+	free(a2);
+	free(b2);
+	free(c2);
+
+	printf("stats test: %u errors\n", errors);
+}
+
+static void arena_test(void)
+{
+	arena_t arena;
+	uint8_t *a, *b, *c, *p;
+	struct heap_stats before, after;
+	uint errors = 0;
+	uint i;
+
+	printf("testing arenas\n");
+
+	arena_init(&arena, 1024);
+
+	/* allocations are aligned and packed one after the other */
+	a = arena_alloc(&arena, 3);
+	b = arena_alloc(&arena, 100);
+	if (!a || !b || ((addr_t)a % ARENA_ALIGN) || ((addr_t)b % ARENA_ALIGN) || b != a + ARENA_ALIGN)
+		errors++;
+	fill_pattern(b, 100, 3);
+
+	/* resetting to a mark hands back exactly what came after it */
+	arena_mark_t mark = arena_mark(&arena);
+	for (i = 0; i < 20; i++)
+		arena_alloc(&arena, 200);
+	arena_mark_t inner = arena_mark(&arena);
+	c = arena_alloc(&arena, 4000);
+	printf("after 20 + 1 large allocations: %u chunks, %zu bytes used\n", arena.chunk_count, arena_used(&arena));
+	if (!c || arena.chunk_count < 5)
+		errors++;
+
+	arena_reset(&arena, inner);
+	arena_reset(&arena, mark);
+	p = arena_alloc(&arena, 100);
+	if (arena.chunk_count != 1 || p != b + 104 || !check_pattern(b, 100, 3))
+		errors++;
+
+	/* once warm, a mark/alloc/reset cycle never touches the heap */
+	mark = arena_mark(&arena);
+	arena_alloc(&arena, 900);
+	arena_reset(&arena, mark);
+
+	heap_get_stats(&before);
+	for (i = 0; i < BENCH_ITERATIONS; i++) {
+		mark = arena_mark(&arena);
+		arena_alloc(&arena, 900);
+		arena_reset(&arena, mark);
+	}
+	heap_get_stats(&after);
+	if (after.allocs != before.allocs)
+		errors++;
+
+	arena_destroy(&arena);
+	if (arena.chunk_count != 0 || arena_used(&arena) != 0 || arena.spare)
+		errors++;
+
+	/* the thread's scratch arena, the way the filesystem and console use it */
+	arena_t *scratch = thread_scratch_arena();
+	size_t used = arena_used(scratch);
+
+	bigtime_t t = current_time_hires();
+	for (i = 0; i < BENCH_ITERATIONS; i++) {
+		mark = arena_mark(scratch);
+		arena_alloc(scratch, 1024);
+		arena_reset(scratch, mark);
+	}
+	bigtime_t arena_time = current_time_hires() - t;
+
+	t = current_time_hires();
+	for (i = 0; i < BENCH_ITERATIONS; i++)
+		free(malloc(1024));
+	bigtime_t heap_time = current_time_hires() - t;
+
+	printf("%d 1k scratch buffers: arena %llu usecs, heap %llu usecs\n",
+		BENCH_ITERATIONS, arena_time, heap_time);
+
+	if (arena_used(scratch) != used)
+		errors++;
+
+	printf("arena test: %u errors\n", errors);
+}
+
+int heap_tests(void)
+{
+	kmem_cache_test();
+	realloc_test();
+	region_test();
+	page_test();
+	stats_test();
+	arena_test();
+
+	return 0;
+}
+
@@ -24,7 +24,12 @@
 #define __APP_TESTS_H
 
 int thread_tests(void);
+int thread_create_test(void);
 void printf_tests(void);
+int timer_tests(void);
+int lock_tests(void);
+int port_tests(void);
+int heap_tests(void);
 
 #endif
 
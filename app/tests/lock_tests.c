@@ -0,0 +1,316 @@
+/*
+ * Copyright (c) 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <debug.h>
+#include <rand.h>
+#include <string.h>
+#include <err.h>
+#include <app/tests.h>
+#include <kernel/thread.h>
+#include <kernel/mutex.h>
+#include <kernel/semaphore.h>
+#include <kernel/rwlock.h>
+#include <platform.h>
+#if WITH_LIB_BIO
+#include <lib/bio.h>
+#endif
+
+static semaphore_t sem;
+static volatile int sem_consumed;
+
+static int sem_consumer(void *arg)
+{
+	while (sem_wait(&sem) == NO_ERROR)
+		atomic_add(&sem_consumed, 1);
+
+	return 0;
+}
+
+static void semaphore_test(void)
+{
+	status_t err;
+	int i;
+
+	printf("testing semaphores\n");
+
+	sem_init(&sem, 2);
+
+	err = sem_trywait(&sem);
+	printf("sem_trywait with count 2 returns %d (should be %d)\n", err, NO_ERROR);
+	err = sem_trywait(&sem);
+	printf("sem_trywait with count 1 returns %d (should be %d)\n", err, NO_ERROR);
+	err = sem_trywait(&sem);
+	printf("sem_trywait with count 0 returns %d (should be %d)\n", err, ERR_TIMED_OUT);
+
+	bigtime_t t = current_time_hires();
+	err = sem_timedwait(&sem, 100);
+	t = current_time_hires() - t;
+	printf("sem_timedwait(100) returns %d (should be %d) after %llu usecs\n", err, ERR_TIMED_OUT, t);
+
+	sem_consumed = 0;
+	for (i = 0; i < 4; i++)
+		thread_resume(thread_create("sem consumer", &sem_consumer, NULL, DEFAULT_PRIORITY, DEFAULT_STACK_SIZE));
+	thread_sleep(10);
+
+	for (i = 0; i < 1000; i++)
+		sem_post(&sem, (i & 1) ? true : false);
+	thread_sleep(100);
+	printf("consumers took %d posts (should be 1000)\n", sem_consumed);
+
+	/* releases the consumers with ERR_OBJECT_DESTROYED */
+	sem_destroy(&sem);
+	thread_sleep(10);
+}
+
+static rwlock_t rw;
+static volatile int rw_readers_inside;
+static volatile int rw_max_readers_inside;
+static volatile int rw_writer_inside;
+static volatile int rw_errors;
+static volatile int rw_running;
+
+static int rwlock_tester(void *arg)
+{
+	int i;
+
+	for (i = 0; i < 2000; i++) {
+		if ((rand() % 16) == 0) {
+			rwlock_acquire_write(&rw);
+			if (rw_readers_inside != 0 || rw_writer_inside != 0)
+				rw_errors++;
+			rw_writer_inside = 1;
+			thread_yield();
+			rw_writer_inside = 0;
+			rwlock_release_write(&rw);
+		} else {
+			rwlock_acquire_read(&rw);
+			if (rw_writer_inside != 0)
+				rw_errors++;
+			int inside = atomic_add(&rw_readers_inside, 1) + 1;
+			if (inside > rw_max_readers_inside)
+				rw_max_readers_inside = inside;
+			thread_yield();
+			atomic_add(&rw_readers_inside, -1);
+			rwlock_release_read(&rw);
+		}
+	}
+
+	atomic_add(&rw_running, -1);
+
+	return 0;
+}
+
+static void rwlock_test(void)
+{
+	int i;
+
+	printf("testing reader-writer locks\n");
+
+	rwlock_init(&rw);
+	rw_readers_inside = 0;
+	rw_max_readers_inside = 0;
+	rw_writer_inside = 0;
+	rw_errors = 0;
+	rw_running = 5;
+
+	for (i = 0; i < 5; i++)
+		thread_resume(thread_create("rwlock tester", &rwlock_tester, NULL, DEFAULT_PRIORITY, DEFAULT_STACK_SIZE));
+
+	while (rw_running > 0)
+		thread_sleep(10);
+
+	printf("rwlock: %d exclusion errors (should be 0), up to %d readers inside at once\n",
+		rw_errors, rw_max_readers_inside);
+
+	/* a writer has to time out while a reader holds it */
+	rwlock_acquire_read(&rw);
+	status_t err = rwlock_acquire_write_timeout(&rw, 0);
+	printf("rwlock_acquire_write_timeout under a reader returns %d (should be %d)\n", err, ERR_TIMED_OUT);
+	rwlock_release_read(&rw);
+
+	rwlock_destroy(&rw);
+}
+
+/*
+ * lookup contention benchmark
+ *
+ * A table of named entries, looked up the way bio_open() walks the block
+ * device list. The lookup yields while holding the lock, standing in for
+ * being preempted or running on another cpu, which is when readers
+ * serialize behind a mutex.
+ */
+#define LOOKUP_ENTRIES 16
+#define LOOKUP_THREADS 4
+#define LOOKUP_ITERATIONS 1000
+
+static char lookup_names[LOOKUP_ENTRIES][16];
+static mutex_t lookup_mutex;
+static rwlock_t lookup_rwlock;
+static volatile int lookup_running;
+static volatile int lookup_found;
+
+static int lookup_find(const char *name)
+{
+	int i;
+
+	for (i = 0; i < LOOKUP_ENTRIES; i++) {
+		if (!strcmp(lookup_names[i], name))
+			return i;
+	}
+	return -1;
+}
+
+static int lookup_tester(void *arg)
+{
+	bool use_rwlock = (bool)(uintptr_t)arg;
+	int i;
+
+	for (i = 0; i < LOOKUP_ITERATIONS; i++) {
+		const char *name = lookup_names[i % LOOKUP_ENTRIES];
+
+		if (use_rwlock)
+			rwlock_acquire_read(&lookup_rwlock);
+		else
+			mutex_acquire(&lookup_mutex);
+
+		if (lookup_find(name) >= 0)
+			atomic_add(&lookup_found, 1);
+		thread_yield();
+
+		if (use_rwlock)
+			rwlock_release_read(&lookup_rwlock);
+		else
+			mutex_release(&lookup_mutex);
+	}
+
+	atomic_add(&lookup_running, -1);
+
+	return 0;
+}
+
+static bigtime_t lookup_run(bool use_rwlock)
+{
+	int i;
+
+	lookup_running = LOOKUP_THREADS;
+	lookup_found = 0;
+
+	bigtime_t t = current_time_hires();
+	for (i = 0; i < LOOKUP_THREADS; i++)
+		thread_resume(thread_create("lookup tester", &lookup_tester, (void *)(uintptr_t)use_rwlock, HIGH_PRIORITY, DEFAULT_STACK_SIZE));
+
+	while (lookup_running > 0)
+		thread_yield();
+	t = current_time_hires() - t;
+
+	if (lookup_found != LOOKUP_THREADS * LOOKUP_ITERATIONS)
+		printf("lookup: only found %d of %d names\n", lookup_found, LOOKUP_THREADS * LOOKUP_ITERATIONS);
+
+	return t;
+}
+
+#if WITH_LIB_BIO
+static uint8_t lookup_bdev_mem[LOOKUP_ENTRIES][512];
+
+static int bio_lookup_tester(void *arg)
+{
+	int i;
+
+	for (i = 0; i < LOOKUP_ITERATIONS; i++) {
+		bdev_t *dev = bio_open(lookup_names[i % LOOKUP_ENTRIES]);
+		if (dev) {
+			atomic_add(&lookup_found, 1);
+			bio_close(dev);
+		}
+		thread_yield();
+	}
+
+	atomic_add(&lookup_running, -1);
+
+	return 0;
+}
+
+static void bio_lookup_bench(void)
+{
+	int i;
+
+	for (i = 0; i < LOOKUP_ENTRIES; i++)
+		create_membdev(lookup_names[i], lookup_bdev_mem[i], sizeof(lookup_bdev_mem[i]));
+
+	lookup_running = LOOKUP_THREADS;
+	lookup_found = 0;
+
+	bigtime_t t = current_time_hires();
+	for (i = 0; i < LOOKUP_THREADS; i++)
+		thread_resume(thread_create("bio lookup tester", &bio_lookup_tester, NULL, HIGH_PRIORITY, DEFAULT_STACK_SIZE));
+
+	while (lookup_running > 0)
+		thread_yield();
+	t = current_time_hires() - t;
+
+	printf("bio_open: %d threads x %d lookups took %llu usecs, found %d\n",
+		LOOKUP_THREADS, LOOKUP_ITERATIONS, t, lookup_found);
+
+	for (i = 0; i < LOOKUP_ENTRIES; i++) {
+		bdev_t *dev = bio_open(lookup_names[i]);
+		if (dev) {
+			bio_unregister_device(dev);
+			bio_close(dev);
+		}
+	}
+}
+#endif
+
+static void lookup_bench(void)
+{
+	int i;
+
+	printf("benchmarking read-mostly lookups, %d threads x %d lookups\n", LOOKUP_THREADS, LOOKUP_ITERATIONS);
+
+	for (i = 0; i < LOOKUP_ENTRIES; i++)
+		snprintf(lookup_names[i], sizeof(lookup_names[i]), "locktest%d", i);
+
+	mutex_init(&lookup_mutex);
+	mutex_register(&lookup_mutex, "lookup bench");
+	rwlock_init(&lookup_rwlock);
+
+	bigtime_t mutex_time = lookup_run(false);
+	bigtime_t rwlock_time = lookup_run(true);
+
+	printf("mutex: %llu usecs, rwlock: %llu usecs\n", mutex_time, rwlock_time);
+
+	mutex_destroy(&lookup_mutex);
+	rwlock_destroy(&lookup_rwlock);
+
+#if WITH_LIB_BIO
+	bio_lookup_bench();
+#endif
+}
+
+int lock_tests(void)
+{
+	semaphore_test();
+	rwlock_test();
+	lookup_bench();
+
+	return 0;
+}
@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <debug.h>
+#include <string.h>
+#include <stdlib.h>
+#include <err.h>
+#include <app/tests.h>
+#include <kernel/thread.h>
+#include <kernel/event.h>
+#include <kernel/port.h>
+#include <lib/cbuf.h>
+#include <platform.h>
+
+#define MSG_SIZE 256
+#define MSG_COUNT 16
+#define BENCH_MESSAGES 20000
+
+static void print_port_stats(const char *name, port_t *p)
+{
+	struct port_stats stats;
+
+	port_get_stats(p, &stats);
+	printf("%s: depth %u max %u sent %u received %u dropped %u\n",
+		name, stats.depth, stats.max_depth, stats.sent, stats.received, stats.dropped);
+}
+
+static void port_basic_test(void)
+{
+	port_t p;
+	void *ring[2];
+	void *msg;
+	status_t err;
+
+	printf("testing ports\n");
+
+	port_init(&p, ring, countof(ring));
+
+	err = port_receive(&p, &msg, 0);
+	printf("port_receive on an empty port returns %d (should be %d)\n", err, ERR_TIMED_OUT);
+
+	port_send(&p, (void *)1, 0);
+	port_send(&p, (void *)2, 0);
+	err = port_send(&p, (void *)3, 0);
+	printf("port_send on a full port returns %d (should be %d)\n", err, ERR_TIMED_OUT);
+
+	bigtime_t t = current_time_hires();
+	err = port_send(&p, (void *)3, 100);
+	t = current_time_hires() - t;
+	printf("port_send(100) on a full port returns %d (should be %d) after %llu usecs\n", err, ERR_TIMED_OUT, t);
+
+	err = port_send_irq(&p, (void *)3);
+	printf("port_send_irq on a full port returns %d (should be %d)\n", err, ERR_TIMED_OUT);
+
+	port_receive(&p, &msg, 0);
+	printf("first message %p (should be %p)\n", msg, (void *)1);
+	port_receive(&p, &msg, 0);
+	printf("second message %p (should be %p)\n", msg, (void *)2);
+
+	print_port_stats("port", &p);
+	printf("(should be depth 0 max 2 sent 2 received 2 dropped 3)\n");
+
+	port_destroy(&p);
+}
+
+/* zero copy: buffers cycle between a free port and a data port */
+static uint8_t port_msgs[MSG_COUNT][MSG_SIZE];
+static void *port_free_ring[MSG_COUNT];
+static void *port_data_ring[MSG_COUNT];
+static port_t port_free;
+static port_t port_data;
+static event_t bench_done;
+static volatile int bench_errors;
+
+static int port_producer(void *arg)
+{
+	uint i;
+	void *msg;
+
+	for (i = 0; i < BENCH_MESSAGES; i++) {
+		port_receive(&port_free, &msg, INFINITE_TIME);
+		*(uint *)msg = i;
+		port_send(&port_data, msg, INFINITE_TIME);
+	}
+
+	return 0;
+}
+
+static int port_consumer(void *arg)
+{
+	uint i;
+	void *msg;
+
+	for (i = 0; i < BENCH_MESSAGES; i++) {
+		port_receive(&port_data, &msg, INFINITE_TIME);
+		if (*(uint *)msg != i)
+			bench_errors++;
+		port_send(&port_free, msg, INFINITE_TIME);
+	}
+
+	event_signal(&bench_done, true);
+
+	return 0;
+}
+
+static bigtime_t port_bench(void)
+{
+	int i;
+
+	port_init(&port_free, port_free_ring, MSG_COUNT);
+	port_init(&port_data, port_data_ring, MSG_COUNT);
+	for (i = 0; i < MSG_COUNT; i++)
+		port_send(&port_free, port_msgs[i], 0);
+
+	bigtime_t t = current_time_hires();
+	thread_resume(thread_create("port consumer", &port_consumer, NULL, DEFAULT_PRIORITY, DEFAULT_STACK_SIZE));
+	thread_resume(thread_create("port producer", &port_producer, NULL, DEFAULT_PRIORITY, DEFAULT_STACK_SIZE));
+	event_wait(&bench_done);
+	t = current_time_hires() - t;
+
+	print_port_stats("data port", &port_data);
+
+	port_destroy(&port_free);
+	port_destroy(&port_data);
+
+	return t;
+}
+
+/* the same traffic copied through a cbuf */
+static cbuf_t bench_cbuf;
+
+static int cbuf_producer(void *arg)
+{
+	uint i;
+	uint8_t msg[MSG_SIZE];
+
+	for (i = 0; i < BENCH_MESSAGES; i++) {
+		*(uint *)msg = i;
+
+		/* cbuf_write doesn't block, retry the rest once the reader makes room */
+		size_t pos = 0;
+		while ((pos += cbuf_write(&bench_cbuf, msg + pos, MSG_SIZE - pos, true)) < MSG_SIZE)
+			thread_yield();
+	}
+
+	return 0;
+}
+
+static int cbuf_consumer(void *arg)
+{
+	uint i;
+	uint8_t msg[MSG_SIZE];
+
+	for (i = 0; i < BENCH_MESSAGES; i++) {
+		size_t pos = 0;
+		while (pos < MSG_SIZE)
+			pos += cbuf_read(&bench_cbuf, msg + pos, MSG_SIZE - pos, true);
+
+		if (*(uint *)msg != i)
+			bench_errors++;
+	}
+
+	event_signal(&bench_done, true);
+
+	return 0;
+}
+
+static bigtime_t cbuf_bench(void)
+{
+	cbuf_initialize(&bench_cbuf, MSG_SIZE * MSG_COUNT);
+
+	bigtime_t t = current_time_hires();
+	thread_resume(thread_create("cbuf consumer", &cbuf_consumer, NULL, DEFAULT_PRIORITY, DEFAULT_STACK_SIZE));
+	thread_resume(thread_create("cbuf producer", &cbuf_producer, NULL, DEFAULT_PRIORITY, DEFAULT_STACK_SIZE));
+	event_wait(&bench_done);
+	t = current_time_hires() - t;
+
+	/* cbuf has no teardown of its own */
+	event_destroy(&bench_cbuf.event);
+	free(bench_cbuf.buf);
+	return t;
+}
+
+int port_tests(void)
+{
+	port_basic_test();
+
+	printf("benchmarking %d messages of %d bytes, %d in flight\n", BENCH_MESSAGES, MSG_SIZE, MSG_COUNT);
+
+	bench_errors = 0;
+	event_init(&bench_done, false, EVENT_FLAG_AUTOUNSIGNAL);
+
+	bigtime_t port_time = port_bench();
+	bigtime_t cbuf_time = cbuf_bench();
+
+	printf("port: %llu usecs, cbuf: %llu usecs, %d out of order\n", port_time, cbuf_time, bench_errors);
+
+	event_destroy(&bench_done);
+
+	return 0;
+}
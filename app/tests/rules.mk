@@ -1,8 +1,15 @@
 LOCAL_DIR := $(GET_LOCAL_DIR)
 
+MODULES += \
+	lib/cbuf
+
 INCLUDES += -I$(LOCAL_DIR)/include
 
 OBJS += \
 	$(LOCAL_DIR)/tests.o \
+	$(LOCAL_DIR)/lock_tests.o \
+	$(LOCAL_DIR)/port_tests.o \
+	$(LOCAL_DIR)/heap_tests.o \
 	$(LOCAL_DIR)/thread_tests.o \
+	$(LOCAL_DIR)/timer_tests.o \
 	$(LOCAL_DIR)/printf_tests.o
@@ -31,6 +31,11 @@
 STATIC_COMMAND_START
 STATIC_COMMAND("printf_tests", "test printf", (console_cmd)&printf_tests)
 STATIC_COMMAND("thread_tests", "test the scheduler", (console_cmd)&thread_tests)
+STATIC_COMMAND("thread_create_test", "benchmark thread create/exit", (console_cmd)&thread_create_test)
+STATIC_COMMAND("timer_tests", "stress the timer wheel", (console_cmd)&timer_tests)
+STATIC_COMMAND("lock_tests", "test semaphores and rwlocks", (console_cmd)&lock_tests)
+STATIC_COMMAND("port_tests", "test and benchmark message ports", (console_cmd)&port_tests)
+STATIC_COMMAND("heap_tests", "test the heap and object caches", (console_cmd)&heap_tests)
 STATIC_COMMAND_END(tests);
 
 #endif
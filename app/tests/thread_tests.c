@@ -25,6 +25,7 @@
 #include <err.h>
 #include <app/tests.h>
 #include <kernel/thread.h>
+#include <kernel/dpc.h>
 #include <kernel/mutex.h>
 #include <kernel/event.h>
 #include <platform.h>
@@ -144,6 +145,167 @@ int mutex_test(void)
 	return 0;
 }
 
+/*
+ * priority inversion test: a low priority thread holds a lock, a high priority
+ * thread blocks on it and a medium priority thread hogs the cpu. without
+ * priority inheritance the high priority thread waits for the hog to finish.
+ * an auto unsignalling event is used as the lock for the no inheritance case.
+ */
+static mutex_t inherit_mutex;
+static event_t inherit_lock_event;
+static event_t inherit_locked;
+static bool inherit_use_mutex;
+static volatile int inherit_thread_count;
+static bigtime_t inherit_wait;
+
+static void inherit_lock(void)
+{
+	if (inherit_use_mutex)
+		mutex_acquire(&inherit_mutex);
+	else
+		event_wait(&inherit_lock_event);
+}
+
+static void inherit_unlock(void)
+{
+	if (inherit_use_mutex)
+		mutex_release(&inherit_mutex);
+	else
+		event_signal(&inherit_lock_event, true);
+}
+
+static int inherit_low_thread(void *arg)
+{
+	int i;
+
+	inherit_lock();
+	event_signal(&inherit_locked, true);
+
+	/* a fixed amount of work, not a fixed amount of time */
+	for (i = 0; i < 1000000; i++)
+		__asm__ volatile("nop");
+
+	inherit_unlock();
+
+	atomic_add(&inherit_thread_count, -1);
+	return 0;
+}
+
+static int inherit_mid_thread(void *arg)
+{
+	event_wait(&inherit_locked);
+
+	/* hog the cpu for a while */
+	time_t start = current_time();
+	while (current_time() - start < 200)
+		;
+
+	atomic_add(&inherit_thread_count, -1);
+	return 0;
+}
+
+static int inherit_high_thread(void *arg)
+{
+	event_wait(&inherit_locked);
+
+	bigtime_t start = current_time_hires();
+	inherit_lock();
+	inherit_wait = current_time_hires() - start;
+	inherit_unlock();
+
+	atomic_add(&inherit_thread_count, -1);
+	return 0;
+}
+
+/* boosts the holder of inherit_mutex until it gives up waiting */
+static int inherit_boost_thread(void *arg)
+{
+	mutex_acquire_timeout(&inherit_mutex, 50);
+
+	return 0;
+}
+
+static bigtime_t inherit_run(bool use_mutex)
+{
+	inherit_use_mutex = use_mutex;
+	inherit_thread_count = 3;
+	inherit_wait = 0;
+	event_unsignal(&inherit_locked);
+
+	thread_resume(thread_create("inherit high", &inherit_high_thread, NULL, HIGH_PRIORITY, DEFAULT_STACK_SIZE));
+	thread_resume(thread_create("inherit mid", &inherit_mid_thread, NULL, DEFAULT_PRIORITY + 1, DEFAULT_STACK_SIZE));
+	thread_resume(thread_create("inherit low", &inherit_low_thread, NULL, LOW_PRIORITY, DEFAULT_STACK_SIZE));
+
+	while (inherit_thread_count > 0)
+		thread_sleep(10);
+
+	return inherit_wait;
+}
+
+int mutex_inherit_test(void)
+{
+	int i;
+	bigtime_t wait;
+	bigtime_t worst_without = 0;
+	bigtime_t worst_with = 0;
+
+	printf("testing mutex priority inheritance\n");
+
+	mutex_init(&inherit_mutex);
+	event_init(&inherit_lock_event, true, EVENT_FLAG_AUTOUNSIGNAL);
+	event_init(&inherit_locked, false, 0);
+
+	for (i = 0; i < 5; i++) {
+		wait = inherit_run(false);
+		if (wait > worst_without)
+			worst_without = wait;
+
+		wait = inherit_run(true);
+		if (wait > worst_with)
+			worst_with = wait;
+	}
+
+	printf("worst case high priority wait: %llu usecs without inheritance, %llu usecs with\n",
+		worst_without, worst_with);
+	if (worst_with >= worst_without)
+		printf("priority inheritance did not help (FAIL)\n");
+
+	/* a boost only lasts as long as the waiter that caused it */
+	int base = current_thread->base_priority;
+	mutex_acquire(&inherit_mutex);
+
+	thread_resume(thread_create("boost waiter", &inherit_boost_thread, NULL, HIGH_PRIORITY, DEFAULT_STACK_SIZE));
+	thread_sleep(10);
+	int boosted = current_thread->priority;
+	thread_sleep(100);
+	int after_timeout = current_thread->priority;
+
+	/* and lowering the base priority while boosted takes effect when the boost goes */
+	thread_resume(thread_create("boost waiter", &inherit_boost_thread, NULL, HIGH_PRIORITY, DEFAULT_STACK_SIZE));
+	thread_sleep(10);
+	thread_set_priority(LOW_PRIORITY);
+	int lowered_boosted = current_thread->priority;
+	thread_sleep(100);
+	int lowered = current_thread->priority;
+
+	thread_set_priority(base);
+	mutex_release(&inherit_mutex);
+
+	printf("holder priority %d: boosted %d, after timeout %d, lowered while boosted %d, then %d\n",
+		base, boosted, after_timeout, lowered_boosted, lowered);
+	if (boosted != HIGH_PRIORITY || after_timeout != base ||
+			lowered_boosted != HIGH_PRIORITY || lowered != LOW_PRIORITY)
+		printf("inherited priority not given back (FAIL)\n");
+
+	mutex_destroy(&inherit_mutex);
+	event_destroy(&inherit_lock_event);
+	event_destroy(&inherit_locked);
+
+	printf("done with mutex inheritance test\n");
+
+	return 0;
+}
+
 static event_t e;
 
 static int event_signaller(void *arg)
@@ -210,6 +372,84 @@ void event_test(void)
 	printf("event tests done\n");
 }
 
+static event_t many_events[3];
+
+static int wait_many_signaller(void *arg)
+{
+	/* signal them out of order, each autounsignal event once */
+	thread_sleep(100);
+	event_signal(&many_events[2], true);
+	thread_sleep(100);
+	event_signal(&many_events[0], true);
+	thread_sleep(100);
+	event_signal(&many_events[1], true);
+
+	return 0;
+}
+
+static volatile int many_order[2];
+static volatile int many_order_count;
+
+static int wait_many_order_waiter(void *arg)
+{
+	event_t *events[1] = { &many_events[0] };
+
+	if (arg)
+		event_wait_many(events, 1, 1000, NULL);
+	else
+		event_wait_timeout(&many_events[0], 1000);
+	many_order[many_order_count++] = (int)arg;
+
+	return 0;
+}
+
+void wait_many_test(void)
+{
+	event_t *events[3] = { &many_events[0], &many_events[1], &many_events[2] };
+	status_t err;
+	uint which;
+	int i;
+
+	printf("wait many tests starting\n");
+
+	for (i = 0; i < 3; i++)
+		event_init(&many_events[i], false, EVENT_FLAG_AUTOUNSIGNAL);
+
+	thread_resume(thread_create("wait many signaller", &wait_many_signaller, NULL, DEFAULT_PRIORITY, DEFAULT_STACK_SIZE));
+
+	for (i = 0; i < 3; i++) {
+		which = 99;
+		err = event_wait_many(events, 3, 1000, &which);
+		printf("event_wait_many returns %d, event %u\n", err, which);
+	}
+	printf("above events should be 2, 0, 1\n");
+
+	err = event_wait_many(events, 3, 100, &which);
+	printf("event_wait_many with nothing signalled returns %d (should be %d)\n", err, ERR_TIMED_OUT);
+
+	/* an event signalled before the wait is picked up without blocking */
+	event_signal(&many_events[1], false);
+	err = event_wait_many(events, 3, 0, &which);
+	printf("event_wait_many on a signalled event returns %d, event %u (should be 0, 1)\n", err, which);
+
+	/* a wait_many waiter that arrived first is woken before a later plain waiter */
+	many_order_count = 0;
+	thread_resume(thread_create("wait many order 1", &wait_many_order_waiter, (void *)1, DEFAULT_PRIORITY, DEFAULT_STACK_SIZE));
+	thread_sleep(20);
+	thread_resume(thread_create("wait many order 0", &wait_many_order_waiter, (void *)0, DEFAULT_PRIORITY, DEFAULT_STACK_SIZE));
+	thread_sleep(20);
+	event_signal(&many_events[0], true);
+	thread_sleep(20);
+	event_signal(&many_events[0], true);
+	thread_sleep(20);
+	printf("waiters woke in order %d, %d (should be 1, 0)\n", many_order[0], many_order[1]);
+
+	for (i = 0; i < 3; i++)
+		event_destroy(&many_events[i]);
+
+	printf("wait many tests done\n");
+}
+
 static int quantum_tester(void *arg)
 {
 	for (;;) {
@@ -361,10 +601,151 @@ static void preempt_test(void)
 	printf("done with preempt test, above time stamps should be very close\n");
 }
 
+#if WITH_EDF
+static volatile int edf_running;
+
+static int edf_tester(void *arg)
+{
+	time_t busy = (time_t)arg;
+	int i;
+
+	/* burn busy ms of each period, then wait for the next one */
+	for (i = 0; i < 20; i++) {
+		time_t start = current_time();
+		while (current_time() - start < busy)
+			;
+		thread_wait_period();
+	}
+
+	printf("%s: jobs %u, deadline misses %u, budget overruns %u\n", current_thread->name,
+		current_thread->edf.jobs, current_thread->edf.misses, current_thread->edf.overruns);
+
+	atomic_add(&edf_running, -1);
+
+	return 0;
+}
+
+static void edf_test(void)
+{
+	thread_t *t[3];
+	status_t err;
+
+	printf("testing deadline scheduling\n");
+
+	edf_running = 3;
+
+	/* 20/100 + 10/50 + 30/100 = 70% of the cpu */
+	t[0] = thread_create("edf 100/20", &edf_tester, (void *)15, LOW_PRIORITY, DEFAULT_STACK_SIZE);
+	t[1] = thread_create("edf 50/10", &edf_tester, (void *)5, LOW_PRIORITY, DEFAULT_STACK_SIZE);
+	t[2] = thread_create("edf 100/30 overrun", &edf_tester, (void *)50, LOW_PRIORITY, DEFAULT_STACK_SIZE);
+	thread_set_deadline(t[0], 100, 20, 0);
+	thread_set_deadline(t[1], 50, 10, 0);
+	thread_set_deadline(t[2], 100, 30, 60);
+
+	/* this one would push the total past 100% */
+	err = thread_set_deadline(current_thread, 100, 40, 0);
+	printf("admitting a 40%% thread on top of 70%% returns %d (should be %d)\n", err, ERR_NOT_ALLOWED);
+
+	thread_resume(t[0]);
+	thread_resume(t[1]);
+	thread_resume(t[2]);
+
+	while (edf_running > 0)
+		thread_sleep(100);
+
+	printf("done with deadline test, only the overrunning thread should show misses\n");
+}
+#endif
+
+static int create_tester(void *arg)
+{
+	return 0;
+}
+
+static thread_t create_test_thread;
+static uint8_t create_test_stack[DEFAULT_STACK_SIZE];
+
+static void create_test_dpc(void *arg)
+{
+}
+
+int thread_create_test(void)
+{
+	const int iter = 10000;
+	uint count;
+	int i;
+
+	printf("testing thread create/exit throughput\n");
+
+	/* the testers outrank us, so each one runs to completion inside thread_resume() */
+	count = arch_cycle_count();
+	for (i = 0; i < iter; i++) {
+		thread_t *t = thread_create("create tester", &create_tester, NULL, HIGH_PRIORITY, DEFAULT_STACK_SIZE);
+		if (!t) {
+			printf("thread_create failed at iteration %d\n", i);
+			return -1;
+		}
+		thread_resume(t);
+	}
+	count = arch_cycle_count() - count;
+	printf("thread_create: took %u cycles to create and exit %d threads, %u per thread\n",
+		count, iter, count / iter);
+
+	/* caller owned storage, reusable as soon as the tester has been reaped */
+	count = arch_cycle_count();
+	for (i = 0; i < iter; i++) {
+		thread_t *t = thread_create_etc(&create_test_thread, "create tester", &create_tester, NULL,
+			HIGH_PRIORITY, create_test_stack, sizeof(create_test_stack));
+		thread_resume(t);
+		while (!(t->flags & THREAD_FLAG_REAPED))
+			thread_yield();
+	}
+	count = arch_cycle_count() - count;
+	printf("thread_create_etc: took %u cycles to create and exit %d threads, %u per thread\n",
+		count, iter, count / iter);
+
+	/* a caller owned structure with an allocated stack is only reaped once the dpc has freed the stack */
+	for (i = 0; i < 1000; i++) {
+		thread_t *t = thread_create_etc(&create_test_thread, "create tester", &create_tester, NULL,
+			HIGH_PRIORITY, NULL, DEFAULT_STACK_SIZE);
+		if (!t) {
+			printf("thread_create_etc failed at iteration %d\n", i);
+			return -1;
+		}
+		thread_resume(t);
+		while (!(t->flags & THREAD_FLAG_REAPED))
+			thread_yield();
+		if (t->state != THREAD_DEATH || list_in_list(&t->thread_list_node)) {
+			printf("thread %p reaped while still in use (FAIL)\n", t);
+			break;
+		}
+	}
+	printf("thread_create_etc with an allocated stack: %d of 1000 reaped cleanly\n", i);
+
+	/* a burst of exits with the dpc ring full still gets reaped, outranking the dpc worker keeps it full */
+	int base = current_thread->base_priority;
+	uint filled;
+
+	thread_set_priority(HIGHEST_PRIORITY);
+	for (filled = 0; filled < 2 * DPC_QUEUE_ENTRIES; filled++) {
+		if (dpc_queue(&create_test_dpc, NULL, DPC_FLAG_NORESCHED) < 0)
+			break;
+	}
+	for (i = 0; i < 16; i++)
+		thread_resume(thread_create("exit burst", &create_tester, NULL, HIGHEST_PRIORITY, DEFAULT_STACK_SIZE));
+	thread_set_priority(base);
+
+	printf("16 threads exited behind %u queued dpcs\n", filled);
+
+	return 0;
+}
+
 int thread_tests(void) 
 {
 	mutex_test();
+	mutex_inherit_test();
 	event_test();
+	wait_many_test();
 
 	atomic_test();
 
@@ -373,5 +754,11 @@ int thread_tests(void)
 
 	preempt_test();
 
+#if WITH_EDF
+	edf_test();
+#endif
+
+	thread_create_test();
+
 	return 0;
 }
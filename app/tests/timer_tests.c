@@ -0,0 +1,301 @@
+/*
+ * Copyright (c) 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <debug.h>
+#include <rand.h>
+#include <malloc.h>
+#include <app/tests.h>
+#include <kernel/thread.h>
+#include <kernel/timer.h>
+#include <platform.h>
+
+#define TIMER_COUNT 4096
+
+static volatile int timers_fired;
+
+static enum handler_return timer_test_callback(struct timer *t, time_t now, void *arg)
+{
+	timers_fired++;
+	return INT_NO_RESCHEDULE;
+}
+
+static void timer_arm_cancel_test(timer_t *timers, uint count, time_t max_delay)
+{
+	uint i;
+	uint cycles;
+	uint arm_cycles = 0;
+	uint cancel_cycles = 0;
+
+	for (i = 0; i < count; i++)
+		timer_initialize(&timers[i]);
+
+	for (i = 0; i < count; i++) {
+		time_t delay = 1000 + (uint)rand() % max_delay;
+
+		cycles = arch_cycle_count();
+		timer_set_oneshot(&timers[i], delay, &timer_test_callback, NULL);
+		arm_cycles += arch_cycle_count() - cycles;
+	}
+
+	/* cancel in a scattered order so we're not just popping off one end */
+	for (i = 0; i < count; i++) {
+		uint index = (i * 7919) % count;
+
+		cycles = arch_cycle_count();
+		timer_cancel(&timers[index]);
+		cancel_cycles += arch_cycle_count() - cycles;
+	}
+
+	printf("%u timers, max delay %u ms: %u cycles per arm, %u cycles per cancel\n",
+		count, (uint)max_delay, arm_cycles / count, cancel_cycles / count);
+}
+
+static void timer_fire_test(timer_t *timers, uint count)
+{
+	uint i;
+
+	printf("arming %u timers to fire over the next 500 ms\n", count);
+
+	timers_fired = 0;
+	for (i = 0; i < count; i++) {
+		timer_initialize(&timers[i]);
+		timer_set_oneshot(&timers[i], 1 + (uint)rand() % 500, &timer_test_callback, NULL);
+	}
+
+	thread_sleep(1000);
+
+	printf("%d of %u timers fired%s\n", timers_fired, count, (timers_fired == (int)count) ? "" : " (FAIL)");
+
+	/* in case some are still pending */
+	for (i = 0; i < count; i++)
+		timer_cancel(&timers[i]);
+}
+
+static volatile int slack_early;
+static volatile time_t slack_max_late;
+
+static enum handler_return timer_slack_callback(struct timer *t, time_t now, void *arg)
+{
+	time_t late = now - t->scheduled_time;
+
+	if ((int)late < 0)
+		slack_early++;
+	else if (late > slack_max_late)
+		slack_max_late = late;
+
+	timers_fired++;
+	return INT_NO_RESCHEDULE;
+}
+
+static void timer_slack_test(timer_t *timers, uint count, time_t slack)
+{
+	uint i;
+
+	printf("arming %u timers with %u ms of slack to fire over the next 500 ms\n", count, (uint)slack);
+
+#if THREAD_STATS
+	int timer_ints = thread_stats.timer_ints;
+	int coalesced = thread_stats.timer_coalesced;
+#endif
+
+	timers_fired = 0;
+	slack_early = 0;
+	slack_max_late = 0;
+	for (i = 0; i < count; i++) {
+		timer_initialize(&timers[i]);
+		timer_set_slack(&timers[i], slack);
+		timer_set_oneshot(&timers[i], 1 + (uint)rand() % 500, &timer_slack_callback, NULL);
+	}
+
+	thread_sleep(1000);
+
+	printf("%d of %u timers fired, %d early, at most %u ms late%s\n", timers_fired, count,
+		slack_early, (uint)slack_max_late,
+		(timers_fired == (int)count && slack_early == 0 && slack_max_late <= slack + 1) ? "" : " (FAIL)");
+#if THREAD_STATS
+	printf("%d timer interrupts, %d saved by slack\n",
+		thread_stats.timer_ints - timer_ints, thread_stats.timer_coalesced - coalesced);
+#endif
+
+	for (i = 0; i < count; i++)
+		timer_cancel(&timers[i]);
+}
+
+static volatile int hires_early;
+
+static enum handler_return timer_hires_callback(struct timer *t, time_t now, void *arg)
+{
+	if (current_time_hires() < t->hires_time)
+		hires_early++;
+
+	timers_fired++;
+	return INT_NO_RESCHEDULE;
+}
+
+/* arm hires timers over the next 50 ms, cancel every other one and make sure the rest fire on time */
+static void timer_hires_test(timer_t *timers, uint count)
+{
+	uint i;
+	uint cycles;
+	uint arm_cycles = 0;
+	uint cancel_cycles = 0;
+
+	printf("arming %u hires timers to fire over the next 50 ms, canceling half\n", count);
+
+	timers_fired = 0;
+	hires_early = 0;
+	for (i = 0; i < count; i++) {
+		timer_initialize(&timers[i]);
+
+		cycles = arch_cycle_count();
+		timer_set_oneshot_hires(&timers[i], 1000 + (uint)rand() % 50000, &timer_hires_callback, NULL);
+		arm_cycles += arch_cycle_count() - cycles;
+	}
+
+	/* the even ones, scattered. count is a power of two so this hits each once */
+	for (i = 0; i < count; i += 2) {
+		cycles = arch_cycle_count();
+		timer_cancel(&timers[(i * 7919) % count]);
+		cancel_cycles += arch_cycle_count() - cycles;
+	}
+
+	thread_sleep(100);
+
+	printf("%d of %u timers fired, %d early: %u cycles per arm, %u cycles per cancel%s\n",
+		timers_fired, count - count / 2, hires_early, arm_cycles / count, cancel_cycles / (count / 2),
+		(timers_fired == (int)(count - count / 2) && hires_early == 0) ? "" : " (FAIL)");
+
+	for (i = 0; i < count; i++)
+		timer_cancel(&timers[i]);
+}
+
+static volatile int threaded_fired;
+static volatile int threaded_in_irq;
+
+static enum handler_return timer_threaded_callback(struct timer *t, time_t now, void *arg)
+{
+	if (in_critical_section())
+		threaded_in_irq++;
+
+	/* threaded callbacks may block */
+	thread_sleep(1);
+
+	threaded_fired++;
+	return INT_NO_RESCHEDULE;
+}
+
+static void timer_threaded_test(void)
+{
+	timer_t timer;
+
+	printf("running a threaded 10 ms periodic timer for 105 ms\n");
+
+	threaded_fired = 0;
+	threaded_in_irq = 0;
+
+	timer_initialize(&timer);
+	timer_set_threaded(&timer, true);
+	timer_set_periodic(&timer, 10, &timer_threaded_callback, NULL);
+
+	thread_sleep(105);
+	timer_cancel(&timer);
+
+	/* let a callback that already started finish before the timer goes away */
+	thread_sleep(5);
+
+	printf("threaded timer fired %d times (should be about 10), %d in interrupt context%s\n",
+		threaded_fired, threaded_in_irq, (threaded_fired > 0 && threaded_in_irq == 0) ? "" : " (FAIL)");
+}
+
+#define JITTER_SAMPLES 100
+
+/* how late thread_sleep_usec() wakes up, for a range of delays */
+static void timer_jitter_test(void)
+{
+	static const bigtime_t delays[] = { 50, 100, 250, 500, 1000, 2500, 10000 };
+	uint i, j;
+
+	printf("sleep jitter, %d samples each:\n", JITTER_SAMPLES);
+
+	for (i = 0; i < countof(delays); i++) {
+		bigtime_t min_late = INFINITE_TIME_USEC;
+		bigtime_t max_late = 0;
+		bigtime_t total_late = 0;
+		int early = 0;
+
+		for (j = 0; j < JITTER_SAMPLES; j++) {
+			bigtime_t t = current_time_hires();
+			thread_sleep_usec(delays[i]);
+			t = current_time_hires() - t;
+
+			if (t < delays[i]) {
+				early++;
+				continue;
+			}
+
+			bigtime_t late = t - delays[i];
+			if (late < min_late)
+				min_late = late;
+			if (late > max_late)
+				max_late = late;
+			total_late += late;
+		}
+
+		if (early == JITTER_SAMPLES)
+			min_late = 0;
+
+		printf("\t%6llu usecs: late min %llu avg %llu max %llu usecs%s\n", delays[i],
+			min_late, total_late / JITTER_SAMPLES, max_late, early ? " (FAIL, woke early)" : "");
+	}
+}
+
+int timer_tests(void)
+{
+	timer_t *timers;
+
+	timers = malloc(sizeof(timer_t) * TIMER_COUNT);
+	if (!timers) {
+		printf("failed to allocate %u timers\n", TIMER_COUNT);
+		return -1;
+	}
+
+	timer_arm_cancel_test(timers, 16, 100);
+	timer_arm_cancel_test(timers, 256, 100);
+	timer_arm_cancel_test(timers, TIMER_COUNT, 100);
+	timer_arm_cancel_test(timers, TIMER_COUNT, 60 * 1000);
+	timer_arm_cancel_test(timers, TIMER_COUNT, 24 * 60 * 60 * 1000);
+
+	timer_fire_test(timers, TIMER_COUNT);
+
+	timer_slack_test(timers, 64, 0);
+	timer_slack_test(timers, 64, 20);
+
+	timer_hires_test(timers, 256);
+	timer_hires_test(timers, TIMER_COUNT);
+
+	timer_threaded_test();
+	timer_jitter_test();
+
+	free(timers);
+
+	return 0;
+}
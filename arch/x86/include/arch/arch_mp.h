@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef __X86_ARCH_MP_H
+#define __X86_ARCH_MP_H
+
+/* boot stack for each application processor, it becomes the stack of that cpu's idle thread */
+#define X86_AP_STACK_SIZE 8192
+
+#ifndef ASSEMBLY
+
+#include <sys/types.h>
+#include <compiler.h>
+#include <arch/ops.h>
+
+struct thread;
+
+/*
+ * per cpu state, the %fs segment of every cpu is based at its own entry.
+ * curr_thread is first so it can be read with a single instruction
+ * that can't be split by a migration to another cpu.
+ */
+struct x86_percpu {
+	struct thread *curr_thread;
+	uint cpu_num;
+	uint apic_id;
+};
+
+extern struct x86_percpu x86_percpu[SMP_MAX_CPUS];
+
+static inline __ALWAYS_INLINE struct thread *arch_get_current_thread(void)
+{
+	struct thread *t;
+
+	__asm__ __volatile__ ("movl %%fs:0, %0" : "=r" (t));
+	return t;
+}
+
+static inline __ALWAYS_INLINE void arch_set_current_thread(struct thread *t)
+{
+	__asm__ __volatile__ ("movl %0, %%fs:0" :: "r" (t) : "memory");
+}
+
+static inline __ALWAYS_INLINE uint arch_curr_cpu_num(void)
+{
+	uint cpu;
+
+	__asm__ __volatile__ ("movl %%fs:%c1, %0" : "=r" (cpu) : "i" (offsetof(struct x86_percpu, cpu_num)));
+	return cpu;
+}
+
+/* spinlocks */
+typedef volatile int spin_lock_t;
+
+#define SPIN_LOCK_INITIAL_VALUE 0
+
+static inline __ALWAYS_INLINE void arch_spin_lock(spin_lock_t *lock)
+{
+	while (atomic_swap(lock, 1) != 0) {
+		/* wait for it to look free before trying the locked swap again */
+		while (*lock != 0)
+			__asm__ __volatile__ ("pause" ::: "memory");
+	}
+}
+
+static inline __ALWAYS_INLINE void arch_spin_unlock(spin_lock_t *lock)
+{
+	/* stores aren't reordered with older stores on x86 */
+	__asm__ __volatile__ ("" ::: "memory");
+	*lock = 0;
+}
+
+#endif // !ASSEMBLY
+
+#endif
+
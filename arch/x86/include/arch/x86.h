@@ -105,6 +105,18 @@ static inline void x86_ltr(uint16_t sel) {
 	__asm__ __volatile__ ("ltr %%ax" :: "a" (sel));
 }
 
+static inline void x86_cpuid(uint32_t leaf, uint32_t *a, uint32_t *b, uint32_t *c, uint32_t *d) {
+	__asm__ __volatile__ (
+		"cpuid"
+		: "=a" (*a), "=b" (*b), "=c" (*c), "=d" (*d)
+		: "a" (leaf), "c" (0)
+	);
+}
+
+static inline void x86_set_fs(uint16_t sel) {
+	__asm__ __volatile__ ("movw %%ax, %%fs" :: "a" (sel));
+}
+
 static inline uint32_t x86_get_cr2(void) {
 	uint32_t rv;
 	
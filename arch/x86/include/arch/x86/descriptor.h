@@ -23,8 +23,6 @@
 #ifndef __ARCH_DESCRIPTOR_H
 #define __ARCH_DESCRIPTOR_H
 
-#include <sys/types.h>
-
 /*
  * System Selectors
  */
@@ -33,6 +31,9 @@
 #define VIDEO_SELECTOR	0x18
 #define TSS_SELECTOR	0x30
 
+/* one data segment per cpu, based at its per cpu state */
+#define PERCPU_SELECTOR(cpu)	(0x38 + ((cpu) << 3))
+
 #define USER_CODE_SELECTOR 0x23
 #define USER_DATA_SELECTOR 0x2b
 
@@ -46,9 +47,15 @@
 #define SEG_TYPE_DATA_RW	0x2
 #define SEG_TYPE_CODE_RW	0xa
 
+#ifndef ASSEMBLY
+
+#include <sys/types.h>
+
 typedef uint16_t seg_sel_t;
 
 void set_global_desc(seg_sel_t sel, void *base, uint32_t limit,
 	uint8_t present, uint8_t ring, uint8_t sys, uint8_t type, uint8_t gran, uint8_t bits);
 
 #endif
+
+#endif
@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <debug.h>
+#include <sys/types.h>
+#include <compiler.h>
+#include <arch/x86.h>
+#include <arch/x86/descriptor.h>
+#include <kernel/thread.h>
+#include <platform/mp.h>
+
+#if WITH_SMP
+
+struct x86_percpu x86_percpu[SMP_MAX_CPUS];
+
+/* boot stacks of the secondary cpus, handed out by the trampoline */
+uint8_t x86_ap_stacks[SMP_MAX_CPUS - 1][X86_AP_STACK_SIZE] __ALIGNED(16);
+volatile int x86_ap_next_cpu = 1;
+
+void x86_init_percpu(uint cpu);
+void x86_secondary_entry(uint cpu) __NO_RETURN;
+void x86_irq_enter(void);
+void x86_irq_exit(void);
+
+/* point this cpu's %fs at its per cpu state */
+void x86_init_percpu(uint cpu)
+{
+	x86_percpu[cpu].cpu_num = cpu;
+
+	set_global_desc(PERCPU_SELECTOR(cpu), &x86_percpu[cpu], sizeof(struct x86_percpu) - 1,
+		1, 0, 1, SEG_TYPE_DATA_RW, 0, 1);
+	x86_set_fs(PERCPU_SELECTOR(cpu));
+}
+
+/* called from the trampoline on the secondary cpu's boot stack */
+void x86_secondary_entry(uint cpu)
+{
+	x86_init_percpu(cpu);
+
+	/* enable caches, same as the boot cpu */
+	clear_in_cr0(X86_CR0_NW | X86_CR0_CD);
+
+	platform_mp_secondary_init();
+
+	thread_secondary_cpu_entry();
+}
+
+/* interrupt glue, see crt0.S */
+void x86_irq_enter(void)
+{
+	inc_critical_section();
+}
+
+void x86_irq_exit(void)
+{
+	dec_critical_section();
+}
+
+#endif
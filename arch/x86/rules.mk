@@ -13,7 +13,9 @@ OBJS += \
 	$(LOCAL_DIR)/thread.o \
 	$(LOCAL_DIR)/mmu.o \
 	$(LOCAL_DIR)/faults.o \
-	$(LOCAL_DIR)/descriptor.o
+	$(LOCAL_DIR)/descriptor.o \
+	$(LOCAL_DIR)/mp.o \
+	$(LOCAL_DIR)/mp_start.o
 
 # set the default toolchain to x86 elf and set a #define
 TOOLCHAIN_PREFIX ?= i386-elf-
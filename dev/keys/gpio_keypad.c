@@ -109,6 +109,7 @@ gpio_keypad_timer_func(struct timer *timer, time_t now, void *arg)
 			gpio_set(gpio, polarity);
 		else
 			gpio_config(gpio, polarity ? GPIO_OUTPUT : 0);
+		timer_set_slack(timer, 0);
 		timer_set_oneshot(timer, kpinfo->settle_time,
 				  gpio_keypad_timer_func, NULL);
 		goto done;
@@ -116,6 +117,8 @@ gpio_keypad_timer_func(struct timer *timer, time_t now, void *arg)
 
 	if (/*!kp->use_irq*/ 1 || kp->some_keys_pressed) {
 		event_signal(&kp->full_scan, false);
+		/* polling for new presses can share an interrupt with other timers */
+		timer_set_slack(timer, kpinfo->poll_time / 4);
 		timer_set_oneshot(timer, kpinfo->poll_time,
 				  gpio_keypad_timer_func, NULL);
 		goto done;
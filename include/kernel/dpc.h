@@ -30,9 +30,38 @@ void dpc_init(void);
 
 typedef void (*dpc_callback)(void *arg);
 
+/*
+ * Deferred procedure calls are run by one worker thread per priority
+ * level. Each level queues into a preallocated ring of DPC_QUEUE_ENTRIES
+ * slots, so dpc_queue() never allocates and may be called from interrupt
+ * context (pass DPC_FLAG_NORESCHED there). It returns ERR_NO_MEMORY if
+ * the ring is full.
+ */
 #define DPC_FLAG_NORESCHED 0x1
+#define DPC_FLAG_LOW_PRIORITY 0x2	/* run on the low priority worker */
+
+/* slots per worker, must be a power of 2 */
+#ifndef DPC_QUEUE_ENTRIES
+#define DPC_QUEUE_ENTRIES 64
+#endif
 
 status_t dpc_queue(dpc_callback, void *arg, uint flags);
 
+/*
+ * A caller that can't afford to have a call dropped embeds a dpc_node_t
+ * in its own structure and queues that instead, which can't fail. The
+ * node must not be queued again before its callback has started.
+ */
+typedef struct dpc_node {
+	struct list_node node;
+	dpc_callback cb;
+	void *arg;
+	bigtime_t queued;
+} dpc_node_t;
+
+void dpc_queue_node(dpc_node_t *node, dpc_callback, void *arg, uint flags);
+
+void dpc_dump_stats(void);
+
 #endif
 
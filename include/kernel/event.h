@@ -56,6 +56,7 @@ void event_init(event_t *, bool initial, uint flags);
 void event_destroy(event_t *);
 status_t event_wait(event_t *);
 status_t event_wait_timeout(event_t *, time_t); /* wait on the event with a timeout */
+status_t event_wait_many(event_t **, uint count, time_t, uint *which); /* wait for any of several events */
 status_t event_signal(event_t *, bool reschedule);
 status_t event_unsignal(event_t *);
 #define event_initialized(e)	((e)->magic == EVENT_MAGIC)
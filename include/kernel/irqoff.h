@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef __KERNEL_IRQOFF_H
+#define __KERNEL_IRQOFF_H
+
+#include <sys/types.h>
+
+/*
+ * interrupts disabled latency tracker
+ *
+ * With WITH_IRQOFF_TRACE=1 the outermost enter_critical_section() and
+ * exit_critical_section() of every critical section are timestamped with
+ * arch_cycle_count(). The longest sections are recorded per call site,
+ * along with a log2 histogram of all of them. When disabled the hooks
+ * compile away.
+ */
+
+/* number of distinct enter_critical_section() call sites tracked */
+#ifndef IRQOFF_SITES
+#define IRQOFF_SITES 64
+#endif
+
+#if WITH_IRQOFF_TRACE
+
+/* called with interrupts disabled, from the critical section inlines only */
+void irqoff_trace_start(void);
+void irqoff_trace_stop(void);
+
+void irqoff_dump(uint count);
+void irqoff_dump_histogram(void);
+void irqoff_reset(void);
+
+#define IRQOFF_TRACE_START() irqoff_trace_start()
+#define IRQOFF_TRACE_STOP() irqoff_trace_stop()
+
+#else
+
+#define IRQOFF_TRACE_START() do { } while (0)
+#define IRQOFF_TRACE_STOP() do { } while (0)
+
+#endif
+
+#endif
+
@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef __KERNEL_KTRACE_H
+#define __KERNEL_KTRACE_H
+
+#include <sys/types.h>
+
+/*
+ * kernel event tracer
+ *
+ * Records timestamped scheduler, interrupt, timer, dpc and mutex events
+ * into a fixed size ring buffer. Enable with WITH_KTRACE=1 in the project
+ * DEFINES; when disabled every KTRACE() call site compiles away.
+ */
+
+enum ktrace_event {
+	KTRACE_NONE = 0,
+	KTRACE_CONTEXT_SWITCH,	/* a = old thread, b = new thread */
+	KTRACE_IRQ_ENTER,		/* a = vector */
+	KTRACE_IRQ_EXIT,		/* a = vector, b = handler_return */
+	KTRACE_TIMER_CALLBACK,	/* a = timer, b = callback */
+	KTRACE_DPC,				/* a = callback, b = arg */
+	KTRACE_MUTEX_BLOCK,		/* a = mutex, b = holder */
+	KTRACE_MUTEX_WAKE,		/* a = mutex, b = new holder */
+
+	KTRACE_EVENT_COUNT
+};
+
+/* number of records in the ring, must be a power of 2 */
+#ifndef KTRACE_ENTRIES
+#define KTRACE_ENTRIES 1024
+#endif
+
+struct ktrace_record {
+	uint32_t timestamp;		/* arch_cycle_count() */
+	uint16_t event;
+	uint16_t reserved;
+	uint32_t a;
+	uint32_t b;
+};
+
+#if WITH_KTRACE
+
+extern volatile bool ktrace_enabled;
+
+void ktrace_record_event(uint event, uint32_t a, uint32_t b);
+
+void ktrace_start(void);
+void ktrace_stop(void);
+void ktrace_dump(void);
+
+#define KTRACE(event, a, b) \
+	do { \
+		if (ktrace_enabled) \
+			ktrace_record_event((event), (uint32_t)(a), (uint32_t)(b)); \
+	} while (0)
+
+#else
+
+#define KTRACE(event, a, b) do { } while (0)
+
+#endif
+
+#endif
+
@@ -27,16 +27,43 @@
 
 #define MUTEX_MAGIC 'mutx'
 
+#if WITH_LOCK_PROFILING
+/* contention counters, times in usecs */
+struct mutex_profile {
+	const char *name;
+	struct list_node node;	/* in the list of named mutexes */
+	bigtime_t acquired_at;
+
+	uint acquisitions;
+	uint contended;
+	bigtime_t total_wait;
+	bigtime_t max_wait;
+	bigtime_t total_hold;
+	bigtime_t max_hold;
+};
+#endif
+
 typedef struct mutex {
 	int magic;
 	int count;
 	thread_t *holder;
 	wait_queue_t wait;
+
+	/* node in the holder's list of held mutexes */
+	struct list_node held_node;
+
+#if WITH_LOCK_PROFILING
+	struct mutex_profile profile;
+#endif
 } mutex_t;
 
 /* Rules for Mutexes:
  * - Mutexes are only safe to use from thread context.
  * - Mutexes are non-recursive.
+ * - Mutexes implement priority inheritance: while a thread is blocked on a
+ *   mutex, the holder (and transitively whoever the holder is blocked on)
+ *   runs at no less than the blocked thread's priority.
+ * - On release, ownership passes directly to the highest priority waiter.
 */
 
 void mutex_init(mutex_t *);
@@ -45,5 +72,23 @@ status_t mutex_acquire(mutex_t *);
 status_t mutex_acquire_timeout(mutex_t *, time_t); /* try to acquire the mutex with a timeout value */
 status_t mutex_release(mutex_t *);
 
+/* recompute a thread's inherited priority, used by thread_set_priority() */
+void mutex_update_priority(thread_t *t);
+
+/*
+ * lock profiling
+ *
+ * With WITH_LOCK_PROFILING=1 every mutex counts its acquisitions and
+ * contention, and mutexes registered with a name are listed by the
+ * "locks" console command. Otherwise registering is a no-op.
+ */
+#if WITH_LOCK_PROFILING
+void mutex_register(mutex_t *, const char *name);
+void mutex_profile_dump(uint count);
+void mutex_profile_reset(void);
+#else
+static inline void mutex_register(mutex_t *m, const char *name) { }
+#endif
+
 #endif
 
@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef __KERNEL_PORT_H
+#define __KERNEL_PORT_H
+
+#include <kernel/thread.h>
+
+#define PORT_MAGIC 'port'
+
+typedef struct port {
+	int magic;
+
+	/* ring of message pointers, provided by the caller */
+	void **ring;
+	uint capacity;
+	uint head;	/* next message to receive */
+	uint count;
+
+	wait_queue_t send_wait;
+	wait_queue_t receive_wait;
+
+	/* stats */
+	uint sent;
+	uint received;
+	uint dropped;
+	uint max_depth;
+} port_t;
+
+struct port_stats {
+	uint depth;
+	uint max_depth;
+	uint sent;
+	uint received;
+	uint dropped;
+};
+
+/* Rules for Ports:
+ * - A port queues pointers to messages, never their contents. Sending a
+ *   message passes ownership of its buffer to whoever receives it.
+ * - Ports have a fixed capacity and never allocate. Messages usually come
+ *   from a second port preloaded with free buffers: take a buffer from the
+ *   free port, fill it, send it, and the receiver sends it back to the free
+ *   port when it's done.
+ * - A timeout of 0 never blocks; a send to a full port then fails with
+ *   ERR_TIMED_OUT and counts as a drop.
+ * - port_send_irq() may be used from interrupt context. It never blocks or
+ *   reschedules, the interrupt handler should return INT_RESCHEDULE.
+ * - Ports may not be received from in interrupt context.
+*/
+
+void port_init(port_t *, void **ring, uint capacity);
+void port_destroy(port_t *);
+status_t port_send(port_t *, void *msg, time_t timeout);
+status_t port_send_irq(port_t *, void *msg);
+status_t port_receive(port_t *, void **msg, time_t timeout);
+void port_get_stats(port_t *, struct port_stats *);
+
+#endif
+
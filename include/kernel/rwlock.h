@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef __KERNEL_RWLOCK_H
+#define __KERNEL_RWLOCK_H
+
+#include <kernel/thread.h>
+
+#define RWLOCK_MAGIC 'rwlk'
+
+typedef struct rwlock {
+	int magic;
+	int readers;		/* number of threads holding it shared */
+	thread_t *writer;	/* thread holding it exclusive */
+	wait_queue_t read_wait;
+	wait_queue_t write_wait;
+} rwlock_t;
+
+/* Rules for Reader-Writer Locks:
+ * - Reader-writer locks are only safe to use from thread context.
+ * - Any number of readers or a single writer may hold the lock.
+ * - Writers are preferred: once a writer is waiting, new readers queue
+ *   behind it instead of joining the readers already inside.
+ * - On release the lock is handed directly to the next writer, or to
+ *   all the waiting readers at once.
+ * - Neither side is recursive, and a reader can't upgrade to a writer.
+*/
+
+void rwlock_init(rwlock_t *);
+void rwlock_destroy(rwlock_t *);
+status_t rwlock_acquire_read(rwlock_t *);
+status_t rwlock_acquire_read_timeout(rwlock_t *, time_t);
+status_t rwlock_release_read(rwlock_t *);
+status_t rwlock_acquire_write(rwlock_t *);
+status_t rwlock_acquire_write_timeout(rwlock_t *, time_t);
+status_t rwlock_release_write(rwlock_t *);
+
+#endif
+
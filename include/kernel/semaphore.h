@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef __KERNEL_SEMAPHORE_H
+#define __KERNEL_SEMAPHORE_H
+
+#include <kernel/thread.h>
+
+#define SEMAPHORE_MAGIC 'sema'
+
+typedef struct semaphore {
+	int magic;
+	int count;
+	wait_queue_t wait;
+} semaphore_t;
+
+/* Rules for Semaphores:
+ * - Semaphores may be posted from interrupt context *but* the reschedule
+ *   parameter must be false in that case.
+ * - Semaphores may not be waited upon from interrupt context.
+ * - A post with threads waiting hands the count straight to the first
+ *   waiter, so a later sem_wait() can't take it first.
+*/
+
+void sem_init(semaphore_t *, uint value);
+void sem_destroy(semaphore_t *);
+status_t sem_post(semaphore_t *, bool reschedule);
+status_t sem_wait(semaphore_t *);
+status_t sem_trywait(semaphore_t *);
+status_t sem_timedwait(semaphore_t *, time_t); /* wait on the semaphore with a timeout */
+
+#endif
+
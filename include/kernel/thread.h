@@ -29,6 +29,11 @@
 #include <arch/defines.h>
 #include <arch/ops.h>
 #include <arch/thread.h>
+#include <arch/mp.h>
+#include <kernel/timer.h>
+#include <kernel/irqoff.h>
+#include <kernel/dpc.h>
+#include <lib/arena.h>
 
 enum thread_state {
 	THREAD_SUSPENDED = 0,
@@ -48,6 +53,46 @@ enum thread_tls_list {
 
 #define THREAD_MAGIC 'thrd'
 
+/* thread flags */
+#define THREAD_FLAG_FREE_STACK	0x1	/* stack was allocated by thread_create_etc() */
+#define THREAD_FLAG_FREE_STRUCT	0x2	/* thread structure was allocated by thread_create_etc() */
+#define THREAD_FLAG_REAPED	0x4	/* exited and cleaned up, caller provided storage may be reused */
+
+struct mutex;
+struct wait_queue_many_node;
+
+/*
+ * earliest deadline first scheduling state, see thread_set_deadline()
+ *
+ * All times are in ms except the budget, which is tracked in usecs so
+ * short runs aren't rounded away. The deadline class is only built with
+ * WITH_EDF=1 in the project DEFINES, otherwise threads carry none of
+ * this and thread_set_deadline() returns ERR_NOT_SUPPORTED.
+ */
+#if WITH_EDF
+struct thread_edf {
+	time_t period;			/* zero if the thread isn't in the deadline class */
+	time_t runtime;
+	time_t deadline;		/* relative to each release */
+	uint utilization;		/* admitted share, in parts per EDF_UTIL_SCALE */
+
+	time_t abs_deadline;	/* deadline of the current job */
+	int budget;				/* usecs of runtime left this period */
+	bigtime_t last_start;	/* when the budget was last charged */
+	bool throttled;			/* out of budget until the next release */
+	bool waiting;			/* sleeping in thread_wait_period() */
+	bool late;				/* current job was already counted as a miss */
+
+	/* stats */
+	uint jobs;
+	uint misses;
+	uint overruns;
+
+	timer_t period_timer;
+	timer_t budget_timer;
+};
+#endif
+
 typedef struct thread {
 	int magic;
 	struct list_node thread_list_node;
@@ -55,14 +100,35 @@ typedef struct thread {
 	/* active bits */
 	struct list_node queue_node;
 	int priority;
+	int base_priority;
 	enum thread_state state;	
 	int saved_critical_section_count;
 	int remaining_quantum;
 
-	/* if blocked, a pointer to the wait queue */
+	/* if blocked, a pointer to the wait queue and our place in its arrival order */
 	struct wait_queue *blocking_wait_queue;
+	uint blocking_seq;
 	status_t wait_queue_block_ret;
 
+	/* if blocked in wait_queue_block_many(), our node in each of the queues */
+	struct wait_queue_many_node *blocking_many;
+	uint blocking_many_count;
+	int blocking_many_fired;
+
+	/* priority inheritance: the mutex we're blocked on and the ones we hold */
+	struct mutex *blocking_mutex;
+	struct list_node held_mutexes;
+
+#if WITH_EDF
+	/* deadline scheduling class */
+	struct thread_edf edf;
+#endif
+
+#if WITH_SMP
+	/* the cpu whose run queue we're sitting in */
+	uint curr_cpu;
+#endif
+
 	/* architecture stuff */
 	struct arch_thread arch;
 
@@ -70,6 +136,9 @@ typedef struct thread {
 	void *stack;
 	size_t stack_size;
 
+	/* THREAD_FLAG_* */
+	uint flags;
+
 	/* entry point */
 	thread_start_routine entry;
 	void *arg;
@@ -80,6 +149,12 @@ typedef struct thread {
 	/* thread local storage */
 	uint32_t tls[MAX_TLS_ENTRY];
 
+	/* scratch memory, given back when the thread exits */
+	arena_t scratch;
+
+	/* queued by thread_exit() to free the stack and structure */
+	dpc_node_t cleanup_dpc;
+
 	char name[32];
 } thread_t;
 
@@ -100,6 +175,11 @@ typedef struct thread {
 #define DEFAULT_STACK_SIZE ARCH_DEFAULT_STACK_SIZE
 #endif
 
+/* scratch arena chunk size, big enough for a filesystem block and change */
+#ifndef THREAD_SCRATCH_CHUNK_SIZE
+#define THREAD_SCRATCH_CHUNK_SIZE 8192
+#endif
+
 /* functions */
 void thread_init_early(void);
 void thread_init(void);
@@ -107,13 +187,49 @@ void thread_become_idle(void) __NO_RETURN;
 void thread_set_name(const char *name);
 void thread_set_priority(int priority);
 thread_t *thread_create(const char *name, thread_start_routine entry, void *arg, int priority, size_t stack_size);
+thread_t *thread_create_etc(thread_t *t, const char *name, thread_start_routine entry, void *arg, int priority, void *stack, size_t stack_size);
 status_t thread_resume(thread_t *);
 void thread_exit(int retcode) __NO_RETURN;
 void thread_sleep(time_t delay);
+void thread_sleep_usec(bigtime_t delay);
+
+/* earliest deadline first scheduling class */
+#define EDF_UTIL_SCALE 1000
+
+status_t thread_set_deadline(thread_t *t, time_t period, time_t runtime, time_t deadline);
+status_t thread_wait_period(void);
 
 void dump_thread(thread_t *t);
 void dump_all_threads(void);
 
+/*
+ * stack high water marks
+ *
+ * With THREAD_STACK_HIGHWATER set (the default on debug builds) stacks are
+ * painted when a thread is created, and the deepest point a thread has
+ * reached can be found by scanning for the paint. A stack sizing report
+ * is then printed THREAD_STACK_REPORT_DELAY ms (5s by default) after the
+ * apps have started; set it to 0 to turn the report off.
+ */
+#ifndef THREAD_STACK_HIGHWATER
+#if DEBUGLEVEL > 1
+#define THREAD_STACK_HIGHWATER 1
+#else
+#define THREAD_STACK_HIGHWATER 0
+#endif
+#endif
+
+#if THREAD_STACK_HIGHWATER && !defined(THREAD_STACK_REPORT_DELAY)
+#define THREAD_STACK_REPORT_DELAY 5000
+#endif
+
+#define THREAD_STACK_PAINT 0x99
+
+#if THREAD_STACK_HIGHWATER
+size_t thread_stack_used(thread_t *t);
+void thread_stack_report(void);
+#endif
+
 /* scheduler routines */
 void thread_yield(void); /* give up the cpu voluntarily */
 void thread_preempt(void); /* get preempted (inserted into head of run queue) */
@@ -122,9 +238,114 @@ void thread_block(void); /* block on something and reschedule */
 /* called on every timer tick for the scheduler to do quantum expiration */
 enum handler_return thread_timer_tick(void);
 
+/* only used by mutex priority inheritance, must be inside critical section */
+void thread_set_effective_priority(thread_t *t, int priority);
+
+#if WITH_SMP
+
+/* per cpu scheduler state */
+struct percpu {
+	uint cpu_num;
+	int critical_section_depth;
+	thread_t *idle;
+
+	/*
+	 * the run queue, guarded by its own lock rather than thread_lock so
+	 * other cpus can look at it without serializing against this one.
+	 * it nests inside thread_lock, and no cpu holds two of them at once.
+	 */
+	spin_lock_t run_queue_lock;
+	struct list_node run_queue[NUM_PRIORITIES];
+	uint32_t run_queue_bitmap;
+};
+
+extern struct percpu percpu[SMP_MAX_CPUS];
+
+/* cpus that have joined the scheduler, and the ones running their idle thread */
+extern volatile uint32_t mp_active_cpus;
+extern volatile uint32_t mp_idle_cpus;
+
+static inline __ALWAYS_INLINE struct percpu *get_percpu(void)
+{
+	return &percpu[arch_curr_cpu_num()];
+}
+
+/* the current thread */
+#define current_thread (arch_get_current_thread())
+
+static inline __ALWAYS_INLINE void set_current_thread(thread_t *t)
+{
+	arch_set_current_thread(t);
+}
+
+/* the idle thread */
+#define idle_thread (get_percpu()->idle)
+
+/*
+ * critical sections
+ *
+ * Critical sections are serialized across cpus by thread_lock, which is
+ * taken when a cpu's critical section count goes from 0 to 1 and dropped
+ * when it returns to 0. Interrupts are disabled first so that the count
+ * we look at belongs to the cpu we're running on.
+ */
+extern spin_lock_t thread_lock;
+
+#define critical_section_count (get_percpu()->critical_section_depth)
+
+static inline __ALWAYS_INLINE void enter_critical_section(void)
+{
+	arch_disable_ints();
+	if (critical_section_count == 0) {
+		arch_spin_lock(&thread_lock);
+		IRQOFF_TRACE_START();
+	}
+	critical_section_count++;
+}
+
+static inline __ALWAYS_INLINE void exit_critical_section(void)
+{
+	critical_section_count--;
+	if (critical_section_count == 0) {
+		IRQOFF_TRACE_STOP();
+		arch_spin_unlock(&thread_lock);
+		arch_enable_ints();
+	}
+}
+
+static inline __ALWAYS_INLINE bool in_critical_section(void)
+{
+	return critical_section_count > 0;
+}
+
+/* only used by interrupt glue, interrupts are already disabled */
+static inline void inc_critical_section(void)
+{
+	if (critical_section_count == 0)
+		arch_spin_lock(&thread_lock);
+	critical_section_count++;
+}
+
+static inline void dec_critical_section(void)
+{
+	critical_section_count--;
+	if (critical_section_count == 0)
+		arch_spin_unlock(&thread_lock);
+}
+
+/* called by the arch code on each secondary cpu once its per cpu state is set up */
+void thread_secondary_cpu_entry(void) __NO_RETURN;
+
+#else
+
 /* the current thread */
 extern thread_t *current_thread;
 
+static inline __ALWAYS_INLINE void set_current_thread(thread_t *t)
+{
+	current_thread = t;
+}
+
 /* the idle thread */
 extern thread_t *idle_thread;
 
@@ -133,16 +354,20 @@ extern int critical_section_count;
 
 static inline __ALWAYS_INLINE void enter_critical_section(void)
 {
-	if (critical_section_count == 0)
+	if (critical_section_count == 0) {
 		arch_disable_ints();
+		IRQOFF_TRACE_START();
+	}
 	critical_section_count++;
 }
 
 static inline __ALWAYS_INLINE void exit_critical_section(void)
 {
 	critical_section_count--;
-	if (critical_section_count == 0)
+	if (critical_section_count == 0) {
+		IRQOFF_TRACE_STOP();
 		arch_enable_ints();
+	}
 }
 
 static inline __ALWAYS_INLINE bool in_critical_section(void)
@@ -154,6 +379,8 @@ static inline __ALWAYS_INLINE bool in_critical_section(void)
 static inline void inc_critical_section(void) { critical_section_count++; }
 static inline void dec_critical_section(void) { critical_section_count--; }
 
+#endif
+
 /* thread local storage */
 static inline __ALWAYS_INLINE uint32_t tls_get(uint entry)
 {
@@ -167,15 +394,40 @@ static inline __ALWAYS_INLINE uint32_t tls_set(uint entry, uint32_t val)
 	return oldval;
 }
 
+/*
+ * per thread scratch arena
+ *
+ * For temporary buffers that would otherwise be a malloc() and free() on
+ * every call. Take a mark, allocate, and reset back to the mark before
+ * returning. No chunks are allocated until a thread first uses it.
+ */
+static inline arena_t *thread_scratch_arena(void)
+{
+	return &current_thread->scratch;
+}
+
 /* wait queue stuff */
 #define WAIT_QUEUE_MAGIC 'wait'
 
 typedef struct wait_queue {
 	int magic;
 	struct list_node list;
-	int count;
+	int count;	/* all waiters, including the ones on many_list */
+	struct list_node many_list;
+	uint seq;	/* arrival order of waiters across both lists */
 } wait_queue_t;
 
+/* a thread blocked in wait_queue_block_many() waits on each queue through one of these */
+struct wait_queue_many_node {
+	struct list_node node;
+	thread_t *thread;
+	wait_queue_t *wait;
+	uint seq;
+};
+
+/* most queues wait_queue_block_many() can wait on at once */
+#define WAIT_QUEUE_MANY_MAX 8
+
 /* wait queue primitive */
 /* NOTE: must be inside critical section when using these */
 void wait_queue_init(wait_queue_t *);
@@ -195,6 +447,16 @@ void wait_queue_destroy(wait_queue_t *, bool reschedule);
  */
 status_t wait_queue_block(wait_queue_t *, time_t timeout);
 
+/* same as wait_queue_block(), with the timeout in usecs */
+status_t wait_queue_block_usec(wait_queue_t *, bigtime_t timeout);
+
+/*
+ * block on several wait queues at once, until any one of them is woken.
+ * the index of the queue that woke us is returned in which. the per
+ * queue bookkeeping lives on the caller's stack, nothing is allocated.
+ */
+status_t wait_queue_block_many(wait_queue_t **, uint count, time_t timeout, uint *which);
+
 /* 
  * release one or more threads from the wait queue.
  * reschedule = should the system reschedule if any is released.
@@ -226,6 +488,8 @@ struct thread_stats {
 	int interrupts; /* platform code increment this */
 	int timer_ints; /* timer code increment this */
 	int timers; /* timer code increment this */
+	int timer_coalesced; /* timer interrupts saved by timer slack */
+	int idle_wakeups; /* times the idle thread was switched away from */
 };
 
 extern struct thread_stats thread_stats;
@@ -36,24 +36,50 @@ typedef enum handler_return (*timer_callback)(struct timer *, time_t now, void *
 typedef struct timer {
 	int magic;
 	struct list_node node;
+	int wheel_level;
+	uint wheel_slot;
 
 	time_t scheduled_time;
 	time_t periodic_time;
+	bigtime_t hires_time;
+	bigtime_t hires_deadline;
+	struct timer *hires_child;	/* links in the hires heap */
+	struct timer *hires_next;
+	struct timer *hires_prev;
+	time_t slack;
+	bool threaded;
 
 	timer_callback callback;
 	void *arg;
 } timer_t;
 
 /* Rules for Timers:
- * - Timer callbacks occur from interrupt context
+ * - Timer callbacks occur from interrupt context, unless the timer is made
+ *   threaded with timer_set_threaded(), in which case they are called from
+ *   the high priority timer thread with interrupts enabled
  * - Timers may be programmed or canceled from interrupt or thread context
  * - Timers may be canceled or reprogrammed from within their callback
- * - Timers currently are dispatched from a 10ms periodic tick
+ * - Timers are dispatched from a 10ms periodic tick, unless the platform
+ *   sets PLATFORM_HAS_DYNAMIC_TIMER, in which case the hardware timer is
+ *   programmed for the next pending event and an idle system takes no ticks
+ * - Setting and canceling a timer is O(1), independent of the number of
+ *   pending timers
+ * - Hires timers take their delay in usecs. Where the platform sets
+ *   PLATFORM_HAS_HIRES_TIMER they are kept in a heap, setting one is O(1)
+ *   and canceling one is O(log n) amortized in the number of pending hires
+ *   timers. Elsewhere they are rounded up to the next ms
+ * - A timer with slack may fire up to that many ms late. With a dynamic
+ *   timer the hardware is programmed for the earliest time any pending
+ *   timer has to fire, and every timer that is due by then fires in the
+ *   same interrupt
 */
 void timer_initialize(timer_t *);
 void timer_set_oneshot(timer_t *, time_t delay, timer_callback, void *arg);
+void timer_set_oneshot_hires(timer_t *, bigtime_t delay, timer_callback, void *arg);
 void timer_set_periodic(timer_t *, time_t period, timer_callback, void *arg);
 void timer_cancel(timer_t *);
+void timer_set_slack(timer_t *, time_t slack);
+void timer_set_threaded(timer_t *, bool threaded);
 
 #endif
 
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef __LIB_ARENA_H
+#define __LIB_ARENA_H
+
+#include <sys/types.h>
+#include <list.h>
+
+/*
+ * scratch arenas
+ *
+ * An arena hands out memory by bumping a pointer through chunks that are
+ * allocated from the heap on demand. Individual allocations are never
+ * freed; instead a caller takes a mark, allocates whatever it needs and
+ * resets the arena back to the mark when it's done, which releases
+ * everything allocated since in one go. Marks nest, so code working in an
+ * arena can call other code that uses the same arena, as long as the
+ * resets happen in the reverse order of the marks.
+ *
+ * Every thread owns one of these as its scratch arena, see
+ * thread_scratch_arena().
+ */
+
+#define ARENA_MAGIC 'arna'
+
+/* alignment of every allocation */
+#define ARENA_ALIGN 8
+
+typedef struct arena {
+	int magic;
+	size_t chunk_size;
+
+	/* chunks in use, newest first */
+	struct list_node chunks;
+
+	/* one emptied chunk kept around so a reset doesn't thrash the heap */
+	struct arena_chunk *spare;
+
+	/* bump pointer into the newest chunk */
+	uint8_t *pos;
+	uint8_t *end;
+
+	/* stats */
+	uint chunk_count;
+	size_t max_used;
+} arena_t;
+
+typedef struct arena_mark {
+	struct arena_chunk *chunk;
+	uint8_t *pos;
+} arena_mark_t;
+
+#define ARENA_INITIAL_VALUE(arena, _chunk_size) \
+{ \
+	.magic = ARENA_MAGIC, \
+	.chunk_size = (_chunk_size), \
+	.chunks = LIST_INITIAL_VALUE((arena).chunks), \
+}
+
+/* chunk_size includes the chunk header, 0 means ARENA_DEFAULT_CHUNK_SIZE */
+#define ARENA_DEFAULT_CHUNK_SIZE 4096
+
+void arena_init(arena_t *, size_t chunk_size);
+
+/* give every chunk back to the heap, the arena may be used again afterwards */
+void arena_destroy(arena_t *);
+
+void *arena_alloc(arena_t *, size_t size);
+
+arena_mark_t arena_mark(arena_t *);
+void arena_reset(arena_t *, arena_mark_t mark);
+
+/* bytes currently handed out */
+size_t arena_used(arena_t *);
+
+#endif
+
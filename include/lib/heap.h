@@ -25,9 +25,60 @@
 
 #include <sys/types.h>
 
+/*
+ * region attributes
+ *
+ * The same flags are passed to heap_alloc_etc() as a placement hint. The
+ * heap first looks for a region with every attribute asked for, and then
+ * settles for any region, except that a dma request never lands outside
+ * dma capable memory and fast regions are only used when asked for.
+ */
+#define HEAP_REGION_FAST	(1 << 0)	/* on chip sram or otherwise quick memory */
+#define HEAP_REGION_DMA		(1 << 1)	/* reachable by bus masters */
+#define HEAP_REGION_LARGE	(1 << 2)	/* plenty of room, for big buffers */
+
+/*
+ * hand another range of memory to the heap. may be called before heap_init(),
+ * but one region slot stays reserved for the main heap range until then.
+ */
+status_t heap_add_region(void *base, size_t len, uint flags);
+
 void *heap_alloc(size_t, unsigned int alignment);
+void *heap_alloc_etc(size_t, unsigned int alignment, uint flags);
+void *heap_realloc(void *, size_t);
 void heap_free(void *);
 
+/*
+ * With WITH_HEAP_PROFILE=1 allocations are charged to the code that called
+ * the heap. Allocator wrappers like malloc() use these to pass their own
+ * caller along instead.
+ */
+#if WITH_HEAP_PROFILE
+void *heap_alloc_tagged(size_t, unsigned int alignment, uint flags, void *caller);
+void *heap_realloc_tagged(void *, size_t, void *caller);
+#else
+#define heap_alloc_tagged(size, alignment, flags, caller) heap_alloc_etc(size, alignment, flags)
+#define heap_realloc_tagged(ptr, size, caller) heap_realloc(ptr, size)
+#endif
+
+/* buckets of the free chunk histogram, bucket n holds chunks of 2^(n+4) bytes and up */
+#define HEAP_STATS_BUCKETS 20
+
+struct heap_stats {
+	size_t size;			/* bytes under management */
+	size_t used;			/* bytes handed out, including headers and rounding */
+	size_t max_used;
+	size_t free;			/* bytes free in the pools and the page allocator */
+	size_t largest_free;	/* the biggest single chunk that could be allocated */
+	uint allocs;
+	uint frees;
+	uint failures;
+	uint fragmentation;		/* percent of free memory outside the largest chunk */
+	uint free_histogram[HEAP_STATS_BUCKETS];
+};
+
+void heap_get_stats(struct heap_stats *stats);
+
 void heap_init(void);
 
 
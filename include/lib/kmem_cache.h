@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef __LIB_KMEM_CACHE_H
+#define __LIB_KMEM_CACHE_H
+
+#include <sys/types.h>
+#include <list.h>
+
+/*
+ * object caches
+ *
+ * A cache hands out objects of one fixed size, carved out of slabs that are
+ * allocated from the heap a few kilobytes at a time. Each object carries a
+ * single pointer of overhead instead of a heap allocation header, and
+ * allocating or freeing one is O(1).
+ *
+ * The constructor, if there is one, runs once for each object when its slab
+ * is created, not on every allocation. Objects should be freed back to the
+ * cache in their constructed state.
+ */
+
+#define KMEM_CACHE_MAGIC 'kmem'
+
+typedef void (*kmem_cache_ctor)(void *obj);
+
+typedef struct kmem_cache {
+	int magic;
+	const char *name;
+	size_t object_size;
+	size_t align;
+	kmem_cache_ctor ctor;
+
+	/* slab geometry, worked out the first time the cache is used */
+	size_t slot_size;
+	size_t slab_size;
+	uint slab_objects;
+
+	struct list_node partial_slabs;
+	struct list_node full_slabs;
+	struct list_node empty_slabs;
+	struct list_node node;
+
+	/* stats */
+	uint slabs;
+	uint active;
+	uint max_active;
+	uint allocs;
+	uint frees;
+	uint failures;
+} kmem_cache_t;
+
+#define KMEM_CACHE_INITIAL_VALUE(cache, _name, size, _align, _ctor) \
+{ \
+	.magic = KMEM_CACHE_MAGIC, \
+	.name = (_name), \
+	.object_size = (size), \
+	.align = (_align), \
+	.ctor = (_ctor), \
+	.partial_slabs = LIST_INITIAL_VALUE((cache).partial_slabs), \
+	.full_slabs = LIST_INITIAL_VALUE((cache).full_slabs), \
+	.empty_slabs = LIST_INITIAL_VALUE((cache).empty_slabs), \
+}
+
+/* align of 0 means pointer alignment */
+void kmem_cache_init(kmem_cache_t *, const char *name, size_t size, size_t align, kmem_cache_ctor ctor);
+void kmem_cache_destroy(kmem_cache_t *);
+
+void *kmem_cache_alloc(kmem_cache_t *);
+void kmem_cache_free(kmem_cache_t *, void *);
+
+/* give every empty slab back to the heap */
+void kmem_cache_reap(kmem_cache_t *);
+
+void kmem_cache_dump(void);
+
+#endif
+
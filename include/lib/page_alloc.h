@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef __LIB_PAGE_ALLOC_H
+#define __LIB_PAGE_ALLOC_H
+
+#include <sys/types.h>
+#include <arch/defines.h>
+
+/*
+ * page allocator
+ *
+ * A buddy allocator handing out naturally aligned blocks of a power of two
+ * pages. Each range of memory given to it becomes an arena. The heap sits
+ * on top of it: page sized and larger heap allocations come straight out of
+ * here, and the small object heap grows by taking blocks from it.
+ */
+
+/* largest block is 2^PAGE_ALLOC_MAX_ORDER pages */
+#ifndef PAGE_ALLOC_MAX_ORDER
+#define PAGE_ALLOC_MAX_ORDER 14
+#endif
+
+#ifndef PAGE_ALLOC_MAX_ARENAS
+#define PAGE_ALLOC_MAX_ARENAS 8
+#endif
+
+/* start managing a range of memory, returns the arena number or an error */
+int page_add_arena(void *base, size_t len);
+
+/*
+ * the block will back a heap pool. page_alloc_size() reports 0 for it, so a
+ * heap allocation that happens to start on its first page isn't taken for
+ * a block of its own.
+ */
+#define PAGE_ALLOC_FLAG_POOL 0x1
+
+/* allocate 2^order pages from one arena, aligned to their size */
+void *page_alloc_arena(int arena, uint order, uint flags);
+
+/* free a block from any arena */
+void page_free(void *ptr);
+
+/* size of the block starting at ptr, or 0 if ptr doesn't start one or it backs a pool */
+size_t page_alloc_size(const void *ptr);
+
+/* total pages in an arena, and how many free blocks of an order it has */
+size_t page_arena_pages(int arena);
+uint page_arena_free_blocks(int arena, uint order);
+
+/* smallest order that holds size bytes */
+uint page_size_to_order(size_t size);
+
+void page_alloc_dump(void);
+
+#endif
+
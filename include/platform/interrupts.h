@@ -32,4 +32,11 @@ typedef enum handler_return (*int_handler)(void *arg);
 
 void register_int_handler(unsigned int vector, int_handler handler, void *arg);
 
+/*
+ * run handler from a dedicated high priority thread instead of interrupt
+ * context. ack, if not NULL, is called from interrupt context first to
+ * quiet the device. the vector is masked until handler returns.
+ */
+status_t register_threaded_int_handler(unsigned int vector, int_handler ack, int_handler handler, void *arg);
+
 #endif
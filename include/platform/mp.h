@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef __PLATFORM_MP_H
+#define __PLATFORM_MP_H
+
+#include <sys/types.h>
+
+#if WITH_SMP
+
+enum mp_ipi {
+	MP_IPI_RESCHEDULE,	/* run the scheduler */
+	MP_IPI_TIMER,		/* pass on the scheduler tick */
+};
+
+/* send an inter processor interrupt to every cpu in the mask */
+void platform_mp_send_ipi(uint32_t cpu_mask, enum mp_ipi ipi);
+
+/* called by the arch code on each secondary cpu before it joins the scheduler */
+void platform_mp_secondary_init(void);
+
+#endif
+
+#endif
+
@@ -27,5 +27,16 @@ typedef enum handler_return (*platform_timer_callback)(void *arg, time_t now);
 
 status_t platform_set_periodic_timer(platform_timer_callback callback, void *arg, time_t interval);
 
+#if PLATFORM_HAS_DYNAMIC_TIMER
+/* platforms that can program an arbitrary one-shot interval */
+status_t platform_set_oneshot_timer(platform_timer_callback callback, void *arg, time_t interval);
+void platform_stop_timer(void);
+#endif
+
+#if PLATFORM_HAS_HIRES_TIMER
+/* platforms that can also program a one-shot interval in usecs */
+status_t platform_set_oneshot_timer_hires(platform_timer_callback callback, void *arg, bigtime_t interval);
+#endif
+
 #endif
 
@@ -59,6 +59,7 @@ typedef int kobj_id;
 typedef unsigned long time_t;
 typedef unsigned long long bigtime_t;
 #define INFINITE_TIME ULONG_MAX
+#define INFINITE_TIME_USEC ((bigtime_t)-1)
 
 #define TIME_GTE(a, b) ((long)((a) - (b)) >= 0)
 #define TIME_LTE(a, b) ((long)((a) - (b)) <= 0)
@@ -42,11 +42,15 @@
 static int cmd_threads(int argc, const cmd_args *argv);
 static int cmd_threadstats(int argc, const cmd_args *argv);
 static int cmd_threadload(int argc, const cmd_args *argv);
+static int cmd_stacks(int argc, const cmd_args *argv);
 
 STATIC_COMMAND_START
 #if DEBUGLEVEL > 1
 STATIC_COMMAND("threads", "list kernel threads", &cmd_threads)
 #endif
+#if THREAD_STACK_HIGHWATER
+STATIC_COMMAND("stacks", "thread stack use and suggested sizes", &cmd_stacks)
+#endif
 #if THREAD_STATS
 STATIC_COMMAND("threadstats", "thread level statistics", &cmd_threadstats)
 STATIC_COMMAND("threadload", "toggle thread load display", &cmd_threadload)
@@ -63,6 +67,15 @@ static int cmd_threads(int argc, const cmd_args *argv)
 }
 #endif
 
+#if THREAD_STACK_HIGHWATER
+static int cmd_stacks(int argc, const cmd_args *argv)
+{
+	thread_stack_report();
+
+	return 0;
+}
+#endif
+
 #if THREAD_STATS
 static int cmd_threadstats(int argc, const cmd_args *argv)
 {
@@ -76,6 +89,8 @@ static int cmd_threadstats(int argc, const cmd_args *argv)
 	printf("\tinterrupts: %d\n", thread_stats.interrupts);
 	printf("\ttimer interrupts: %d\n", thread_stats.timer_ints);
 	printf("\ttimers: %d\n", thread_stats.timers);
+	printf("\ttimer interrupts saved by slack: %d\n", thread_stats.timer_coalesced);
+	printf("\tidle wakeups: %d\n", thread_stats.idle_wakeups);
 
 	return 0;
 }
@@ -94,11 +109,12 @@ static enum handler_return threadload(struct timer *t, time_t now, void *arg)
 	uint busypercent = (busy_time * 10000) / (1000000);
 
 //	printf("idle_time %lld, busytime %lld\n", idle_time - last_idle_time, busy_time);
-	printf("LOAD: %d.%02d%%, cs %d, ints %d, timer ints %d, timers %d\n", busypercent / 100, busypercent % 100,
+	printf("LOAD: %d.%02d%%, cs %d, ints %d, timer ints %d, timers %d, idle wakeups %d\n", busypercent / 100, busypercent % 100,
 			thread_stats.context_switches - old_stats.context_switches,
 			thread_stats.interrupts - old_stats.interrupts,
 			thread_stats.timer_ints - old_stats.timer_ints,
-			thread_stats.timers - old_stats.timers);
+			thread_stats.timers - old_stats.timers,
+			thread_stats.idle_wakeups - old_stats.idle_wakeups);
 
 	old_stats = thread_stats;
 	last_idle_time = idle_time;
@@ -116,6 +132,7 @@ static int cmd_threadload(int argc, const cmd_args *argv)
 	if (showthreadload == false) {
 		// start the display
 		timer_initialize(&tltimer);
+		timer_set_slack(&tltimer, 10);
 		timer_set_periodic(&tltimer, 1000, &threadload, NULL);
 		showthreadload = true;
 	} else {
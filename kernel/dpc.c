@@ -21,68 +21,224 @@
  * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 #include <debug.h>
-#include <list.h>
-#include <malloc.h>
+#include <string.h>
 #include <err.h>
 #include <kernel/dpc.h>
 #include <kernel/thread.h>
 #include <kernel/event.h>
+#include <kernel/ktrace.h>
+#include <platform.h>
 
-struct dpc {
-	struct list_node node;	
+#if (DPC_QUEUE_ENTRIES & (DPC_QUEUE_ENTRIES - 1)) != 0
+#error DPC_QUEUE_ENTRIES must be a power of 2
+#endif
 
+struct dpc {
 	dpc_callback cb;
 	void *arg;
+	bigtime_t queued;
+};
+
+/* one ring of pending calls and a worker thread per priority level */
+struct dpc_queue {
+	const char *name;
+	int priority;
+
+	struct dpc ring[DPC_QUEUE_ENTRIES];
+	uint head;	/* next slot to run */
+	uint tail;	/* next slot to fill */
+	struct list_node nodes;	/* queued with dpc_queue_node(), run after the ring */
+	event_t event;
+
+	/* stats */
+	uint queued;
+	uint dropped;
+	uint max_depth;
+	uint batches;
+	bigtime_t total_latency;
+	bigtime_t max_latency;
+};
+
+enum {
+	DPC_QUEUE_HIGH,
+	DPC_QUEUE_LOW,
+	DPC_QUEUE_COUNT
 };
 
-static struct list_node dpc_list = LIST_INITIAL_VALUE(dpc_list);
-static event_t dpc_event;
+static struct dpc_queue dpc_queues[DPC_QUEUE_COUNT] = {
+	[DPC_QUEUE_HIGH] = { .name = "dpc", .priority = DPC_PRIORITY },
+	[DPC_QUEUE_LOW] = { .name = "dpc low", .priority = LOW_PRIORITY },
+};
 
 static int dpc_thread_routine(void *arg);
 
 void dpc_init(void)
 {
-	event_init(&dpc_event, false, 0);
+	uint i;
+
+	for (i = 0; i < DPC_QUEUE_COUNT; i++) {
+		struct dpc_queue *q = &dpc_queues[i];
 
-	thread_resume(thread_create("dpc", &dpc_thread_routine, NULL, DPC_PRIORITY, DEFAULT_STACK_SIZE));
+		list_initialize(&q->nodes);
+		event_init(&q->event, false, 0);
+		thread_resume(thread_create(q->name, &dpc_thread_routine, q, q->priority, DEFAULT_STACK_SIZE));
+	}
 }
 
 status_t dpc_queue(dpc_callback cb, void *arg, uint flags)
 {
-	struct dpc *dpc;
+	struct dpc_queue *q = &dpc_queues[(flags & DPC_FLAG_LOW_PRIORITY) ? DPC_QUEUE_LOW : DPC_QUEUE_HIGH];
+	status_t err = NO_ERROR;
 
-	dpc = malloc(sizeof(struct dpc));
+	enter_critical_section();
+
+	uint depth = q->tail - q->head;
+	if (depth >= DPC_QUEUE_ENTRIES) {
+		q->dropped++;
+		err = ERR_NO_MEMORY;
+		goto out;
+	}
 
+	struct dpc *dpc = &q->ring[q->tail & (DPC_QUEUE_ENTRIES - 1)];
 	dpc->cb = cb;
 	dpc->arg = arg;
-	enter_critical_section();
-	list_add_tail(&dpc_list, &dpc->node);
-	event_signal(&dpc_event, (flags & DPC_FLAG_NORESCHED) ? false : true);
+	dpc->queued = current_time_hires();
+	q->tail++;
+
+	q->queued++;
+	if (depth + 1 > q->max_depth)
+		q->max_depth = depth + 1;
+
+	/* the worker is only woken on the first entry of a batch */
+	if (depth == 0 && list_is_empty(&q->nodes))
+		event_signal(&q->event, (flags & DPC_FLAG_NORESCHED) ? false : true);
+
+out:
 	exit_critical_section();
 
-	return NO_ERROR;
+	return err;
+}
+
+void dpc_queue_node(dpc_node_t *node, dpc_callback cb, void *arg, uint flags)
+{
+	struct dpc_queue *q = &dpc_queues[(flags & DPC_FLAG_LOW_PRIORITY) ? DPC_QUEUE_LOW : DPC_QUEUE_HIGH];
+
+	enter_critical_section();
+
+	bool idle = (q->head == q->tail) && list_is_empty(&q->nodes);
+
+	node->cb = cb;
+	node->arg = arg;
+	node->queued = current_time_hires();
+	list_add_tail(&q->nodes, &node->node);
+
+	q->queued++;
+
+	if (idle)
+		event_signal(&q->event, (flags & DPC_FLAG_NORESCHED) ? false : true);
+
+	exit_critical_section();
 }
 
 static int dpc_thread_routine(void *arg)
 {
+	struct dpc_queue *q = (struct dpc_queue *)arg;
+
 	for (;;) {
-		event_wait(&dpc_event);
+		event_wait(&q->event);
+
+		/* drain everything queued, including what arrives while we run */
+		for (;;) {
+			struct dpc dpc;
+
+			enter_critical_section();
+			if (q->head != q->tail) {
+				dpc = q->ring[q->head & (DPC_QUEUE_ENTRIES - 1)];
+				q->head++;
+			} else if (!list_is_empty(&q->nodes)) {
+				/* copy it out, the callback may free the node */
+				dpc_node_t *node = list_remove_head_type(&q->nodes, dpc_node_t, node);
+				dpc.cb = node->cb;
+				dpc.arg = node->arg;
+				dpc.queued = node->queued;
+			} else {
+				event_unsignal(&q->event);
+				q->batches++;
+				exit_critical_section();
+				break;
+			}
+
+			bigtime_t latency = current_time_hires() - dpc.queued;
+			q->total_latency += latency;
+			if (latency > q->max_latency)
+				q->max_latency = latency;
+			exit_critical_section();
+
+//			dprintf("dpc calling %p, arg %p\n", dpc.cb, dpc.arg);
+			KTRACE(KTRACE_DPC, dpc.cb, dpc.arg);
+			dpc.cb(dpc.arg);
+		}
+	}
+
+	return 0;
+}
+
+void dpc_dump_stats(void)
+{
+	uint i;
+
+	for (i = 0; i < DPC_QUEUE_COUNT; i++) {
+		struct dpc_queue *q = &dpc_queues[i];
 
 		enter_critical_section();
-		struct dpc *dpc = list_remove_head_type(&dpc_list, struct dpc, node);
-		if (!dpc)
-			event_unsignal(&dpc_event);
+		uint depth = q->tail - q->head;
+		struct list_node *node;
+		list_for_every(&q->nodes, node)
+			depth++;
+		uint queued = q->queued;
+		uint dropped = q->dropped;
+		uint max_depth = q->max_depth;
+		uint batches = q->batches;
+		bigtime_t total_latency = q->total_latency;
+		bigtime_t max_latency = q->max_latency;
 		exit_critical_section();
 
-		if (dpc) {
-//			dprintf("dpc calling %p, arg %p\n", dpc->cb, dpc->arg);
-			dpc->cb(dpc->arg);
+		uint run = queued - depth;
 
-			free(dpc);
-		}
+		printf("%-8s pri %2d: queued %u, dropped %u, depth %u (max %u/%u), batches %u\n",
+			q->name, q->priority, queued, dropped, depth, max_depth, DPC_QUEUE_ENTRIES, batches);
+		printf("%-8s         latency avg %llu usecs, max %llu usecs\n",
+			"", run ? total_latency / run : 0, max_latency);
+	}
+}
+
+#if WITH_LIB_CONSOLE
+#include <lib/console.h>
+
+static int cmd_dpc(int argc, const cmd_args *argv);
+
+STATIC_COMMAND_START
+STATIC_COMMAND("dpc", "deferred procedure call stats", &cmd_dpc)
+STATIC_COMMAND_END(dpc);
+
+static int cmd_dpc(int argc, const cmd_args *argv)
+{
+	if (argc < 2) {
+		printf("not enough arguments:\n");
+usage:
+		printf("%s stats\n", argv[0].str);
+		return -1;
+	}
+
+	if (!strcmp(argv[1].str, "stats")) {
+		dpc_dump_stats();
+	} else {
+		printf("unrecognized subcommand\n");
+		goto usage;
 	}
 
 	return 0;
 }
 
+#endif
 
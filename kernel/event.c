@@ -137,6 +137,62 @@ err:
 	return ret;
 }
 
+/**
+ * @brief  Wait for any of several events to be signaled
+ *
+ * If one or more of the events is already signaled the first of them is
+ * taken and this function returns immediately. Otherwise the current
+ * thread sleeps on all of them until one is signaled or the timeout is
+ * reached. Auto-unsignal events are consumed only if they are the one
+ * that woke us.
+ *
+ * @param events   Array of event objects, at most WAIT_QUEUE_MANY_MAX
+ * @param count    Number of events
+ * @param timeout  Timeout value, in ms
+ * @param which    Set to the index of the event that was signaled
+ *
+ * @return  0 on success, ERR_TIMED_OUT on timeout,
+ *         other values on other errors.
+ */
+status_t event_wait_many(event_t **events, uint count, time_t timeout, uint *which)
+{
+	wait_queue_t *queues[WAIT_QUEUE_MANY_MAX];
+	status_t ret = NO_ERROR;
+	uint i;
+
+	if (count == 0 || count > WAIT_QUEUE_MANY_MAX)
+		return ERR_INVALID_ARGS;
+
+	enter_critical_section();
+
+	for (i = 0; i < count; i++) {
+		event_t *e = events[i];
+
+#if EVENT_CHECK
+		ASSERT(e->magic == EVENT_MAGIC);
+#endif
+
+		if (e->signalled) {
+			/* same as event_wait_timeout(), let one waiter through an autounsignal event */
+			if (e->flags & EVENT_FLAG_AUTOUNSIGNAL)
+				e->signalled = false;
+			if (which)
+				*which = i;
+			goto done;
+		}
+
+		queues[i] = &e->wait;
+	}
+
+	/* nothing signalled, block on all of them */
+	ret = wait_queue_block_many(queues, count, timeout, which);
+
+done:
+	exit_critical_section();
+
+	return ret;
+}
+
 /**
  * @brief  Same as event_wait_timeout(), but without a timeout.
  */
@@ -0,0 +1,225 @@
+/*
+ * Copyright (c) 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file
+ * @brief  Interrupts disabled latency tracker
+ *
+ * Every outermost critical section is timed from enter_critical_section()
+ * to exit_critical_section(). Sections are keyed by the address they were
+ * entered from, which is where the inlined enter_critical_section() called
+ * irqoff_trace_start(). A section that spans a context switch is entered
+ * by one thread and left by another; it still counts against the site it
+ * was entered from.
+ *
+ * The hooks run inside the critical section they are timing, so the
+ * counters need no further locking.
+ */
+#include <debug.h>
+#include <string.h>
+#include <compiler.h>
+#include <arch/ops.h>
+#include <kernel/irqoff.h>
+#include <kernel/thread.h>
+
+#if WITH_IRQOFF_TRACE
+
+#if WITH_SMP
+#define IRQOFF_CPUS SMP_MAX_CPUS
+#define irqoff_cpu() arch_curr_cpu_num()
+#else
+#define IRQOFF_CPUS 1
+#define irqoff_cpu() 0
+#endif
+
+struct irqoff_site {
+	void *caller;			/* where the section was entered */
+	uint count;
+	uint64_t total_cycles;
+	uint32_t max_cycles;
+	void *max_exit;			/* where the longest one was left */
+};
+
+/* the section currently open on each cpu */
+static struct {
+	uint32_t start;
+	void *caller;
+	bool active;
+} irqoff_open[IRQOFF_CPUS];
+
+static struct irqoff_site irqoff_sites[IRQOFF_SITES];
+static uint irqoff_sites_full;		/* sections not recorded because the site table is full */
+static uint irqoff_histogram[32];	/* bucket n counts sections of 2^n to 2^(n+1)-1 cycles */
+
+void irqoff_trace_start(void)
+{
+	uint cpu = irqoff_cpu();
+
+	irqoff_open[cpu].caller = __GET_CALLER();
+	irqoff_open[cpu].active = true;
+	irqoff_open[cpu].start = arch_cycle_count();
+}
+
+void irqoff_trace_stop(void)
+{
+	uint32_t end = arch_cycle_count();
+	uint cpu = irqoff_cpu();
+
+	/* the boot critical section was never started */
+	if (!irqoff_open[cpu].active)
+		return;
+	irqoff_open[cpu].active = false;
+
+	uint32_t cycles = end - irqoff_open[cpu].start;
+	void *caller = irqoff_open[cpu].caller;
+
+	irqoff_histogram[cycles ? 31 - __builtin_clz(cycles) : 0]++;
+
+	/* open addressed hash on the call site */
+	uint i = ((uintptr_t)caller >> 2) % IRQOFF_SITES;
+	uint probe;
+	for (probe = 0; probe < IRQOFF_SITES; probe++) {
+		struct irqoff_site *s = &irqoff_sites[i];
+
+		if (s->caller == caller || s->caller == NULL) {
+			s->caller = caller;
+			s->count++;
+			s->total_cycles += cycles;
+			if (cycles > s->max_cycles) {
+				s->max_cycles = cycles;
+				s->max_exit = __GET_CALLER();
+			}
+			return;
+		}
+
+		i = (i + 1) % IRQOFF_SITES;
+	}
+
+	irqoff_sites_full++;
+}
+
+/**
+ * @brief  Print the call sites with the longest critical sections
+ */
+void irqoff_dump(uint count)
+{
+	static struct irqoff_site sites[IRQOFF_SITES];
+	uint full;
+	uint i, j;
+
+	/* work on a snapshot, printing takes critical sections of its own */
+	enter_critical_section();
+	memcpy(sites, irqoff_sites, sizeof(sites));
+	full = irqoff_sites_full;
+	exit_critical_section();
+
+	printf("%-10s %-10s %10s %12s %12s\n", "enter", "worst exit", "count", "max cycles", "avg cycles");
+	for (i = 0; i < count; i++) {
+		struct irqoff_site *worst = NULL;
+
+		for (j = 0; j < IRQOFF_SITES; j++) {
+			if (sites[j].caller && (!worst || sites[j].max_cycles > worst->max_cycles))
+				worst = &sites[j];
+		}
+		if (!worst)
+			break;
+
+		printf("%p %p %10u %12u %12llu\n", worst->caller, worst->max_exit, worst->count,
+			worst->max_cycles, worst->total_cycles / worst->count);
+		worst->caller = NULL;
+	}
+
+	if (full)
+		printf("%u sections from untracked sites, raise IRQOFF_SITES\n", full);
+}
+
+/**
+ * @brief  Print the histogram of critical section lengths
+ */
+void irqoff_dump_histogram(void)
+{
+	uint hist[32];
+	uint i;
+
+	enter_critical_section();
+	memcpy(hist, irqoff_histogram, sizeof(hist));
+	exit_critical_section();
+
+	printf("%-24s %10s\n", "cycles", "count");
+	for (i = 0; i < 32; i++) {
+		if (hist[i] == 0)
+			continue;
+		printf("%10u - %10u %10u\n", i ? (1U << i) : 0, (i < 31) ? (1U << (i + 1)) - 1 : 0xffffffff, hist[i]);
+	}
+}
+
+/**
+ * @brief  Clear the site table and histogram
+ */
+void irqoff_reset(void)
+{
+	enter_critical_section();
+	memset(irqoff_sites, 0, sizeof(irqoff_sites));
+	memset(irqoff_histogram, 0, sizeof(irqoff_histogram));
+	irqoff_sites_full = 0;
+	exit_critical_section();
+}
+
+#if WITH_LIB_CONSOLE
+#include <lib/console.h>
+
+static int cmd_irqoff(int argc, const cmd_args *argv);
+
+STATIC_COMMAND_START
+STATIC_COMMAND("irqoff", "interrupts disabled latency", &cmd_irqoff)
+STATIC_COMMAND_END(irqoff);
+
+static int cmd_irqoff(int argc, const cmd_args *argv)
+{
+	if (argc < 2) {
+		printf("not enough arguments:\n");
+usage:
+		printf("%s list [count]\n", argv[0].str);
+		printf("%s hist\n", argv[0].str);
+		printf("%s reset\n", argv[0].str);
+		return -1;
+	}
+
+	if (!strcmp(argv[1].str, "list")) {
+		irqoff_dump((argc >= 3) ? argv[2].u : 10);
+	} else if (!strcmp(argv[1].str, "hist")) {
+		irqoff_dump_histogram();
+	} else if (!strcmp(argv[1].str, "reset")) {
+		irqoff_reset();
+	} else {
+		printf("unrecognized subcommand\n");
+		goto usage;
+	}
+
+	return 0;
+}
+
+#endif
+
+#endif
+
@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file
+ * @brief  Kernel event tracer
+ *
+ * Events are written into a ring of fixed size records. Writers claim a
+ * slot with a single atomic increment of the write index and never take a
+ * lock, so tracing is safe from interrupt context and inside critical
+ * sections. Once the ring wraps the oldest records are overwritten.
+ *
+ * The ring is only read by ktrace_dump(), which stops tracing first so
+ * that no record is being filled in while it is printed.
+ *
+ * Records are stamped with the raw cycle counter, which is cheap to read
+ * from anywhere. The rate is measured against the system clock once, when
+ * tracing is first started, and the dump converts the deltas between
+ * records to usecs. A gap longer than one wrap of the 32 bit counter shows
+ * up short.
+ */
+#include <debug.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arch/ops.h>
+#include <kernel/ktrace.h>
+#include <kernel/thread.h>
+#include <platform.h>
+
+#if WITH_KTRACE
+
+#if (KTRACE_ENTRIES & (KTRACE_ENTRIES - 1)) != 0
+#error KTRACE_ENTRIES must be a power of 2
+#endif
+
+volatile bool ktrace_enabled;
+
+static struct ktrace_record ktrace_buf[KTRACE_ENTRIES];
+/* free running count of records written, wraps at 2^32 */
+static volatile uint ktrace_index;
+
+/* cycle counter rate, 0 if it doesn't seem to be running */
+static uint32_t ktrace_cycles_per_ms;
+
+/* how long ktrace_calibrate() watches the cycle counter for */
+#define KTRACE_CALIBRATE_USECS 10000
+
+static const char *ktrace_event_names[KTRACE_EVENT_COUNT] = {
+	[KTRACE_NONE] = "none",
+	[KTRACE_CONTEXT_SWITCH] = "cswitch",
+	[KTRACE_IRQ_ENTER] = "irq enter",
+	[KTRACE_IRQ_EXIT] = "irq exit",
+	[KTRACE_TIMER_CALLBACK] = "timer",
+	[KTRACE_DPC] = "dpc",
+	[KTRACE_MUTEX_BLOCK] = "mutex block",
+	[KTRACE_MUTEX_WAKE] = "mutex wake",
+};
+
+void ktrace_record_event(uint event, uint32_t a, uint32_t b)
+{
+	/* claim a slot, the ring wraps over the oldest records */
+	uint index = (uint)atomic_add((volatile int *)&ktrace_index, 1) & (KTRACE_ENTRIES - 1);
+	struct ktrace_record *r = &ktrace_buf[index];
+
+	r->timestamp = arch_cycle_count();
+	r->event = event;
+	r->reserved = 0;
+	r->a = a;
+	r->b = b;
+}
+
+static void ktrace_calibrate(void)
+{
+	bigtime_t start = current_time_hires();
+	uint32_t cycles = arch_cycle_count();
+
+	while (current_time_hires() - start < KTRACE_CALIBRATE_USECS)
+		;
+
+	cycles = arch_cycle_count() - cycles;
+	ktrace_cycles_per_ms = cycles / (KTRACE_CALIBRATE_USECS / 1000);
+
+	dprintf(INFO, "ktrace: cycle counter runs at %u cycles/ms\n", ktrace_cycles_per_ms);
+}
+
+/* convert a cycle count to usecs, or leave it alone if the rate isn't known */
+static uint32_t ktrace_cycles_to_usecs(uint32_t cycles)
+{
+	if (ktrace_cycles_per_ms == 0)
+		return cycles;
+
+	return ((uint64_t)cycles * 1000) / ktrace_cycles_per_ms;
+}
+
+void ktrace_start(void)
+{
+	ktrace_enabled = false;
+
+	if (ktrace_cycles_per_ms == 0)
+		ktrace_calibrate();
+
+	memset(ktrace_buf, 0, sizeof(ktrace_buf));
+	ktrace_index = 0;
+
+	ktrace_enabled = true;
+}
+
+void ktrace_stop(void)
+{
+	ktrace_enabled = false;
+}
+
+void ktrace_dump(void)
+{
+	bool was_enabled = ktrace_enabled;
+
+	ktrace_stop();
+
+	/* the last shown records end at count, unsigned math keeps that right across a wrap */
+	uint count = ktrace_index;
+	uint shown = MIN(count, KTRACE_ENTRIES);
+	uint start = count - shown;
+	uint i;
+
+	if (start != 0)
+		printf("ktrace: %u records, %u lost to wrap\n", shown, start);
+	else
+		printf("ktrace: %u records\n", shown);
+
+	/* times are usecs since the first record shown, or raw cycles if the rate isn't known */
+	if (ktrace_cycles_per_ms == 0)
+		printf("ktrace: cycle counter not running, times are in cycles\n");
+
+	uint32_t last = 0;
+	uint32_t time = 0;
+	for (i = 0; i < shown; i++) {
+		const struct ktrace_record *r = &ktrace_buf[(start + i) & (KTRACE_ENTRIES - 1)];
+
+		uint32_t delta = (i == 0) ? 0 : ktrace_cycles_to_usecs(r->timestamp - last);
+		last = r->timestamp;
+		time += delta;
+
+		const char *name = (r->event < KTRACE_EVENT_COUNT) ? ktrace_event_names[r->event] : "unknown";
+
+		printf("%10u +%6u %-12s 0x%08x 0x%08x\n", time, delta, name, r->a, r->b);
+	}
+
+	if (was_enabled)
+		ktrace_enabled = true;
+}
+
+#if WITH_LIB_CONSOLE
+#include <lib/console.h>
+
+static int cmd_ktrace(int argc, const cmd_args *argv);
+
+STATIC_COMMAND_START
+STATIC_COMMAND("ktrace", "kernel event tracer", &cmd_ktrace)
+STATIC_COMMAND_END(ktrace);
+
+static int cmd_ktrace(int argc, const cmd_args *argv)
+{
+	if (argc < 2) {
+		printf("not enough arguments:\n");
+usage:
+		printf("%s start\n", argv[0].str);
+		printf("%s stop\n", argv[0].str);
+		printf("%s dump\n", argv[0].str);
+		return -1;
+	}
+
+	if (!strcmp(argv[1].str, "start")) {
+		ktrace_start();
+	} else if (!strcmp(argv[1].str, "stop")) {
+		ktrace_stop();
+	} else if (!strcmp(argv[1].str, "dump")) {
+		ktrace_dump();
+	} else {
+		printf("unrecognized subcommand\n");
+		goto usage;
+	}
+
+	return 0;
+}
+
+#endif
+
+#endif
+
@@ -131,6 +131,12 @@ static int bootstrap2(void *arg)
 	dprintf(SPEW, "calling apps_init()\n");
 	apps_init();
 
+#if THREAD_STACK_HIGHWATER && THREAD_STACK_REPORT_DELAY
+	// let the apps run for a while, then see how much stack they needed
+	thread_sleep(THREAD_STACK_REPORT_DELAY);
+	thread_stack_report();
+#endif
+
 	return 0;
 }
 
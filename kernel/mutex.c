@@ -32,13 +32,144 @@
 #include <debug.h>
 #include <assert.h>
 #include <err.h>
+#include <string.h>
 #include <kernel/mutex.h>
 #include <kernel/thread.h>
+#include <kernel/ktrace.h>
+#include <platform.h>
 
 #if DEBUGLEVEL > 1
 #define MUTEX_CHECK 1
 #endif
 
+#if WITH_LOCK_PROFILING
+/* mutexes registered with a name, in registration order */
+static struct list_node mutex_profile_list = LIST_INITIAL_VALUE(mutex_profile_list);
+
+static void mutex_profile_acquired(mutex_t *m)
+{
+	m->profile.acquired_at = current_time_hires();
+	m->profile.acquisitions++;
+}
+
+static void mutex_profile_released(mutex_t *m)
+{
+	bigtime_t hold = current_time_hires() - m->profile.acquired_at;
+
+	m->profile.total_hold += hold;
+	if (hold > m->profile.max_hold)
+		m->profile.max_hold = hold;
+}
+
+static void mutex_profile_waited(mutex_t *m, bigtime_t start)
+{
+	bigtime_t wait = current_time_hires() - start;
+
+	m->profile.contended++;
+	m->profile.total_wait += wait;
+	if (wait > m->profile.max_wait)
+		m->profile.max_wait = wait;
+}
+#endif
+
+/* the highest priority of any thread waiting on a mutex */
+static int mutex_highest_waiter_priority(mutex_t *m)
+{
+	thread_t *t;
+	int priority = LOWEST_PRIORITY;
+
+	list_for_every_entry(&m->wait.list, t, thread_t, queue_node) {
+		if (t->priority > priority)
+			priority = t->priority;
+	}
+
+	return priority;
+}
+
+static thread_t *mutex_highest_waiter(mutex_t *m)
+{
+	thread_t *t;
+	thread_t *highest = NULL;
+
+	list_for_every_entry(&m->wait.list, t, thread_t, queue_node) {
+		if (!highest || t->priority > highest->priority)
+			highest = t;
+	}
+
+	return highest;
+}
+
+/*
+ * boost the holder of a mutex to at least the given priority, following the
+ * chain of holders that are themselves blocked on another mutex.
+ */
+static void mutex_boost_holder(mutex_t *m, int priority)
+{
+	thread_t *t = m->holder;
+
+	while (t && t->priority < priority) {
+		thread_set_effective_priority(t, priority);
+
+		if (!t->blocking_mutex)
+			break;
+		t = t->blocking_mutex->holder;
+	}
+}
+
+/*
+ * recompute the priority of a thread from its base priority and the waiters
+ * on the mutexes it still holds, and propagate any change down the chain of
+ * holders it is blocked behind. must be called inside a critical section.
+ */
+void mutex_update_priority(thread_t *t)
+{
+	while (t) {
+		mutex_t *m;
+		int priority = t->base_priority;
+
+		list_for_every_entry(&t->held_mutexes, m, mutex_t, held_node) {
+			int waiter = mutex_highest_waiter_priority(m);
+			if (waiter > priority)
+				priority = waiter;
+		}
+
+		if (priority == t->priority)
+			break;
+
+		thread_set_effective_priority(t, priority);
+
+		if (!t->blocking_mutex)
+			break;
+		t = t->blocking_mutex->holder;
+	}
+}
+
+static void mutex_set_holder(mutex_t *m, thread_t *t)
+{
+	m->holder = t;
+	list_add_tail(&t->held_mutexes, &m->held_node);
+
+#if WITH_LOCK_PROFILING
+	mutex_profile_acquired(m);
+#endif
+}
+
+/* hand an unowned mutex to the highest priority waiter, if there is one */
+static void mutex_wake_next(mutex_t *m, bool reschedule)
+{
+	thread_t *t = mutex_highest_waiter(m);
+
+	/* a waiter that timed out but hasn't run yet may still be counted */
+	if (!t)
+		return;
+
+	KTRACE(KTRACE_MUTEX_WAKE, m, t);
+
+	mutex_set_holder(m, t);
+	mutex_update_priority(t);
+	thread_unblock_from_wait_queue(t, reschedule, NO_ERROR);
+}
+
 /**
  * @brief  Initialize a mutex_t
  */
@@ -51,7 +182,13 @@ void mutex_init(mutex_t *m)
 	m->magic = MUTEX_MAGIC;
 	m->count = 0;
 	m->holder = 0;
+	list_clear_node(&m->held_node);
 	wait_queue_init(&m->wait);
+
+#if WITH_LOCK_PROFILING
+	memset(&m->profile, 0, sizeof(m->profile));
+	list_clear_node(&m->profile.node);
+#endif
 }
 
 /**
@@ -74,21 +211,100 @@ void mutex_destroy(mutex_t *m)
 
 	m->magic = 0;
 	m->count = 0;
+	if (m->holder) {
+		/* the holder no longer inherits anything through this mutex */
+		list_delete(&m->held_node);
+		mutex_update_priority(m->holder);
+		m->holder = 0;
+	}
+
+#if WITH_LOCK_PROFILING
+	if (list_in_list(&m->profile.node))
+		list_delete(&m->profile.node);
+#endif
+
 	wait_queue_destroy(&m->wait, true);
 	exit_critical_section();
 }
 
+/* common acquire path, must be called inside a critical section */
+static status_t mutex_acquire_internal(mutex_t *m, time_t timeout)
+{
+	status_t ret = NO_ERROR;
+
+#if MUTEX_CHECK
+	ASSERT(m->magic == MUTEX_MAGIC);
+#endif
+
+	m->count++;
+	if (unlikely(m->count > 1)) {
+		/* lend our priority to the holder before we go to sleep */
+		current_thread->blocking_mutex = m;
+		mutex_boost_holder(m, current_thread->priority);
+
+		KTRACE(KTRACE_MUTEX_BLOCK, m, m->holder);
+#if WITH_LOCK_PROFILING
+		bigtime_t wait_start = current_time_hires();
+#endif
+		ret = wait_queue_block(&m->wait, timeout);
+
+		current_thread->blocking_mutex = NULL;
+
+#if WITH_LOCK_PROFILING
+		if (ret != ERR_OBJECT_DESTROYED)
+			mutex_profile_waited(m, wait_start);
+#endif
+
+		if (ret < NO_ERROR) {
+			/* if the acquisition timed out, back out the acquire and exit */
+			if (ret == ERR_TIMED_OUT) {
+				/* 
+				 * XXX race: the mutex may have been destroyed after the timeout,
+				 * but before we got scheduled again which makes messing with the
+				 * count variable dangerous.
+				 */
+				m->count--;
+
+				/*
+				 * the holder may no longer need the priority we lent it. if it
+				 * released the mutex while we were timing out, there was nobody
+				 * to hand it to, so pass it on to the next waiter now.
+				 */
+				if (m->holder)
+					mutex_update_priority(m->holder);
+				else if (m->count >= 1)
+					mutex_wake_next(m, false);
+			}
+			/* if there was a general error, it may have been destroyed out from 
+			 * underneath us, so just exit (which is really an invalid state anyway)
+			 */
+			return ret;
+		}
+
+		/* mutex_release() handed ownership directly to us */
+		DEBUG_ASSERT(m->holder == current_thread);
+		return ret;
+	}
+
+	mutex_set_holder(m, current_thread);
+
+	return ret;
+}
+
 /**
  * @brief  Acquire a mutex; wait if needed.
  *
  * This function waits for a mutex to become available.  It
  * may wait forever if the mutex never becomes free.
  *
+ * While waiting, the holder of the mutex inherits the priority of the
+ * calling thread if it is higher than its own.
+ *
  * @return  NO_ERROR on success, other values on error
  */
 status_t mutex_acquire(mutex_t *m)
 {
-	status_t ret = NO_ERROR;
+	status_t ret;
 
 	if (current_thread == m->holder)
 		panic("mutex_acquire: thread %p (%s) tried to acquire mutex %p it already owns.\n",
@@ -96,26 +312,15 @@ status_t mutex_acquire(mutex_t *m)
 
 	enter_critical_section();
 
-#if MUTEX_CHECK
-	ASSERT(m->magic == MUTEX_MAGIC);
-#endif
-
 //	dprintf("mutex_acquire: m %p, count %d, curr %p\n", m, m->count, current_thread);
 
-	m->count++;
-	if (unlikely(m->count > 1)) {
-		/* 
-		 * block on the wait queue. If it returns an error, it was likely destroyed
-		 * out from underneath us, so make sure we dont scribble thread ownership 
-		 * on the mutex.
-		 */
-		ret = wait_queue_block(&m->wait, INFINITE_TIME);
-		if (ret < 0)
-			goto err;
-	}
-	m->holder = current_thread;	
+	/* 
+	 * block on the wait queue. If it returns an error, it was likely destroyed
+	 * out from underneath us, so make sure we dont scribble thread ownership 
+	 * on the mutex.
+	 */
+	ret = mutex_acquire_internal(m, INFINITE_TIME);
 
-err:
 	exit_critical_section();
 
 	return ret;
@@ -128,12 +333,15 @@ err:
  * Timeout may be zero, in which case this function returns immediately if
  * the mutex is not free.
  *
+ * If the wait times out, any priority the holder inherited from the
+ * calling thread is given back.
+ *
  * @return  NO_ERROR on success, ERR_TIMED_OUT on timeout,
  * other values on error
  */
 status_t mutex_acquire_timeout(mutex_t *m, time_t timeout)
 {
-	status_t ret = NO_ERROR;
+	status_t ret;
 
 	if (current_thread == m->holder)
 		panic("mutex_acquire_timeout: thread %p (%s) tried to acquire mutex %p it already owns.\n",
@@ -144,34 +352,10 @@ status_t mutex_acquire_timeout(mutex_t *m, time_t timeout)
 
 	enter_critical_section();
 
-#if MUTEX_CHECK
-	ASSERT(m->magic == MUTEX_MAGIC);
-#endif
-
 //	dprintf("mutex_acquire_timeout: m %p, count %d, curr %p, timeout %d\n", m, m->count, current_thread, timeout);
 
-	m->count++;
-	if (unlikely(m->count > 1)) {
-		ret = wait_queue_block(&m->wait, timeout);
-		if (ret < NO_ERROR) {
-			/* if the acquisition timed out, back out the acquire and exit */
-			if (ret == ERR_TIMED_OUT) {
-				/* 
-				 * XXX race: the mutex may have been destroyed after the timeout,
-				 * but before we got scheduled again which makes messing with the
-				 * count variable dangerous.
-				 */
-				m->count--;
-				goto err;
-			}
-			/* if there was a general error, it may have been destroyed out from 
-			 * underneath us, so just exit (which is really an invalid state anyway)
-			 */
-		}	
-	}
-	m->holder = current_thread;	
+	ret = mutex_acquire_internal(m, timeout);
 
-err:
 	exit_critical_section();
 
 	return ret;
@@ -179,6 +363,9 @@ err:
 
 /**
  * @brief  Release mutex
+ *
+ * Any priority inherited through this mutex is dropped, and ownership is
+ * passed to the highest priority waiter, if any.
  */
 status_t mutex_release(mutex_t *m)
 {
@@ -194,12 +381,19 @@ status_t mutex_release(mutex_t *m)
 
 //	dprintf("mutex_release: m %p, count %d, holder %p, curr %p\n", m, m->count, m->holder, current_thread);
 
+#if WITH_LOCK_PROFILING
+	mutex_profile_released(m);
+#endif
+
 	m->holder = 0;
+	list_delete(&m->held_node);
+	mutex_update_priority(current_thread);
+
 	m->count--;
 	if (unlikely(m->count >= 1)) {
-		/* release a thread */
+		/* hand the mutex to the highest priority waiter and release it */
 //		dprintf("releasing thread\n");
-		wait_queue_wake_one(&m->wait, true, NO_ERROR);
+		mutex_wake_next(m, true);
 	}
 
 	exit_critical_section();
@@ -207,3 +401,116 @@ status_t mutex_release(mutex_t *m)
 	return NO_ERROR;
 }
 
+#if WITH_LOCK_PROFILING
+
+/* most locks the "locks" command lists at once */
+#define MUTEX_PROFILE_TOP 16
+
+/**
+ * @brief  Give a mutex a name and list it in the lock profile
+ */
+void mutex_register(mutex_t *m, const char *name)
+{
+	enter_critical_section();
+
+#if MUTEX_CHECK
+	ASSERT(m->magic == MUTEX_MAGIC);
+#endif
+
+	m->profile.name = name;
+	if (!list_in_list(&m->profile.node))
+		list_add_tail(&mutex_profile_list, &m->profile.node);
+
+	exit_critical_section();
+}
+
+/**
+ * @brief  Print the most contended of the registered mutexes
+ */
+void mutex_profile_dump(uint count)
+{
+	struct mutex_profile top[MUTEX_PROFILE_TOP];
+	struct mutex_profile *p;
+	uint found = 0;
+	uint i;
+
+	if (count > MUTEX_PROFILE_TOP)
+		count = MUTEX_PROFILE_TOP;
+
+	/* insertion sort a snapshot of the counters, most contended first */
+	enter_critical_section();
+	list_for_every_entry(&mutex_profile_list, p, struct mutex_profile, node) {
+		for (i = found; i > 0 && top[i - 1].contended < p->contended; i--) {
+			if (i < count)
+				top[i] = top[i - 1];
+		}
+		if (i < count) {
+			top[i] = *p;
+			if (found < count)
+				found++;
+		}
+	}
+	exit_critical_section();
+
+	printf("%-16s %10s %10s %12s %10s %12s %10s\n", "name", "acquires", "contended",
+		"wait total", "wait max", "hold total", "hold max");
+	for (i = 0; i < found; i++) {
+		p = &top[i];
+		printf("%-16s %10u %10u %12llu %10llu %12llu %10llu\n", p->name, p->acquisitions, p->contended,
+			p->total_wait, p->max_wait, p->total_hold, p->max_hold);
+	}
+}
+
+/**
+ * @brief  Zero the counters of every registered mutex
+ */
+void mutex_profile_reset(void)
+{
+	struct mutex_profile *p;
+
+	enter_critical_section();
+	list_for_every_entry(&mutex_profile_list, p, struct mutex_profile, node) {
+		p->acquisitions = 0;
+		p->contended = 0;
+		p->total_wait = 0;
+		p->max_wait = 0;
+		p->total_hold = 0;
+		p->max_hold = 0;
+	}
+	exit_critical_section();
+}
+
+#if WITH_LIB_CONSOLE
+#include <lib/console.h>
+
+static int cmd_locks(int argc, const cmd_args *argv);
+
+STATIC_COMMAND_START
+STATIC_COMMAND("locks", "mutex contention profile", &cmd_locks)
+STATIC_COMMAND_END(locks);
+
+static int cmd_locks(int argc, const cmd_args *argv)
+{
+	if (argc < 2) {
+		printf("not enough arguments:\n");
+usage:
+		printf("%s list [count]\n", argv[0].str);
+		printf("%s reset\n", argv[0].str);
+		return -1;
+	}
+
+	if (!strcmp(argv[1].str, "list")) {
+		mutex_profile_dump((argc >= 3) ? argv[2].u : 10);
+	} else if (!strcmp(argv[1].str, "reset")) {
+		mutex_profile_reset();
+	} else {
+		printf("unrecognized subcommand\n");
+		goto usage;
+	}
+
+	return 0;
+}
+
+#endif
+
+#endif
@@ -0,0 +1,262 @@
+/*
+ * Copyright (c) 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file
+ * @brief  Message ports
+ *
+ * A port is a fixed size ring of message pointers with a wait queue for
+ * each side. Messages are handed over by pointer, so the cost of a send
+ * doesn't depend on the size of the message.
+ *
+ * @defgroup port Ports
+ * @{
+ */
+
+#include <debug.h>
+#include <assert.h>
+#include <err.h>
+#include <kernel/port.h>
+#include <kernel/thread.h>
+#include <platform.h>
+
+#if DEBUGLEVEL > 1
+#define PORT_CHECK 1
+#endif
+
+/* how much longer a sender or receiver may block, 0 once its deadline has passed */
+static time_t port_time_left(time_t timeout, time_t deadline)
+{
+	if (timeout == INFINITE_TIME)
+		return INFINITE_TIME;
+
+	time_t now = current_time();
+
+	return TIME_LT(now, deadline) ? deadline - now : 0;
+}
+
+/**
+ * @brief  Initialize a port
+ *
+ * @param p         Port object to initialize
+ * @param ring      Storage for capacity message pointers
+ * @param capacity  Most messages the port holds at once
+ */
+void port_init(port_t *p, void **ring, uint capacity)
+{
+	DEBUG_ASSERT(ring);
+	DEBUG_ASSERT(capacity > 0);
+
+	p->magic = PORT_MAGIC;
+	p->ring = ring;
+	p->capacity = capacity;
+	p->head = 0;
+	p->count = 0;
+	wait_queue_init(&p->send_wait);
+	wait_queue_init(&p->receive_wait);
+
+	p->sent = 0;
+	p->received = 0;
+	p->dropped = 0;
+	p->max_depth = 0;
+}
+
+/**
+ * @brief  Destroy a port
+ *
+ * Threads blocked on the port are released with ERR_OBJECT_DESTROYED.
+ * Messages still queued are not freed, the ring and whatever it points at
+ * belong to the caller.
+ */
+void port_destroy(port_t *p)
+{
+	enter_critical_section();
+
+#if PORT_CHECK
+	ASSERT(p->magic == PORT_MAGIC);
+#endif
+
+	p->magic = 0;
+	p->count = 0;
+	wait_queue_destroy(&p->send_wait, false);
+	wait_queue_destroy(&p->receive_wait, true);
+
+	exit_critical_section();
+}
+
+/* queue a message on a port with room for it, must be inside a critical section */
+static void port_enqueue(port_t *p, void *msg, bool reschedule)
+{
+	p->ring[(p->head + p->count) % p->capacity] = msg;
+	p->count++;
+
+	p->sent++;
+	if (p->count > p->max_depth)
+		p->max_depth = p->count;
+
+	wait_queue_wake_one(&p->receive_wait, reschedule, NO_ERROR);
+}
+
+/**
+ * @brief  Send a message, waiting for room if the port is full
+ *
+ * @param p        Port object
+ * @param msg      Message to send, ownership passes to the receiver
+ * @param timeout  Timeout value, in ms. 0 fails immediately if the port is full.
+ *
+ * @return  NO_ERROR on success, ERR_TIMED_OUT if the port stayed full,
+ *          other values on other errors.
+ */
+status_t port_send(port_t *p, void *msg, time_t timeout)
+{
+	status_t ret = NO_ERROR;
+	time_t deadline = current_time() + timeout;
+
+	enter_critical_section();
+
+#if PORT_CHECK
+	ASSERT(p->magic == PORT_MAGIC);
+#endif
+
+	while (p->count == p->capacity) {
+		time_t left = port_time_left(timeout, deadline);
+		if (left == 0) {
+			p->dropped++;
+			ret = ERR_TIMED_OUT;
+			goto out;
+		}
+
+		/* a receiver wakes us when it takes a message, someone else may beat us to the slot */
+		ret = wait_queue_block(&p->send_wait, left);
+		if (ret < 0) {
+			if (ret == ERR_TIMED_OUT)
+				p->dropped++;
+			goto out;
+		}
+	}
+
+	port_enqueue(p, msg, true);
+
+out:
+	exit_critical_section();
+
+	return ret;
+}
+
+/**
+ * @brief  Send a message from interrupt context
+ *
+ * Never blocks and never reschedules.
+ *
+ * @return  NO_ERROR on success, ERR_TIMED_OUT if the port was full.
+ */
+status_t port_send_irq(port_t *p, void *msg)
+{
+	status_t ret = NO_ERROR;
+
+	enter_critical_section();
+
+#if PORT_CHECK
+	ASSERT(p->magic == PORT_MAGIC);
+#endif
+
+	if (p->count == p->capacity) {
+		p->dropped++;
+		ret = ERR_TIMED_OUT;
+	} else {
+		port_enqueue(p, msg, false);
+	}
+
+	exit_critical_section();
+
+	return ret;
+}
+
+/**
+ * @brief  Receive a message, waiting for one if the port is empty
+ *
+ * @param p        Port object
+ * @param msg      Set to the message received, which now belongs to the caller
+ * @param timeout  Timeout value, in ms. 0 fails immediately if the port is empty.
+ *
+ * @return  NO_ERROR on success, ERR_TIMED_OUT if nothing arrived,
+ *          other values on other errors.
+ */
+status_t port_receive(port_t *p, void **msg, time_t timeout)
+{
+	status_t ret = NO_ERROR;
+	time_t deadline = current_time() + timeout;
+
+	enter_critical_section();
+
+#if PORT_CHECK
+	ASSERT(p->magic == PORT_MAGIC);
+#endif
+
+	while (p->count == 0) {
+		/* another receiver may take the message we were woken for, only wait out what is left */
+		time_t left = port_time_left(timeout, deadline);
+		if (left == 0) {
+			ret = ERR_TIMED_OUT;
+			goto out;
+		}
+
+		ret = wait_queue_block(&p->receive_wait, left);
+		if (ret < 0)
+			goto out;
+	}
+
+	*msg = p->ring[p->head];
+	p->head = (p->head + 1) % p->capacity;
+	p->count--;
+	p->received++;
+
+	wait_queue_wake_one(&p->send_wait, true, NO_ERROR);
+
+out:
+	exit_critical_section();
+
+	return ret;
+}
+
+/**
+ * @brief  Read the counters of a port
+ */
+void port_get_stats(port_t *p, struct port_stats *stats)
+{
+	enter_critical_section();
+
+#if PORT_CHECK
+	ASSERT(p->magic == PORT_MAGIC);
+#endif
+
+	stats->depth = p->count;
+	stats->max_depth = p->max_depth;
+	stats->sent = p->sent;
+	stats->received = p->received;
+	stats->dropped = p->dropped;
+
+	exit_critical_section();
+}
+
+/** @} */
@@ -9,8 +9,13 @@ OBJS += \
 	$(LOCAL_DIR)/debug.o \
 	$(LOCAL_DIR)/dpc.o \
 	$(LOCAL_DIR)/event.o \
+	$(LOCAL_DIR)/irqoff.o \
+	$(LOCAL_DIR)/ktrace.o \
 	$(LOCAL_DIR)/main.o \
 	$(LOCAL_DIR)/mutex.o \
+	$(LOCAL_DIR)/port.o \
+	$(LOCAL_DIR)/rwlock.o \
+	$(LOCAL_DIR)/semaphore.o \
 	$(LOCAL_DIR)/thread.o \
 	$(LOCAL_DIR)/timer.o
 
@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file
+ * @brief  Reader-writer locks
+ *
+ * @defgroup rwlock Reader-Writer Locks
+ * @{
+ */
+
+#include <debug.h>
+#include <assert.h>
+#include <err.h>
+#include <kernel/rwlock.h>
+#include <kernel/thread.h>
+
+#if DEBUGLEVEL > 1
+#define RWLOCK_CHECK 1
+#endif
+
+/* pass an unheld lock on to the next writer, or failing that to every waiting reader */
+static void rwlock_wake_next(rwlock_t *rw, bool reschedule)
+{
+	thread_t *t = list_peek_head_type(&rw->write_wait.list, thread_t, queue_node);
+
+	if (t) {
+		rw->writer = t;
+		wait_queue_wake_one(&rw->write_wait, reschedule, NO_ERROR);
+	} else if (rw->read_wait.count > 0) {
+		rw->readers += rw->read_wait.count;
+		wait_queue_wake_all(&rw->read_wait, reschedule, NO_ERROR);
+	}
+}
+
+/**
+ * @brief  Initialize a rwlock_t
+ */
+void rwlock_init(rwlock_t *rw)
+{
+	rw->magic = RWLOCK_MAGIC;
+	rw->readers = 0;
+	rw->writer = NULL;
+	wait_queue_init(&rw->read_wait);
+	wait_queue_init(&rw->write_wait);
+}
+
+/**
+ * @brief  Destroy a rwlock_t
+ *
+ * Any threads still waiting are released with ERR_OBJECT_DESTROYED.
+ * The rwlock_t object itself is not freed.
+ */
+void rwlock_destroy(rwlock_t *rw)
+{
+	enter_critical_section();
+
+#if RWLOCK_CHECK
+	ASSERT(rw->magic == RWLOCK_MAGIC);
+#endif
+
+	rw->magic = 0;
+	rw->readers = 0;
+	rw->writer = NULL;
+	wait_queue_destroy(&rw->read_wait, false);
+	wait_queue_destroy(&rw->write_wait, true);
+
+	exit_critical_section();
+}
+
+/**
+ * @brief  Acquire a rwlock shared, with a timeout
+ *
+ * @param rw       The lock
+ * @param timeout  Timeout value, in ms
+ *
+ * @return  NO_ERROR on success, ERR_TIMED_OUT on timeout,
+ *          other values on other errors.
+ */
+status_t rwlock_acquire_read_timeout(rwlock_t *rw, time_t timeout)
+{
+	status_t ret = NO_ERROR;
+
+	enter_critical_section();
+
+#if RWLOCK_CHECK
+	ASSERT(rw->magic == RWLOCK_MAGIC);
+	ASSERT(rw->writer != current_thread);
+#endif
+
+	if (!rw->writer && rw->write_wait.count == 0) {
+		rw->readers++;
+	} else {
+		/* the releasing thread counts us in when it wakes us */
+		ret = wait_queue_block(&rw->read_wait, timeout);
+	}
+
+	exit_critical_section();
+
+	return ret;
+}
+
+/**
+ * @brief  Same as rwlock_acquire_read_timeout(), but without a timeout.
+ */
+status_t rwlock_acquire_read(rwlock_t *rw)
+{
+	return rwlock_acquire_read_timeout(rw, INFINITE_TIME);
+}
+
+/**
+ * @brief  Release a rwlock held shared
+ */
+status_t rwlock_release_read(rwlock_t *rw)
+{
+	enter_critical_section();
+
+#if RWLOCK_CHECK
+	ASSERT(rw->magic == RWLOCK_MAGIC);
+	ASSERT(rw->readers > 0);
+#endif
+
+	rw->readers--;
+	if (rw->readers == 0)
+		rwlock_wake_next(rw, true);
+
+	exit_critical_section();
+
+	return NO_ERROR;
+}
+
+/**
+ * @brief  Acquire a rwlock exclusive, with a timeout
+ *
+ * @param rw       The lock
+ * @param timeout  Timeout value, in ms
+ *
+ * @return  NO_ERROR on success, ERR_TIMED_OUT on timeout,
+ *          other values on other errors.
+ */
+status_t rwlock_acquire_write_timeout(rwlock_t *rw, time_t timeout)
+{
+	status_t ret = NO_ERROR;
+
+	enter_critical_section();
+
+#if RWLOCK_CHECK
+	ASSERT(rw->magic == RWLOCK_MAGIC);
+	ASSERT(rw->writer != current_thread);
+#endif
+
+	if (!rw->writer && rw->readers == 0) {
+		rw->writer = current_thread;
+	} else {
+		/* the releasing thread makes us the writer when it wakes us */
+		ret = wait_queue_block(&rw->write_wait, timeout);
+
+		/*
+		 * if we timed out as the last writer waiting, readers that
+		 * queued up behind us can go in now.
+		 */
+		if (ret == ERR_TIMED_OUT && !rw->writer && rw->write_wait.count == 0 && rw->read_wait.count > 0) {
+			rw->readers += rw->read_wait.count;
+			wait_queue_wake_all(&rw->read_wait, false, NO_ERROR);
+		}
+	}
+
+	exit_critical_section();
+
+	return ret;
+}
+
+/**
+ * @brief  Same as rwlock_acquire_write_timeout(), but without a timeout.
+ */
+status_t rwlock_acquire_write(rwlock_t *rw)
+{
+	return rwlock_acquire_write_timeout(rw, INFINITE_TIME);
+}
+
+/**
+ * @brief  Release a rwlock held exclusive
+ */
+status_t rwlock_release_write(rwlock_t *rw)
+{
+	enter_critical_section();
+
+#if RWLOCK_CHECK
+	ASSERT(rw->magic == RWLOCK_MAGIC);
+#endif
+
+	if (unlikely(rw->writer != current_thread))
+		panic("rwlock_release_write: thread %p (%s) tried to release rwlock %p it doesn't own. owned by %p (%s)\n",
+				current_thread, current_thread->name, rw, rw->writer, rw->writer ? rw->writer->name : "none");
+
+	rw->writer = NULL;
+	rwlock_wake_next(rw, true);
+
+	exit_critical_section();
+
+	return NO_ERROR;
+}
+
+/** @} */
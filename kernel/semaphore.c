@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file
+ * @brief  Counting semaphores
+ *
+ * @defgroup semaphore Semaphores
+ * @{
+ */
+
+#include <debug.h>
+#include <assert.h>
+#include <err.h>
+#include <kernel/semaphore.h>
+#include <kernel/thread.h>
+
+#if DEBUGLEVEL > 1
+#define SEMAPHORE_CHECK 1
+#endif
+
+/**
+ * @brief  Initialize a semaphore
+ *
+ * @param s      Semaphore object to initialize
+ * @param value  Initial count
+ */
+void sem_init(semaphore_t *s, uint value)
+{
+	s->magic = SEMAPHORE_MAGIC;
+	s->count = value;
+	wait_queue_init(&s->wait);
+}
+
+/**
+ * @brief  Destroy a semaphore
+ *
+ * Any threads still waiting on the semaphore are released with
+ * ERR_OBJECT_DESTROYED.
+ */
+void sem_destroy(semaphore_t *s)
+{
+	enter_critical_section();
+
+#if SEMAPHORE_CHECK
+	ASSERT(s->magic == SEMAPHORE_MAGIC);
+#endif
+
+	s->magic = 0;
+	s->count = 0;
+	wait_queue_destroy(&s->wait, true);
+
+	exit_critical_section();
+}
+
+/**
+ * @brief  Increment a semaphore
+ *
+ * If a thread is waiting it is released and takes the count with it,
+ * otherwise the count is incremented.
+ *
+ * @param s           Semaphore object
+ * @param reschedule  If true, a released thread runs immediately
+ *
+ * @return  NO_ERROR
+ */
+status_t sem_post(semaphore_t *s, bool reschedule)
+{
+	enter_critical_section();
+
+#if SEMAPHORE_CHECK
+	ASSERT(s->magic == SEMAPHORE_MAGIC);
+#endif
+
+	if (wait_queue_wake_one(&s->wait, reschedule, NO_ERROR) <= 0)
+		s->count++;
+
+	exit_critical_section();
+
+	return NO_ERROR;
+}
+
+/**
+ * @brief  Decrement a semaphore, waiting for it to become nonzero
+ *
+ * @param s        Semaphore object
+ * @param timeout  Timeout value, in ms
+ *
+ * @return  NO_ERROR on success, ERR_TIMED_OUT on timeout,
+ *          ERR_OBJECT_DESTROYED if the semaphore was destroyed.
+ */
+status_t sem_timedwait(semaphore_t *s, time_t timeout)
+{
+	status_t ret = NO_ERROR;
+
+	enter_critical_section();
+
+#if SEMAPHORE_CHECK
+	ASSERT(s->magic == SEMAPHORE_MAGIC);
+#endif
+
+	if (s->count > 0) {
+		s->count--;
+	} else {
+		/* sem_post() hands over the count when it wakes us */
+		ret = wait_queue_block(&s->wait, timeout);
+	}
+
+	exit_critical_section();
+
+	return ret;
+}
+
+/**
+ * @brief  Same as sem_timedwait(), but without a timeout.
+ */
+status_t sem_wait(semaphore_t *s)
+{
+	return sem_timedwait(s, INFINITE_TIME);
+}
+
+/**
+ * @brief  Decrement a semaphore if it is nonzero, without blocking
+ *
+ * @return  NO_ERROR on success, ERR_TIMED_OUT if the count was zero.
+ */
+status_t sem_trywait(semaphore_t *s)
+{
+	return sem_timedwait(s, 0);
+}
+
+/** @} */
@@ -34,12 +34,17 @@
 #include <assert.h>
 #include <list.h>
 #include <malloc.h>
+#include <stdlib.h>
 #include <string.h>
 #include <err.h>
 #include <kernel/thread.h>
 #include <kernel/timer.h>
 #include <kernel/dpc.h>
+#include <kernel/mutex.h>
+#include <kernel/ktrace.h>
+#include <lib/kmem_cache.h>
 #include <platform.h>
+#include <platform/mp.h>
 
 #if DEBUGLEVEL > 1
 #define THREAD_CHECKS 1
@@ -52,6 +57,23 @@ struct thread_stats thread_stats;
 /* global thread list */
 static struct list_node thread_list;
 
+#if WITH_SMP
+#if !PLATFORM_HAS_DYNAMIC_TIMER
+#error SMP needs the preemption timer from PLATFORM_HAS_DYNAMIC_TIMER
+#endif
+
+/* the current thread, critical section count, idle thread and run queue of each cpu */
+struct percpu percpu[SMP_MAX_CPUS];
+
+volatile uint32_t mp_active_cpus;
+volatile uint32_t mp_idle_cpus;
+
+/* serializes critical sections across cpus */
+spin_lock_t thread_lock = SPIN_LOCK_INITIAL_VALUE;
+
+/* the idle threads of the secondary cpus (statically allocated) */
+static thread_t secondary_idle_threads[SMP_MAX_CPUS - 1];
+#else
 /* the current thread */
 thread_t *current_thread;
 
@@ -61,23 +83,122 @@ int critical_section_count;
 /* the run queue */
 static struct list_node run_queue[NUM_PRIORITIES];
 static uint32_t run_queue_bitmap;
+#endif
+
+#if WITH_EDF
+/* runnable deadline threads, sorted by absolute deadline, shared by all cpus */
+static struct list_node edf_run_queue = LIST_INITIAL_VALUE(edf_run_queue);
+
+/* sum of the admitted deadline threads' utilization */
+static uint edf_utilization;
+
+#define thread_is_edf(t) ((t)->edf.period != 0)
+#else
+#define thread_is_edf(t) false
+#endif
 
 /* the bootstrap thread (statically allocated) */
 static thread_t bootstrap_thread;
 
+#if !WITH_SMP
 /* the idle thread */
 thread_t *idle_thread;
+#endif
 
 /* local routines */
 static void thread_resched(void);
 static void idle_thread_routine(void) __NO_RETURN;
+#if WITH_SMP
+static int run_queue_top_priority(struct percpu *c);
+#endif
 
 #if PLATFORM_HAS_DYNAMIC_TIMER
 /* preemption timer */
 static timer_t preempt_timer;
+
+static enum handler_return thread_preempt_timer_tick(timer_t *timer, time_t now, void *arg)
+{
+#if WITH_SMP
+	/*
+	 * kernel timers only fire on the boot cpu, pass the tick on to the other
+	 * busy cpus. a cpu with nothing else queued has nothing to preempt for,
+	 * so it's left alone unless a deadline thread is waiting for a cpu.
+	 */
+	uint32_t busy = mp_active_cpus & ~mp_idle_cpus & ~(1U << arch_curr_cpu_num());
+#if WITH_EDF
+	if (list_is_empty(&edf_run_queue))
+#endif
+	{
+		uint i;
+		for (i = 0; i < SMP_MAX_CPUS; i++) {
+			if ((busy & (1U << i)) && run_queue_top_priority(&percpu[i]) < 0)
+				busy &= ~(1U << i);
+		}
+	}
+	if (busy)
+		platform_mp_send_ipi(busy, MP_IPI_TIMER);
+#endif
+
+	return thread_timer_tick();
+}
+#endif
+
+#if WITH_SMP
+/* poke an idle cpu so it comes and steals the thread we just queued */
+static void mp_kick_idle_cpu(void)
+{
+	uint32_t idle = mp_idle_cpus & ~(1U << arch_curr_cpu_num());
+
+	if (idle)
+		platform_mp_send_ipi(1U << __builtin_ctz(idle), MP_IPI_RESCHEDULE);
+}
 #endif
 
 /* run queue manipulation */
+#if WITH_EDF
+static void insert_in_edf_run_queue(thread_t *t, bool head)
+{
+	thread_t *entry;
+
+	/* a thread out of budget stays off the queues until its next release */
+	if (t->edf.throttled)
+		return;
+
+	list_for_every_entry(&edf_run_queue, entry, thread_t, queue_node) {
+		if (TIME_LT(t->edf.abs_deadline, entry->edf.abs_deadline) ||
+				(head && t->edf.abs_deadline == entry->edf.abs_deadline)) {
+			/* add it before this entry */
+			list_add_tail(&entry->queue_node, &t->queue_node);
+			goto done;
+		}
+	}
+	list_add_tail(&edf_run_queue, &t->queue_node);
+
+done:
+#if WITH_SMP
+	if (t != current_thread)
+		mp_kick_idle_cpu();
+#endif
+	return;
+}
+#endif
+
+#if WITH_SMP
+static void run_queue_add(struct percpu *c, thread_t *t, bool head)
+{
+	arch_spin_lock(&c->run_queue_lock);
+
+	t->curr_cpu = c->cpu_num;
+	if (head)
+		list_add_head(&c->run_queue[t->priority], &t->queue_node);
+	else
+		list_add_tail(&c->run_queue[t->priority], &t->queue_node);
+	c->run_queue_bitmap |= (1<<t->priority);
+
+	arch_spin_unlock(&c->run_queue_lock);
+}
+#endif
+
 static void insert_in_run_queue_head(thread_t *t)
 {
 #if THREAD_CHECKS
@@ -87,8 +208,28 @@ static void insert_in_run_queue_head(thread_t *t)
 	ASSERT(in_critical_section());
 #endif
 
+#if WITH_EDF
+	if (thread_is_edf(t)) {
+		insert_in_edf_run_queue(t, true);
+		return;
+	}
+#endif
+
+#if WITH_SMP
+	struct percpu *c = get_percpu();
+
+	/* idle threads run when their cpu finds nothing else, they are never queued */
+	if (t == c->idle)
+		return;
+
+	run_queue_add(c, t, true);
+
+	if (t != current_thread)
+		mp_kick_idle_cpu();
+#else
 	list_add_head(&run_queue[t->priority], &t->queue_node);
 	run_queue_bitmap |= (1<<t->priority);
+#endif
 }
 
 static void insert_in_run_queue_tail(thread_t *t)
@@ -100,70 +241,542 @@ static void insert_in_run_queue_tail(thread_t *t)
 	ASSERT(in_critical_section());
 #endif
 
+#if WITH_EDF
+	if (thread_is_edf(t)) {
+		insert_in_edf_run_queue(t, false);
+		return;
+	}
+#endif
+
+#if WITH_SMP
+	struct percpu *c = get_percpu();
+
+	if (t == c->idle)
+		return;
+
+	run_queue_add(c, t, false);
+
+	if (t != current_thread)
+		mp_kick_idle_cpu();
+#else
 	list_add_tail(&run_queue[t->priority], &t->queue_node);
 	run_queue_bitmap |= (1<<t->priority);
+#endif
 }
 
+static void remove_from_run_queue(thread_t *t)
+{
+	if (thread_is_edf(t)) {
+		list_delete(&t->queue_node);
+		return;
+	}
+
+#if WITH_SMP
+	struct percpu *c = &percpu[t->curr_cpu];
+
+	arch_spin_lock(&c->run_queue_lock);
+	list_delete(&t->queue_node);
+	if (list_is_empty(&c->run_queue[t->priority]))
+		c->run_queue_bitmap &= ~(1<<t->priority);
+	arch_spin_unlock(&c->run_queue_lock);
+#else
+	list_delete(&t->queue_node);
+	if (list_is_empty(&run_queue[t->priority]))
+		run_queue_bitmap &= ~(1<<t->priority);
+#endif
+}
+
+#if WITH_SMP
+/* pop the highest priority thread off a cpu's run queue */
+static thread_t *run_queue_pop(struct percpu *c)
+{
+	thread_t *t = NULL;
+
+	arch_spin_lock(&c->run_queue_lock);
+
+	if (c->run_queue_bitmap != 0) {
+		int next_queue = HIGHEST_PRIORITY - __builtin_clz(c->run_queue_bitmap) - (32 - NUM_PRIORITIES);
+
+		t = list_remove_head_type(&c->run_queue[next_queue], thread_t, queue_node);
+		if (list_is_empty(&c->run_queue[next_queue]))
+			c->run_queue_bitmap &= ~(1<<next_queue);
+	}
+
+	arch_spin_unlock(&c->run_queue_lock);
+
+	return t;
+}
+
+/* the highest priority waiting in a cpu's run queue, -1 if it's empty */
+static int run_queue_top_priority(struct percpu *c)
+{
+	int priority = -1;
+
+	arch_spin_lock(&c->run_queue_lock);
+	if (c->run_queue_bitmap != 0)
+		priority = HIGHEST_PRIORITY - __builtin_clz(c->run_queue_bitmap) - (32 - NUM_PRIORITIES);
+	arch_spin_unlock(&c->run_queue_lock);
+
+	return priority;
+}
+
+/* our run queue is empty, take the highest priority thread waiting on another cpu */
+static thread_t *steal_thread(struct percpu *c)
+{
+	struct percpu *victim = NULL;
+	uint32_t best = 0;
+	uint i;
+
+	/*
+	 * the scan peeks at the bitmaps without their locks, so the victim's
+	 * queue may have emptied by the time we pop it. that just means there
+	 * was nothing to steal.
+	 */
+	for (i = 0; i < SMP_MAX_CPUS; i++) {
+		if (i == c->cpu_num || !(mp_active_cpus & (1U << i)))
+			continue;
+
+		/* a higher bitmap value always has a higher top priority */
+		uint32_t bitmap = *(volatile uint32_t *)&percpu[i].run_queue_bitmap;
+		if (bitmap > best) {
+			best = bitmap;
+			victim = &percpu[i];
+		}
+	}
+
+	if (!victim)
+		return NULL;
+
+	return run_queue_pop(victim);
+}
+#endif
+
 static void init_thread_struct(thread_t *t, const char *name)
 {
 	memset(t, 0, sizeof(thread_t));
 	t->magic = THREAD_MAGIC;
+	list_initialize(&t->held_mutexes);
+#if WITH_EDF
+	timer_initialize(&t->edf.period_timer);
+	timer_initialize(&t->edf.budget_timer);
+#endif
 	strlcpy(t->name, name, sizeof(t->name));
+	arena_init(&t->scratch, THREAD_SCRATCH_CHUNK_SIZE);
+}
+
+#if WITH_EDF
+/*
+ * earliest deadline first scheduling class
+ *
+ * Deadline threads are released every period with a fresh budget of
+ * runtime, which has to be used up before the absolute deadline of that
+ * job. They sit in their own run queue ordered by absolute deadline,
+ * which is always served before the priority bands. A thread that uses
+ * up its budget is throttled until its next release, so an overrunning
+ * thread cannot steal time admitted to the others.
+ */
+static enum handler_return edf_budget_expired(timer_t *timer, time_t now, void *arg);
+
+/* charge the time run since the last charge against the budget */
+static void edf_charge(thread_t *t)
+{
+	bigtime_t now = current_time_hires();
+
+	t->edf.budget -= (int)(now - t->edf.last_start);
+	t->edf.last_start = now;
+}
+
+/* the thread is being switched in, start timing its budget */
+static void edf_start_budget(thread_t *t)
+{
+	bigtime_t delay = (t->edf.budget > 0) ? (bigtime_t)t->edf.budget : 0;
+
+	t->edf.last_start = current_time_hires();
+	timer_set_oneshot_hires(&t->edf.budget_timer, delay, edf_budget_expired, t);
+}
+
+/* the thread is being switched out */
+static void edf_stop_budget(thread_t *t)
+{
+	timer_cancel(&t->edf.budget_timer);
+	edf_charge(t);
+}
+
+static enum handler_return edf_budget_expired(timer_t *timer, time_t now, void *arg)
+{
+	thread_t *t = (thread_t *)arg;
+
+	if (t->state != THREAD_RUNNING || !t->edf.period)
+		return INT_NO_RESCHEDULE;
+
+	edf_charge(t);
+	if (t->edf.budget > 0) {
+		/* the timer rounds to ms, run out the rest */
+		edf_start_budget(t);
+		return INT_NO_RESCHEDULE;
+	}
+
+	t->edf.throttled = true;
+	t->edf.overruns++;
+
+#if WITH_SMP
+	if (t->curr_cpu != arch_curr_cpu_num()) {
+		platform_mp_send_ipi(1U << t->curr_cpu, MP_IPI_RESCHEDULE);
+		return INT_NO_RESCHEDULE;
+	}
+#endif
+
+	return INT_RESCHEDULE;
+}
+
+/* periodic release of a new job */
+static enum handler_return edf_release(timer_t *timer, time_t now, void *arg)
+{
+	thread_t *t = (thread_t *)arg;
+
+	/* the previous job missed if it hasn't reached thread_wait_period() yet */
+	if (t->state == THREAD_SUSPENDED) {
+		/* not started yet, nothing to miss */
+	} else if (!t->edf.waiting) {
+		t->edf.misses++;
+		t->edf.late = true;
+	} else {
+		t->edf.late = false;
+	}
+
+	t->edf.jobs++;
+	t->edf.abs_deadline = now + t->edf.deadline;
+	t->edf.budget = t->edf.runtime * 1000;
+	t->edf.throttled = false;
+
+	if (t->state == THREAD_RUNNING) {
+		edf_start_budget(t);
+		return INT_NO_RESCHEDULE;
+	}
+
+	if (t->edf.waiting) {
+		t->edf.waiting = false;
+		t->state = THREAD_READY;
+	}
+
+	if (t->state == THREAD_READY) {
+		/* requeue, the new deadline moves it in the queue */
+		if (list_in_list(&t->queue_node))
+			list_delete(&t->queue_node);
+		insert_in_run_queue_head(t);
+		return INT_RESCHEDULE;
+	}
+
+	return INT_NO_RESCHEDULE;
+}
+
+/* take a thread out of the deadline class, the caller requeues it if it's ready */
+static void edf_leave(thread_t *t)
+{
+	if (!t->edf.period)
+		return;
+
+	timer_cancel(&t->edf.period_timer);
+	timer_cancel(&t->edf.budget_timer);
+
+	edf_utilization -= t->edf.utilization;
+	t->edf.period = 0;
+	t->edf.utilization = 0;
+	t->edf.throttled = false;
+
+	if (t->edf.waiting) {
+		t->edf.waiting = false;
+		t->state = THREAD_READY;
+	}
 }
 
 /**
- * @brief  Create a new thread
+ * @brief  Move a thread into the earliest deadline first scheduling class
  *
- * This function creates a new thread.  The thread is initially suspended, so you
- * need to call thread_resume() to execute it.
+ * Deadline threads run ahead of every priority band. The thread is
+ * released every period ms with a budget of runtime ms, which it should
+ * use to finish its work and call thread_wait_period() before deadline ms
+ * have passed since the release. Running past the budget throttles the
+ * thread until the next release; every job not finished by its deadline
+ * counts as a miss.
+ *
+ * A thread is only admitted if the sum of runtime / deadline over all
+ * deadline threads stays at or below 1, which EDF can always schedule.
+ *
+ * @param  t         Thread to change, either the current thread or one that isn't running
+ * @param  period    Release period in ms, or 0 to return the thread to its priority band
+ * @param  runtime   Budget per period in ms
+ * @param  deadline  Relative deadline in ms, at most period. 0 means the period.
+ *
+ * @return NO_ERROR on success, ERR_NOT_ALLOWED if admitting the thread
+ * would overload the cpu.
+ */
+status_t thread_set_deadline(thread_t *t, time_t period, time_t runtime, time_t deadline)
+{
+	status_t err = NO_ERROR;
+	uint utilization = 0;
+
+#if THREAD_CHECKS
+	ASSERT(t->magic == THREAD_MAGIC);
+#endif
+
+	if (deadline == 0)
+		deadline = period;
+
+	if (period != 0) {
+		if (runtime == 0 || deadline > period || runtime > deadline)
+			return ERR_INVALID_ARGS;
+
+		/* round up, admission has to be conservative */
+		utilization = (runtime * EDF_UTIL_SCALE + deadline - 1) / deadline;
+	}
+
+	enter_critical_section();
+
+	if (t->state == THREAD_RUNNING && t != current_thread) {
+		err = ERR_NOT_VALID;
+		goto out;
+	}
+
+	if (edf_utilization - t->edf.utilization + utilization > EDF_UTIL_SCALE) {
+		err = ERR_NOT_ALLOWED;
+		goto out;
+	}
+
+	if (t->state == THREAD_READY && list_in_list(&t->queue_node))
+		remove_from_run_queue(t);
+
+	edf_leave(t);
+
+	if (period != 0) {
+		t->edf.period = period;
+		t->edf.runtime = runtime;
+		t->edf.deadline = deadline;
+		t->edf.utilization = utilization;
+		edf_utilization += utilization;
+
+		/* release the first job now */
+		t->edf.abs_deadline = current_time() + deadline;
+		t->edf.budget = runtime * 1000;
+		t->edf.late = false;
+		t->edf.jobs = 1;
+		t->edf.misses = 0;
+		t->edf.overruns = 0;
+		timer_set_periodic(&t->edf.period_timer, period, edf_release, t);
+
+		if (t == current_thread)
+			edf_start_budget(t);
+	}
+
+	if (t->state == THREAD_READY)
+		insert_in_run_queue_head(t);
+
+out:
+	exit_critical_section();
+
+	return err;
+}
+
+/**
+ * @brief  Finish the current job of a deadline thread
  *
+ * Sleeps until the thread's next release.
+ *
+ * @return NO_ERROR, or ERR_NOT_VALID if the current thread isn't in the
+ * deadline class.
+ */
+status_t thread_wait_period(void)
+{
+	enter_critical_section();
+
+	if (!current_thread->edf.period) {
+		exit_critical_section();
+		return ERR_NOT_VALID;
+	}
+
+	if (!current_thread->edf.late && TIME_GT(current_time(), current_thread->edf.abs_deadline))
+		current_thread->edf.misses++;
+
+	current_thread->edf.waiting = true;
+	current_thread->state = THREAD_SLEEPING;
+	thread_resched();
+
+	exit_critical_section();
+
+	return NO_ERROR;
+}
+
+#else
+
+static inline void edf_leave(thread_t *t)
+{
+}
+
+status_t thread_set_deadline(thread_t *t, time_t period, time_t runtime, time_t deadline)
+{
+	return ERR_NOT_SUPPORTED;
+}
+
+status_t thread_wait_period(void)
+{
+	return ERR_NOT_SUPPORTED;
+}
+
+#endif
+
+/*
+ * cache of recycled thread structures and stacks
+ *
+ * Thread structures come out of a kmem_cache, so creating and exiting short
+ * lived threads doesn't walk the heap. Dead threads hand their stack back
+ * here as well; stacks are kept per size and a free stack stores its list
+ * node in its own first bytes.
+ */
+#define THREAD_CACHE_DEPTH 8
+#define THREAD_STACK_CACHE_SIZES 4
+
+struct thread_stack_cache {
+	size_t size;
+	uint count;
+	struct list_node list;
+};
+
+static kmem_cache_t thread_struct_cache =
+	KMEM_CACHE_INITIAL_VALUE(thread_struct_cache, "thread", sizeof(thread_t), 0, NULL);
+static struct thread_stack_cache thread_stack_cache[THREAD_STACK_CACHE_SIZES];
+
+static thread_t *thread_struct_alloc(void)
+{
+	return kmem_cache_alloc(&thread_struct_cache);
+}
+
+static void thread_struct_free(thread_t *t)
+{
+	kmem_cache_free(&thread_struct_cache, t);
+}
+
+static void *thread_stack_alloc(size_t size)
+{
+	struct list_node *stack = NULL;
+	uint i;
+
+	enter_critical_section();
+	for (i = 0; i < THREAD_STACK_CACHE_SIZES; i++) {
+		struct thread_stack_cache *c = &thread_stack_cache[i];
+
+		if (c->size == size && c->count > 0) {
+			stack = list_remove_head(&c->list);
+			c->count--;
+			break;
+		}
+	}
+	exit_critical_section();
+
+	if (!stack)
+		return malloc(size);
+
+	return stack;
+}
+
+static void thread_stack_free(void *stack, size_t size)
+{
+	struct thread_stack_cache *c = NULL;
+	uint i;
+
+	enter_critical_section();
+
+	/* use the bucket for this size, or take over an empty one */
+	for (i = 0; i < THREAD_STACK_CACHE_SIZES; i++) {
+		if (thread_stack_cache[i].size == size) {
+			c = &thread_stack_cache[i];
+			break;
+		}
+		if (!c && thread_stack_cache[i].count == 0)
+			c = &thread_stack_cache[i];
+	}
+
+	if (c && c->count < THREAD_CACHE_DEPTH) {
+		if (c->count == 0) {
+			c->size = size;
+			list_initialize(&c->list);
+		}
+		list_add_head(&c->list, (struct list_node *)stack);
+		c->count++;
+		stack = NULL;
+	}
+
+	exit_critical_section();
+
+	if (stack)
+		free(stack);
+}
+
+/**
+ * @brief  Create a new thread in caller provided storage
+ *
+ * Like thread_create(), but the thread structure and its stack may be
+ * supplied by the caller, which lets fully static systems create threads
+ * without touching the heap. Either may be NULL, in which case it is
+ * allocated and released again when the thread exits.
+ *
+ * Caller provided storage is never freed. It may be reused once the thread
+ * has exited and been cleaned up, which is when THREAD_FLAG_REAPED shows up
+ * in its flags. THREAD_DEATH alone isn't enough: a stack allocated here is
+ * freed later, by a dpc queued through the thread structure. On SMP builds
+ * pass through a critical section after that so the dying cpu is off the
+ * stack.
+ *
+ * @param  t           Thread structure to use, or NULL to allocate one
  * @param  name        Name of thread
  * @param  entry       Entry point of thread
  * @param  arg         Arbitrary argument passed to entry()
  * @param  priority    Execution priority for the thread.
+ * @param  stack       Stack to run on, or NULL to allocate one
  * @param  stack_size  Stack size for the thread.
  *
- * Thread priority is an integer from 0 (lowest) to 31 (highest).  Some standard
- * prioritys are defined in <kernel/thread.h>:
- *
- *	HIGHEST_PRIORITY
- *	DPC_PRIORITY
- *	HIGH_PRIORITY
- *	DEFAULT_PRIORITY
- *	LOW_PRIORITY
- *	IDLE_PRIORITY
- *	LOWEST_PRIORITY
- *
- * Stack size is typically set to DEFAULT_STACK_SIZE
- *
  * @return  Pointer to thread object, or NULL on failure.
  */
-thread_t *thread_create(const char *name, thread_start_routine entry, void *arg, int priority, size_t stack_size)
+thread_t *thread_create_etc(thread_t *t, const char *name, thread_start_routine entry, void *arg, int priority, void *stack, size_t stack_size)
 {
-	thread_t *t;
+	uint flags = 0;
 
-	t = malloc(sizeof(thread_t));
-	if (!t)
-		return NULL;
+	if (!t) {
+		t = thread_struct_alloc();
+		if (!t)
+			return NULL;
+		flags |= THREAD_FLAG_FREE_STRUCT;
+	}
 
 	init_thread_struct(t, name);
 
 	t->entry = entry;
 	t->arg = arg;
 	t->priority = priority;
+	t->base_priority = priority;
 	t->saved_critical_section_count = 1; /* we always start inside a critical section */
 	t->state = THREAD_SUSPENDED;
 	t->blocking_wait_queue = NULL;
 	t->wait_queue_block_ret = NO_ERROR;
 
 	/* create the stack */
-	t->stack = malloc(stack_size);
-	if (!t->stack) {
-		free(t);
-		return NULL;
+	if (!stack) {
+		stack = thread_stack_alloc(stack_size);
+		if (!stack) {
+			if (flags & THREAD_FLAG_FREE_STRUCT)
+				thread_struct_free(t);
+			return NULL;
+		}
+		flags |= THREAD_FLAG_FREE_STACK;
 	}
 
+	t->stack = stack;
 	t->stack_size = stack_size;
+	t->flags = flags;
+
+#if THREAD_STACK_HIGHWATER
+	/* paint the stack so we can tell how deep it gets */
+	memset(stack, THREAD_STACK_PAINT, stack_size);
+#endif
 
 	/* inheirit thread local storage from the parent */
 	int i;
@@ -181,6 +794,38 @@ thread_t *thread_create(const char *name, thread_start_routine entry, void *arg,
 	return t;
 }
 
+/**
+ * @brief  Create a new thread
+ *
+ * This function creates a new thread.  The thread is initially suspended, so you
+ * need to call thread_resume() to execute it.
+ *
+ * @param  name        Name of thread
+ * @param  entry       Entry point of thread
+ * @param  arg         Arbitrary argument passed to entry()
+ * @param  priority    Execution priority for the thread.
+ * @param  stack_size  Stack size for the thread.
+ *
+ * Thread priority is an integer from 0 (lowest) to 31 (highest).  Some standard
+ * prioritys are defined in <kernel/thread.h>:
+ *
+ *	HIGHEST_PRIORITY
+ *	DPC_PRIORITY
+ *	HIGH_PRIORITY
+ *	DEFAULT_PRIORITY
+ *	LOW_PRIORITY
+ *	IDLE_PRIORITY
+ *	LOWEST_PRIORITY
+ *
+ * Stack size is typically set to DEFAULT_STACK_SIZE
+ *
+ * @return  Pointer to thread object, or NULL on failure.
+ */
+thread_t *thread_create(const char *name, thread_start_routine entry, void *arg, int priority, size_t stack_size)
+{
+	return thread_create_etc(NULL, name, entry, arg, priority, NULL, stack_size);
+}
+
 /**
  * @brief  Make a suspended thread executable.
  *
@@ -227,11 +872,18 @@ static void thread_cleanup_dpc(void *thread)
 	list_delete(&t->thread_list_node);
 	exit_critical_section();
 
-	/* free its stack and the thread structure itself */
-	if (t->stack)
-		free(t->stack);
-
-	free(t);
+	/* hand back whatever thread_create_etc() allocated on its behalf */
+	if (t->flags & THREAD_FLAG_FREE_STACK)
+		thread_stack_free(t->stack, t->stack_size);
+
+	if (t->flags & THREAD_FLAG_FREE_STRUCT) {
+		thread_struct_free(t);
+	} else {
+		/* the last thing we touch, the owner may reuse it from here on */
+		enter_critical_section();
+		t->flags |= THREAD_FLAG_REAPED;
+		exit_critical_section();
+	}
 }
 
 /**
@@ -250,14 +902,26 @@ void thread_exit(int retcode)
 
 //	dprintf("thread_exit: current %p\n", current_thread);
 
+	/* nothing can be using our scratch memory past this point */
+	arena_destroy(&current_thread->scratch);
+
 	enter_critical_section();
 
+	/* give back our share of the deadline class */
+	edf_leave(current_thread);
+
 	/* enter the dead state */
 	current_thread->state = THREAD_DEATH;
 	current_thread->retcode = retcode;
 
-	/* schedule a dpc to clean ourselves up */
-	dpc_queue(thread_cleanup_dpc, (void *)current_thread, DPC_FLAG_NORESCHED);
+	if (current_thread->flags & (THREAD_FLAG_FREE_STACK | THREAD_FLAG_FREE_STRUCT)) {
+		/* schedule a dpc to clean ourselves up, through our own node so it can't fail */
+		dpc_queue_node(&current_thread->cleanup_dpc, thread_cleanup_dpc, (void *)current_thread, DPC_FLAG_NORESCHED);
+	} else {
+		/* nothing to free, the caller owns our storage */
+		list_delete(&current_thread->thread_list_node);
+		current_thread->flags |= THREAD_FLAG_REAPED;
+	}
 
 	/* reschedule */
 	thread_resched();
@@ -300,22 +964,46 @@ void thread_resched(void)
 	// at the moment, can't deal with more than 32 priority levels
 	ASSERT(NUM_PRIORITIES <= 32);
 
-	// should at least find the idle thread
-#if THREAD_CHECKS
-	ASSERT(run_queue_bitmap != 0);
+#if WITH_EDF
+	/* deadline threads run ahead of every priority band */
+	newthread = list_remove_head_type(&edf_run_queue, thread_t, queue_node);
+#else
+	newthread = NULL;
 #endif
 
-	int next_queue = HIGHEST_PRIORITY - __builtin_clz(run_queue_bitmap) - (32 - NUM_PRIORITIES);
-	//dprintf(SPEW, "bitmap 0x%x, next %d\n", run_queue_bitmap, next_queue);
+#if WITH_SMP
+	struct percpu *c = get_percpu();
 
-	newthread = list_remove_head_type(&run_queue[next_queue], thread_t, queue_node);
+	if (!newthread)
+		newthread = run_queue_pop(c);
+	if (!newthread)
+		newthread = steal_thread(c);
+	if (!newthread)
+		newthread = c->idle;
 
 #if THREAD_CHECKS
 	ASSERT(newthread);
 #endif
+#else
+	if (!newthread) {
+		// should at least find the idle thread
+#if THREAD_CHECKS
+		ASSERT(run_queue_bitmap != 0);
+#endif
+
+		int next_queue = HIGHEST_PRIORITY - __builtin_clz(run_queue_bitmap) - (32 - NUM_PRIORITIES);
+		//dprintf(SPEW, "bitmap 0x%x, next %d\n", run_queue_bitmap, next_queue);
+
+		newthread = list_remove_head_type(&run_queue[next_queue], thread_t, queue_node);
+
+#if THREAD_CHECKS
+		ASSERT(newthread);
+#endif
 
-	if (list_is_empty(&run_queue[next_queue]))
-		run_queue_bitmap &= ~(1<<next_queue);
+		if (list_is_empty(&run_queue[next_queue]))
+			run_queue_bitmap &= ~(1<<next_queue);
+	}
+#endif
 
 #if 0
 	// XXX make this more efficient
@@ -340,12 +1028,32 @@ void thread_resched(void)
 		newthread->remaining_quantum = 5; // XXX make this smarter
 	}
 
+#if WITH_SMP
+	newthread->curr_cpu = c->cpu_num;
+#endif
+
+#if WITH_EDF
+	/* deadline threads are charged for the time they're switched in */
+	if (thread_is_edf(oldthread))
+		edf_stop_budget(oldthread);
+	if (thread_is_edf(newthread))
+		edf_start_budget(newthread);
+#endif
+
+#if WITH_SMP
+	if (oldthread == c->idle)
+		mp_idle_cpus &= ~(1U << c->cpu_num);
+	if (newthread == c->idle)
+		mp_idle_cpus |= (1U << c->cpu_num);
+#endif
+
 #if THREAD_STATS
 	THREAD_STATS_INC(context_switches);
 
 	if (oldthread == idle_thread) {
 		bigtime_t now = current_time_hires();
 		thread_stats.idle_time += now - thread_stats.last_idle_timestamp;
+		THREAD_STATS_INC(idle_wakeups);
 	}
 	if (newthread == idle_thread) {
 		thread_stats.last_idle_timestamp = current_time_hires();
@@ -357,20 +1065,22 @@ void thread_resched(void)
 	ASSERT(newthread->saved_critical_section_count > 0);
 #endif
 
-#if PLATFORM_HAS_DYNAMIC_TIMER
+#if PLATFORM_HAS_DYNAMIC_TIMER && !WITH_SMP
 	/* if we're switching from idle to a real thread, set up a periodic
 	 * timer to run our preemption tick.
 	 */
 	if (oldthread == idle_thread) {
-		timer_set_periodic(&preempt_timer, 10, (timer_callback)thread_timer_tick, NULL);
+		timer_set_periodic(&preempt_timer, 10, thread_preempt_timer_tick, NULL);
 	} else if (newthread == idle_thread) {
 		timer_cancel(&preempt_timer);
 	}
 #endif
 
+	KTRACE(KTRACE_CONTEXT_SWITCH, oldthread, newthread);
+
 	/* do the switch */
 	oldthread->saved_critical_section_count = critical_section_count;
-	current_thread = newthread;
+	set_current_thread(newthread);
 	critical_section_count = newthread->saved_critical_section_count;
 	arch_context_switch(oldthread, newthread);
 }
@@ -474,6 +1184,10 @@ enum handler_return thread_timer_tick(void)
 	if (current_thread == idle_thread)
 		return INT_NO_RESCHEDULE;
 
+	/* deadline threads are preempted by their budget timer, not a quantum */
+	if (thread_is_edf(current_thread))
+		return INT_NO_RESCHEDULE;
+
 	current_thread->remaining_quantum--;
 	if (current_thread->remaining_quantum <= 0)
 		return INT_RESCHEDULE;
@@ -525,6 +1239,32 @@ void thread_sleep(time_t delay)
 	exit_critical_section();
 }
 
+/**
+ * @brief  Put thread to sleep; delay specified in usecs
+ *
+ * Like thread_sleep(), but with usec resolution on platforms that can
+ * program their timer at sub-ms granularity. Elsewhere the delay is
+ * rounded up to the next ms. Use this instead of spin() for short
+ * delays that don't need to hold the cpu.
+ */
+void thread_sleep_usec(bigtime_t delay)
+{
+	timer_t timer;
+
+#if THREAD_CHECKS
+	ASSERT(current_thread->magic == THREAD_MAGIC);
+	ASSERT(current_thread->state == THREAD_RUNNING);
+#endif
+
+	timer_initialize(&timer);
+
+	enter_critical_section();
+	timer_set_oneshot_hires(&timer, delay, thread_sleep_handler, (void *)current_thread);
+	current_thread->state = THREAD_SLEEPING;
+	thread_resched();
+	exit_critical_section();
+}
+
 /**
  * @brief  Initialize threading system
  *
@@ -535,8 +1275,20 @@ void thread_init_early(void)
 	int i;
 
 	/* initialize the run queues */
+#if WITH_SMP
+	uint cpu;
+	for (cpu=0; cpu < SMP_MAX_CPUS; cpu++) {
+		percpu[cpu].cpu_num = cpu;
+		percpu[cpu].run_queue_lock = SPIN_LOCK_INITIAL_VALUE;
+		for (i=0; i < NUM_PRIORITIES; i++)
+			list_initialize(&percpu[cpu].run_queue[i]);
+	}
+
+	mp_active_cpus = 1U << arch_curr_cpu_num();
+#else
 	for (i=0; i < NUM_PRIORITIES; i++)
 		list_initialize(&run_queue[i]);
+#endif
 
 	/* initialize the thread list */
 	list_initialize(&thread_list);
@@ -547,10 +1299,11 @@ void thread_init_early(void)
 
 	/* half construct this thread, since we're already running */
 	t->priority = HIGHEST_PRIORITY;
+	t->base_priority = HIGHEST_PRIORITY;
 	t->state = THREAD_RUNNING;
 	t->saved_critical_section_count = 1;
 	list_add_head(&thread_list, &t->thread_list_node);
-	current_thread = t;
+	set_current_thread(t);
 }
 
 /**
@@ -577,6 +1330,9 @@ void thread_set_name(const char *name)
  * @brief Change priority of current thread
  *
  * See thread_create() for a discussion of priority values.
+ *
+ * The thread runs at the higher of this and the priority of the highest
+ * waiter on any mutex it holds.
  */
 void thread_set_priority(int priority)
 {
@@ -584,7 +1340,38 @@ void thread_set_priority(int priority)
 		priority = LOWEST_PRIORITY;
 	if (priority > HIGHEST_PRIORITY)
 		priority = HIGHEST_PRIORITY;
-	current_thread->priority = priority;
+
+	enter_critical_section();
+	current_thread->base_priority = priority;
+	mutex_update_priority(current_thread);
+	exit_critical_section();
+}
+
+/**
+ * @brief  Change the priority a thread is scheduled at
+ *
+ * Used by the mutex code to boost and restore the priority of a mutex
+ * holder. If the thread is sitting in the run queue it is moved to the
+ * queue for its new priority.
+ */
+void thread_set_effective_priority(thread_t *t, int priority)
+{
+#if THREAD_CHECKS
+	ASSERT(t->magic == THREAD_MAGIC);
+	ASSERT(in_critical_section());
+#endif
+
+	if (t->priority == priority)
+		return;
+
+	if (t->state == THREAD_READY && list_in_list(&t->queue_node)) {
+		remove_from_run_queue(t);
+
+		t->priority = priority;
+		insert_in_run_queue_head(t);
+	} else {
+		t->priority = priority;
+	}
 }
 
 /**
@@ -600,6 +1387,10 @@ void thread_become_idle(void)
 	thread_set_priority(IDLE_PRIORITY);
 	idle_thread = current_thread;
 
+#if WITH_SMP
+	/* the boot cpu drives the preemption tick of every cpu, so it never stops */
+	timer_set_periodic(&preempt_timer, 10, thread_preempt_timer_tick, NULL);
+#endif
 
 	/* release the implicit boot critical section and yield to the scheduler */
 	exit_critical_section();
@@ -608,16 +1399,71 @@ void thread_become_idle(void)
 	idle_thread_routine();
 }
 
+#if WITH_SMP
+/**
+ * @brief  Bring a secondary cpu into the scheduler
+ *
+ * Called by the arch code on each secondary cpu once its per cpu state
+ * is set up. The boot stack it is running on becomes the stack of the
+ * cpu's idle thread. This function does not return.
+ */
+void thread_secondary_cpu_entry(void)
+{
+	uint cpu = arch_curr_cpu_num();
+	char name[32];
+
+	DEBUG_ASSERT(cpu > 0 && cpu < SMP_MAX_CPUS);
+
+	/* half construct the idle thread, since we're already running */
+	thread_t *t = &secondary_idle_threads[cpu - 1];
+	snprintf(name, sizeof(name), "idle %u", cpu);
+	init_thread_struct(t, name);
+	t->priority = IDLE_PRIORITY;
+	t->base_priority = IDLE_PRIORITY;
+	t->state = THREAD_RUNNING;
+	t->saved_critical_section_count = 1;
+	t->curr_cpu = cpu;
+	set_current_thread(t);
+
+	enter_critical_section();
+	idle_thread = t;
+	list_add_head(&thread_list, &t->thread_list_node);
+	mp_active_cpus |= 1U << cpu;
+	mp_idle_cpus |= 1U << cpu;
+	exit_critical_section();
+
+	dprintf(INFO, "cpu %u online\n", cpu);
+
+	/* pick up anything that was queued before we came online */
+	thread_yield();
+
+	idle_thread_routine();
+}
+#endif
+
 /**
  * @brief  Dump debugging info about the specified thread.
  */
 void dump_thread(thread_t *t)
 {
 	dprintf(INFO, "dump_thread: t %p (%s)\n", t, t->name);
-	dprintf(INFO, "\tstate %d, priority %d, remaining quantum %d, critical section %d\n", t->state, t->priority, t->remaining_quantum, t->saved_critical_section_count);
+	dprintf(INFO, "\tstate %d, priority %d (base %d), remaining quantum %d, critical section %d\n", t->state, t->priority, t->base_priority, t->remaining_quantum, t->saved_critical_section_count);
+#if THREAD_STACK_HIGHWATER
+	if (t->stack)
+		dprintf(INFO, "\tstack %p, stack_size %zd, used %zd\n", t->stack, t->stack_size, thread_stack_used(t));
+	else
+#endif
 	dprintf(INFO, "\tstack %p, stack_size %zd\n", t->stack, t->stack_size);
 	dprintf(INFO, "\tentry %p, arg %p\n", t->entry, t->arg);
-	dprintf(INFO, "\twait queue %p, wait queue ret %d\n", t->blocking_wait_queue, t->wait_queue_block_ret);
+	dprintf(INFO, "\twait queue %p, wait queue ret %d, blocking mutex %p\n", t->blocking_wait_queue, t->wait_queue_block_ret, t->blocking_mutex);
+#if WITH_EDF
+	if (thread_is_edf(t)) {
+		dprintf(INFO, "\tedf period %lu, runtime %lu, deadline %lu (%u.%u%%), budget %d us%s\n",
+			t->edf.period, t->edf.runtime, t->edf.deadline,
+			t->edf.utilization / 10, t->edf.utilization % 10, t->edf.budget, t->edf.throttled ? " (throttled)" : "");
+		dprintf(INFO, "\tedf jobs %u, deadline misses %u, budget overruns %u\n", t->edf.jobs, t->edf.misses, t->edf.overruns);
+	}
+#endif
 	dprintf(INFO, "\ttls:");
 	int i;
 	for (i=0; i < MAX_TLS_ENTRY; i++) {
@@ -626,6 +1472,58 @@ void dump_thread(thread_t *t)
 	dprintf(INFO, "\n");
 }
 
+#if THREAD_STACK_HIGHWATER
+/**
+ * @brief  Stack high water mark of a thread
+ *
+ * Stacks grow down, so the paint left at the bottom of the stack is the
+ * part the thread has never touched.
+ *
+ * @return  The most stack the thread has used so far, in bytes, or 0 if
+ * its stack wasn't painted.
+ */
+size_t thread_stack_used(thread_t *t)
+{
+	const uint8_t *stack = (const uint8_t *)t->stack;
+	size_t untouched = 0;
+
+	if (!stack)
+		return 0;
+
+	while (untouched < t->stack_size && stack[untouched] == THREAD_STACK_PAINT)
+		untouched++;
+
+	return t->stack_size - untouched;
+}
+
+/**
+ * @brief  Print the stack use of every thread with a suggested size
+ *
+ * The suggestion leaves 25% headroom over the high water mark, rounded up
+ * to 256 bytes. It is only as good as the code paths the threads have run
+ * so far.
+ */
+void thread_stack_report(void)
+{
+	thread_t *t;
+
+	dprintf(INFO, "%-24s %8s %8s %8s\n", "thread", "size", "used", "suggest");
+
+	enter_critical_section();
+	list_for_every_entry(&thread_list, t, thread_t, thread_list_node) {
+		if (!t->stack)
+			continue;
+
+		size_t used = thread_stack_used(t);
+		size_t suggest = ROUNDUP(used + used / 4, 256);
+
+		dprintf(INFO, "%-24s %8zu %8zu %8zu%s\n", t->name, t->stack_size, used, suggest,
+			(used == t->stack_size) ? " (overflowed?)" : "");
+	}
+	exit_critical_section();
+}
+#endif
+
 /**
  * @brief  Dump debugging info about all threads
  */
@@ -656,6 +1554,66 @@ void wait_queue_init(wait_queue_t *wait)
 	wait->magic = WAIT_QUEUE_MAGIC;
 	list_initialize(&wait->list);
 	wait->count = 0;
+	list_initialize(&wait->many_list);
+	wait->seq = 0;
+}
+
+/* take a thread blocked in wait_queue_block_many() off every queue it is waiting on */
+static void wait_queue_many_unblock(thread_t *t, int fired, status_t wait_queue_error)
+{
+	uint i;
+
+#if THREAD_CHECKS
+	ASSERT(t->state == THREAD_BLOCKED);
+	ASSERT(t->blocking_many != NULL);
+#endif
+
+	for (i = 0; i < t->blocking_many_count; i++) {
+		struct wait_queue_many_node *n = &t->blocking_many[i];
+
+		if (list_in_list(&n->node)) {
+			list_delete(&n->node);
+			n->wait->count--;
+		}
+	}
+
+	t->blocking_many = NULL;
+	t->blocking_many_count = 0;
+	t->blocking_many_fired = fired;
+	t->state = THREAD_READY;
+	t->wait_queue_block_ret = wait_queue_error;
+}
+
+/* pop the first thread blocked in wait_queue_block_many() on this queue */
+static thread_t *wait_queue_many_wake_one(wait_queue_t *wait, status_t wait_queue_error)
+{
+	struct wait_queue_many_node *n;
+
+	n = list_peek_head_type(&wait->many_list, struct wait_queue_many_node, node);
+	if (!n)
+		return NULL;
+
+	thread_t *t = n->thread;
+	wait_queue_many_unblock(t, n - t->blocking_many, wait_queue_error);
+
+	return t;
+}
+
+static enum handler_return wait_queue_many_timeout_handler(timer_t *timer, time_t now, void *arg)
+{
+	thread_t *t = (thread_t *)arg;
+
+#if THREAD_CHECKS
+	ASSERT(t->magic == THREAD_MAGIC);
+#endif
+
+	if (t->state != THREAD_BLOCKED || !t->blocking_many)
+		return INT_NO_RESCHEDULE;
+
+	wait_queue_many_unblock(t, -1, ERR_TIMED_OUT);
+	insert_in_run_queue_head(t);
+
+	return INT_RESCHEDULE;
 }
 
 static enum handler_return wait_queue_timeout_handler(timer_t *timer, time_t now, void *arg)
@@ -672,6 +1630,25 @@ static enum handler_return wait_queue_timeout_handler(timer_t *timer, time_t now
 	return INT_NO_RESCHEDULE;
 }
 
+/* block on a wait queue, the caller has armed the timeout timer if there is one */
+static status_t wait_queue_block_timer(wait_queue_t *wait, timer_t *timer)
+{
+	list_add_tail(&wait->list, &current_thread->queue_node);
+	wait->count++;
+	current_thread->state = THREAD_BLOCKED;
+	current_thread->blocking_wait_queue = wait;
+	current_thread->blocking_seq = wait->seq++;
+	current_thread->wait_queue_block_ret = NO_ERROR;
+
+	thread_block();
+
+	/* we don't really know if the timer fired or not, so it's better safe to try to cancel it */
+	if (timer)
+		timer_cancel(timer);
+
+	return current_thread->wait_queue_block_ret;
+}
+
 /**
  * @brief  Block until a wait queue is notified.
  *
@@ -703,32 +1680,117 @@ status_t wait_queue_block(wait_queue_t *wait, time_t timeout)
 	if (timeout == 0)
 		return ERR_TIMED_OUT;
 
-	list_add_tail(&wait->list, &current_thread->queue_node);
-	wait->count++;
+	/* if the timeout is nonzero or noninfinite, set a callback to yank us out of the queue */
+	if (timeout == INFINITE_TIME)
+		return wait_queue_block_timer(wait, NULL);
+
+	timer_initialize(&timer);
+	timer_set_oneshot(&timer, timeout, wait_queue_timeout_handler, (void *)current_thread);
+
+	return wait_queue_block_timer(wait, &timer);
+}
+
+/**
+ * @brief  Block until a wait queue is notified, timeout in usecs
+ *
+ * Like wait_queue_block(), but the timeout is in usecs and
+ * INFINITE_TIME_USEC waits indefinitely. Where the platform can't program its timer at
+ * sub-ms granularity the timeout is rounded up to the next ms.
+ */
+status_t wait_queue_block_usec(wait_queue_t *wait, bigtime_t timeout)
+{
+	timer_t timer;
+
+#if THREAD_CHECKS
+	ASSERT(wait->magic == WAIT_QUEUE_MAGIC);
+	ASSERT(current_thread->state == THREAD_RUNNING);
+	ASSERT(in_critical_section());
+#endif
+
+	if (timeout == 0)
+		return ERR_TIMED_OUT;
+
+	if (timeout == INFINITE_TIME_USEC)
+		return wait_queue_block_timer(wait, NULL);
+
+	timer_initialize(&timer);
+	timer_set_oneshot_hires(&timer, timeout, wait_queue_timeout_handler, (void *)current_thread);
+
+	return wait_queue_block_timer(wait, &timer);
+}
+
+/**
+ * @brief  Block until any of several wait queues is notified.
+ *
+ * Like wait_queue_block(), but the current thread waits on every queue in
+ * the set at the same time. The first wait_queue_wake_one() or
+ * wait_queue_wake_all() on any of them releases it and takes it off all
+ * the others.
+ *
+ * @param  queues   The wait queues to enter, at most WAIT_QUEUE_MANY_MAX
+ * @param  count    Number of queues
+ * @param  timeout  The maximum time, in ms, to wait
+ * @param  which    If not NULL, set to the index of the queue that woke us
+ *
+ * @return ERR_TIMED_OUT on timeout, else the value specified when the
+ * queue was woken.
+ */
+status_t wait_queue_block_many(wait_queue_t **queues, uint count, time_t timeout, uint *which)
+{
+	struct wait_queue_many_node nodes[WAIT_QUEUE_MANY_MAX];
+	timer_t timer;
+	uint i;
+
+#if THREAD_CHECKS
+	ASSERT(current_thread->state == THREAD_RUNNING);
+	ASSERT(in_critical_section());
+#endif
+
+	if (count == 0 || count > WAIT_QUEUE_MANY_MAX)
+		return ERR_INVALID_ARGS;
+
+	if (timeout == 0)
+		return ERR_TIMED_OUT;
+
+	for (i = 0; i < count; i++) {
+#if THREAD_CHECKS
+		ASSERT(queues[i]->magic == WAIT_QUEUE_MAGIC);
+#endif
+		nodes[i].thread = current_thread;
+		nodes[i].wait = queues[i];
+		nodes[i].seq = queues[i]->seq++;
+		list_add_tail(&queues[i]->many_list, &nodes[i].node);
+		queues[i]->count++;
+	}
+
 	current_thread->state = THREAD_BLOCKED;
-	current_thread->blocking_wait_queue = wait;
+	current_thread->blocking_many = nodes;
+	current_thread->blocking_many_count = count;
+	current_thread->blocking_many_fired = -1;
 	current_thread->wait_queue_block_ret = NO_ERROR;
 
-	/* if the timeout is nonzero or noninfinite, set a callback to yank us out of the queue */
 	if (timeout != INFINITE_TIME) {
 		timer_initialize(&timer);
-		timer_set_oneshot(&timer, timeout, wait_queue_timeout_handler, (void *)current_thread);
+		timer_set_oneshot(&timer, timeout, wait_queue_many_timeout_handler, (void *)current_thread);
 	}
 
 	thread_block();
 
-	/* we don't really know if the timer fired or not, so it's better safe to try to cancel it */
 	if (timeout != INFINITE_TIME) {
 		timer_cancel(&timer);
 	}
 
+	if (which && current_thread->blocking_many_fired >= 0)
+		*which = current_thread->blocking_many_fired;
+
 	return current_thread->wait_queue_block_ret;
 }
 
 /**
  * @brief  Wake up one thread sleeping on a wait queue
  *
- * This function removes one thread (if any) from the head of the wait queue and
+ * This function removes the longest-waiting thread (if any) from the wait queue,
+ * whether it blocked here alone or through wait_queue_block_many(), and
  * makes it executable.  The new thread will be placed at the head of the
  * run queue.
  *
@@ -749,8 +1811,11 @@ int wait_queue_wake_one(wait_queue_t *wait, bool reschedule, status_t wait_queue
 	ASSERT(in_critical_section());
 #endif
 
-	t = list_remove_head_type(&wait->list, thread_t, queue_node);
-	if (t) {
+	/* wake whoever has waited longest, whichever list they're on */
+	t = list_peek_head_type(&wait->list, thread_t, queue_node);
+	struct wait_queue_many_node *n = list_peek_head_type(&wait->many_list, struct wait_queue_many_node, node);
+	if (t && (!n || (int)(t->blocking_seq - n->seq) < 0)) {
+		list_delete(&t->queue_node);
 		wait->count--;
 #if THREAD_CHECKS
 		ASSERT(t->state == THREAD_BLOCKED);
@@ -758,7 +1823,11 @@ int wait_queue_wake_one(wait_queue_t *wait, bool reschedule, status_t wait_queue
 		t->state = THREAD_READY;
 		t->wait_queue_block_ret = wait_queue_error;
 		t->blocking_wait_queue = NULL;
+	} else {
+		t = wait_queue_many_wake_one(wait, wait_queue_error);
+	}
 
+	if (t) {
 		/* if we're instructed to reschedule, stick the current thread on the head
 		 * of the run queue first, so that the newly awakened thread gets a chance to run
 		 * before the current one, but the current one doesn't get unnecessarilly punished.
@@ -824,6 +1893,12 @@ int wait_queue_wake_all(wait_queue_t *wait, bool reschedule, status_t wait_queue
 		ret++;
 	}
 
+	/* and the ones waiting on us among other queues */
+	while ((t = wait_queue_many_wake_one(wait, wait_queue_error))) {
+		insert_in_run_queue_head(t);
+		ret++;
+	}
+
 #if THREAD_CHECKS
 	ASSERT(wait->count == 0);
 #endif
@@ -870,20 +1945,32 @@ status_t thread_unblock_from_wait_queue(thread_t *t, bool reschedule, status_t w
 	ASSERT(t->magic == THREAD_MAGIC);
 #endif
 
-	if (t->state != THREAD_BLOCKED)
+	if (t->state != THREAD_BLOCKED) {
+		exit_critical_section();
 		return ERR_NOT_BLOCKED;
+	}
 
+	if (t->blocking_many) {
+		wait_queue_many_unblock(t, -1, wait_queue_error);
+	} else {
 #if THREAD_CHECKS
-	ASSERT(t->blocking_wait_queue != NULL);
-	ASSERT(t->blocking_wait_queue->magic == WAIT_QUEUE_MAGIC);
-	ASSERT(list_in_list(&t->queue_node));
-#endif	
+		ASSERT(t->blocking_wait_queue != NULL);
+		ASSERT(t->blocking_wait_queue->magic == WAIT_QUEUE_MAGIC);
+		ASSERT(list_in_list(&t->queue_node));
+#endif
 
-	list_delete(&t->queue_node);
-	t->blocking_wait_queue->count--;
-	t->blocking_wait_queue = NULL;
-	t->state = THREAD_READY;
-	t->wait_queue_block_ret = wait_queue_error;
+		list_delete(&t->queue_node);
+		t->blocking_wait_queue->count--;
+		t->blocking_wait_queue = NULL;
+		t->state = THREAD_READY;
+		t->wait_queue_block_ret = wait_queue_error;
+	}
+
+	/* same as wait_queue_wake_one(), let the woken thread run before us */
+	if (reschedule) {
+		current_thread->state = THREAD_READY;
+		insert_in_run_queue_head(current_thread);
+	}
 	insert_in_run_queue_head(t);
 
 	if (reschedule)
@@ -32,6 +32,32 @@
  *
  * Timer callback functions are called in interrupt context.
  *
+ * Pending timers are kept in a hierarchical timer wheel so that arming
+ * and canceling a timer is O(1) regardless of how many are outstanding.
+ * Level 0 of the wheel has one slot per ms, each level above it covers
+ * TIMER_WHEEL_SIZE times the range of the one below, and timers further
+ * out than the top level can reach are parked on an overflow list.  As
+ * time advances past a slot boundary of an upper level, the timers in
+ * that slot are cascaded down into the lower levels.
+ *
+ * A timer may be given slack, the number of ms it is allowed to fire
+ * late. With a dynamic timer the hardware is programmed for the earliest
+ * deadline (scheduled time plus slack) of any pending timer rather than
+ * the earliest scheduled time, so timers whose windows overlap are fired
+ * together in one interrupt.
+ *
+ * Platforms that set PLATFORM_HAS_HIRES_TIMER can program the hardware
+ * timer in usecs. Timers set with timer_set_oneshot_hires() then bypass
+ * the wheel and go in a pairing heap ordered by their deadline in usecs,
+ * and the hardware is programmed for the earliest deadline across both.
+ * Elsewhere hires timers are rounded up to the next ms and go in the wheel.
+ *
+ * Threaded timers are taken off the wheel in interrupt context like any
+ * other, but their callbacks are run by the timer thread at HIGH_PRIORITY
+ * with interrupts enabled, so a long callback can be preempted and doesn't
+ * add to interrupt latency. The timer thread is created the first time a
+ * timer is made threaded, systems that never do so don't pay for it.
+ *
  * @{
  */
 #include <debug.h>
@@ -39,14 +65,59 @@
 #include <list.h>
 #include <kernel/thread.h>
 #include <kernel/timer.h>
+#include <kernel/event.h>
+#include <kernel/ktrace.h>
 #include <platform/timer.h>
 #include <platform.h>
 
 #define LOCAL_TRACE 0
 
-static struct list_node timer_queue;
+/* timer wheel geometry */
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SIZE (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SIZE - 1)
+#define TIMER_WHEEL_LEVELS 4
+#define TIMER_WHEEL_OVERFLOW TIMER_WHEEL_LEVELS
+#define TIMER_WHEEL_NONE (-1)
+#define TIMER_WHEEL_HIRES (-2)	/* in the hires heap rather than in the wheel */
+
+#define TIMER_WHEEL_SHIFT(level) ((level) * TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_INDEX(time, level) (((time) >> TIMER_WHEEL_SHIFT(level)) & TIMER_WHEEL_MASK)
+
+#if TIMER_WHEEL_SIZE != 64
+#error timer_wheel_map needs one bit per slot
+#endif
+
+static struct list_node timer_wheel[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SIZE];
+static struct list_node timer_overflow;
+
+/* one bit per populated slot in each level */
+static uint64_t timer_wheel_map[TIMER_WHEEL_LEVELS];
+
+/* number of timers queued in each level, with the overflow list at the end */
+static uint timer_wheel_count[TIMER_WHEEL_LEVELS + 1];
+
+/* the next tick of the wheel that has not been processed yet */
+static time_t timer_wheel_time;
+
+#if PLATFORM_HAS_HIRES_TIMER
+/* root of the hires timer heap, ordered by hires_deadline */
+static timer_t *timer_hires_heap;
+#endif
+
+#if PLATFORM_HAS_DYNAMIC_TIMER
+/* the deadline the hardware timer is currently programmed for, in usecs */
+static bool oneshot_armed;
+static bigtime_t oneshot_deadline;
+#endif
+
+/* expired threaded timers waiting for the timer thread */
+static struct list_node timer_thread_list;
+static event_t timer_thread_event;
+static bool timer_thread_started;
 
 static enum handler_return timer_tick(void *arg, time_t now);
+static int timer_thread(void *arg);
 
 /**
  * @brief  Initialize a timer object
@@ -55,27 +126,483 @@ void timer_initialize(timer_t *timer)
 {
 	timer->magic = TIMER_MAGIC;
 	list_clear_node(&timer->node);
+	timer->wheel_level = TIMER_WHEEL_NONE;
+	timer->wheel_slot = 0;
 	timer->scheduled_time = 0;
 	timer->periodic_time = 0;
+	timer->hires_time = 0;
+	timer->hires_deadline = 0;
+	timer->hires_child = NULL;
+	timer->hires_next = NULL;
+	timer->hires_prev = NULL;
+	timer->slack = 0;
+	timer->threaded = false;
 	timer->callback = 0;
 	timer->arg = 0;
 }
 
-static void insert_timer_in_queue(timer_t *timer)
+/**
+ * @brief  Allow a timer to fire late
+ *
+ * Lets the timer fire up to slack ms after its scheduled time so that its
+ * expiration can share an interrupt with other timers. The slack stays
+ * with the timer and applies the next time it is set.
+ *
+ * @param  timer The timer to use
+ * @param  slack How late, in ms, the timer may fire
+ */
+void timer_set_slack(timer_t *timer, time_t slack)
+{
+	DEBUG_ASSERT(timer->magic == TIMER_MAGIC);
+
+	timer->slack = slack;
+}
+
+/**
+ * @brief  Run a timer's callback from the timer thread
+ *
+ * The callback of a threaded timer is called from a high priority thread
+ * with interrupts enabled instead of from interrupt context. It may block
+ * and may be preempted. Its return value is ignored. timer_cancel() keeps
+ * a threaded callback from running if it hasn't started yet, but doesn't
+ * wait for one that has.
+ *
+ * The timer thread is only created the first time a timer is made
+ * threaded, so that call has to come from thread context.
+ *
+ * @param  timer The timer to use
+ * @param  threaded True to run the callback from the timer thread
+ */
+void timer_set_threaded(timer_t *timer, bool threaded)
+{
+	DEBUG_ASSERT(timer->magic == TIMER_MAGIC);
+
+	if (threaded) {
+		enter_critical_section();
+		bool start = !timer_thread_started;
+		timer_thread_started = true;
+		exit_critical_section();
+
+		if (start)
+			thread_resume(thread_create("timer", &timer_thread, NULL, HIGH_PRIORITY, DEFAULT_STACK_SIZE));
+	}
+
+	timer->threaded = threaded;
+}
+
+/* true if the timer is in the wheel, in the hires heap or about to be fired */
+static inline bool timer_is_queued(timer_t *timer)
+{
+	return list_in_list(&timer->node) || timer->wheel_level == TIMER_WHEEL_HIRES;
+}
+
+static void insert_timer_in_wheel(timer_t *timer)
 {
-	timer_t *entry;
+	time_t expires = timer->scheduled_time;
+	time_t delta;
+	struct list_node *list;
+	int level;
 
 	LTRACEF("timer %p, scheduled %d, periodic %d\n", timer, timer->scheduled_time, timer->periodic_time);
 
-	list_for_every_entry(&timer_queue, entry, timer_t, node) {
-		if (TIME_GT(entry->scheduled_time, timer->scheduled_time)) {
-			list_add_before(&entry->node, &timer->node);
-			return;
+	/* anything already in the past goes in the very next slot */
+	if (TIME_LT(expires, timer_wheel_time))
+		expires = timer_wheel_time;
+	delta = expires - timer_wheel_time;
+
+	for (level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+		if (delta < (1UL << TIMER_WHEEL_SHIFT(level + 1)))
+			break;
+	}
+
+	if (level == TIMER_WHEEL_OVERFLOW) {
+		list = &timer_overflow;
+	} else {
+		timer->wheel_slot = TIMER_WHEEL_INDEX(expires, level);
+		list = &timer_wheel[level][timer->wheel_slot];
+		timer_wheel_map[level] |= 1ULL << timer->wheel_slot;
+	}
+
+	list_add_tail(list, &timer->node);
+	timer->wheel_level = level;
+	timer_wheel_count[level]++;
+}
+
+#if PLATFORM_HAS_HIRES_TIMER
+static void remove_timer_from_hires_heap(timer_t *timer);
+#endif
+
+static void remove_timer_from_wheel(timer_t *timer)
+{
+	int level = timer->wheel_level;
+
+#if PLATFORM_HAS_HIRES_TIMER
+	if (level == TIMER_WHEEL_HIRES) {
+		remove_timer_from_hires_heap(timer);
+		return;
+	}
+#endif
+
+	list_delete(&timer->node);
+	if (level >= 0)
+		timer_wheel_count[level]--;
+	if (level >= 0 && level < TIMER_WHEEL_LEVELS && list_is_empty(&timer_wheel[level][timer->wheel_slot]))
+		timer_wheel_map[level] &= ~(1ULL << timer->wheel_slot);
+	timer->wheel_level = TIMER_WHEEL_NONE;
+}
+
+/* move every timer in a list onto the tail of another, taking them out of the wheel */
+static void timer_wheel_take_list(struct list_node *list, struct list_node *dest)
+{
+	timer_t *timer;
+
+	while ((timer = list_peek_head_type(list, timer_t, node))) {
+		remove_timer_from_wheel(timer);
+		list_add_tail(dest, &timer->node);
+	}
+}
+
+/* redistribute the timers in an upper level slot into the levels below it */
+static void timer_wheel_cascade(struct list_node *list)
+{
+	struct list_node temp;
+	timer_t *timer;
+
+	list_initialize(&temp);
+	timer_wheel_take_list(list, &temp);
+
+	while ((timer = list_remove_head_type(&temp, timer_t, node)))
+		insert_timer_in_wheel(timer);
+}
+
+/* advance the wheel up to and including now, collecting every expired timer */
+static void timer_wheel_advance(time_t now, struct list_node *expired)
+{
+	int level;
+
+	while (TIME_LTE(timer_wheel_time, now)) {
+		uint index = TIMER_WHEEL_INDEX(timer_wheel_time, 0);
+
+		/* on a slot boundary, cascade the upper levels down */
+		if (index == 0) {
+			for (level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+				uint upper = TIMER_WHEEL_INDEX(timer_wheel_time, level);
+
+				timer_wheel_cascade(&timer_wheel[level][upper]);
+				if (upper != 0)
+					break;
+			}
+			if (level == TIMER_WHEEL_LEVELS)
+				timer_wheel_cascade(&timer_overflow);
+		}
+
+		timer_wheel_take_list(&timer_wheel[0][index], expired);
+		timer_wheel_time++;
+
+		/*
+		 * if the lower levels are empty there is nothing to do until the
+		 * next boundary of the lowest populated level, so skip straight to it.
+		 */
+		for (level = 0; level <= TIMER_WHEEL_OVERFLOW; level++) {
+			if (timer_wheel_count[level] > 0)
+				break;
+		}
+
+		if (level > TIMER_WHEEL_OVERFLOW) {
+			timer_wheel_time = now + 1;
+		} else if (level > 0) {
+			time_t mask = (1UL << TIMER_WHEEL_SHIFT(level)) - 1;
+
+			if ((timer_wheel_time & mask) != 0) {
+				time_t next = (timer_wheel_time | mask) + 1;
+
+				timer_wheel_time = TIME_GT(next, now) ? now + 1 : next;
+			}
+		}
+	}
+}
+
+#if PLATFORM_HAS_HIRES_TIMER
+/* make the heap with the later root a child of the other, returning the new root */
+static timer_t *timer_hires_meld(timer_t *a, timer_t *b)
+{
+	timer_t *temp;
+
+	if (!a)
+		return b;
+	if (!b)
+		return a;
+
+	if (b->hires_deadline < a->hires_deadline) {
+		temp = a;
+		a = b;
+		b = temp;
+	}
+
+	b->hires_prev = a;
+	b->hires_next = a->hires_child;
+	if (a->hires_child)
+		a->hires_child->hires_prev = b;
+	a->hires_child = b;
+
+	return a;
+}
+
+/* meld a list of sibling heaps back into one, pairing them left to right then folding right to left */
+static timer_t *timer_hires_merge_pairs(timer_t *list)
+{
+	timer_t *pairs = NULL;
+	timer_t *root = NULL;
+
+	while (list) {
+		timer_t *a = list;
+		timer_t *b = a->hires_next;
+
+		list = b ? b->hires_next : NULL;
+		a->hires_next = a->hires_prev = NULL;
+		if (b)
+			b->hires_next = b->hires_prev = NULL;
+
+		a = timer_hires_meld(a, b);
+		a->hires_next = pairs;
+		pairs = a;
+	}
+
+	while (pairs) {
+		timer_t *next = pairs->hires_next;
+
+		pairs->hires_next = NULL;
+		root = timer_hires_meld(root, pairs);
+		pairs = next;
+	}
+
+	return root;
+}
+
+static void insert_timer_in_hires_heap(timer_t *timer)
+{
+	LTRACEF("timer %p, hires %llu\n", timer, timer->hires_time);
+
+	timer->wheel_level = TIMER_WHEEL_HIRES;
+	timer->hires_deadline = timer->hires_time + (bigtime_t)timer->slack * 1000;
+	timer->hires_child = NULL;
+	timer->hires_next = NULL;
+	timer->hires_prev = NULL;
+
+	timer_hires_heap = timer_hires_meld(timer_hires_heap, timer);
+}
+
+static void remove_timer_from_hires_heap(timer_t *timer)
+{
+	timer_t *children = timer_hires_merge_pairs(timer->hires_child);
+
+	if (timer == timer_hires_heap) {
+		timer_hires_heap = children;
+	} else {
+		/* the first child's prev is its parent, everyone else's is the sibling before it */
+		if (timer->hires_prev->hires_child == timer)
+			timer->hires_prev->hires_child = timer->hires_next;
+		else
+			timer->hires_prev->hires_next = timer->hires_next;
+		if (timer->hires_next)
+			timer->hires_next->hires_prev = timer->hires_prev;
+
+		timer_hires_heap = timer_hires_meld(timer_hires_heap, children);
+	}
+
+	timer->hires_child = NULL;
+	timer->hires_next = NULL;
+	timer->hires_prev = NULL;
+	timer->wheel_level = TIMER_WHEEL_NONE;
+}
+
+/*
+ * collect the hires timers that have expired by now. the heap is ordered
+ * by deadline, so this stops at the first timer not yet due even if one
+ * with more slack further down could already fire.
+ */
+static void timer_hires_advance(bigtime_t now, struct list_node *expired)
+{
+	timer_t *timer;
+
+	while ((timer = timer_hires_heap)) {
+		if (timer->hires_time > now)
+			break;
+
+		remove_timer_from_hires_heap(timer);
+		list_add_tail(expired, &timer->node);
+	}
+}
+#endif
+
+#if PLATFORM_HAS_DYNAMIC_TIMER
+/* distance from slot to the next populated slot of a level, wrapping around */
+static uint timer_wheel_next_slot(int level, uint slot)
+{
+	uint64_t map = timer_wheel_map[level];
+
+	if (map == 0)
+		return TIMER_WHEEL_SIZE;
+
+	if (slot != 0)
+		map = (map >> slot) | (map << (TIMER_WHEEL_SIZE - slot));
+	if ((uint32_t)map != 0)
+		return __builtin_ctz((uint32_t)map);
+	return 32 + __builtin_ctz((uint32_t)(map >> 32));
+}
+
+/* true if any timer is waiting to fire */
+static bool timer_any_pending(void)
+{
+	int level;
+
+	for (level = 0; level <= TIMER_WHEEL_OVERFLOW; level++) {
+		if (timer_wheel_count[level] > 0)
+			return true;
+	}
+#if PLATFORM_HAS_HIRES_TIMER
+	if (timer_hires_heap)
+		return true;
+#endif
+
+	return false;
+}
+
+/* the latest a timer may fire */
+static inline time_t timer_deadline(const timer_t *timer)
+{
+	return timer->scheduled_time + timer->slack;
+}
+
+/*
+ * fold the deadlines of the timers in a list into *next. timers scheduled
+ * after the current *next can't have an earlier deadline and are skipped.
+ */
+static bool timer_list_next_deadline(struct list_node *list, bool found, time_t *next)
+{
+	timer_t *timer;
+
+	list_for_every_entry(list, timer, timer_t, node) {
+		if (found && TIME_GT(timer->scheduled_time, *next))
+			continue;
+
+		time_t deadline = timer_deadline(timer);
+		if (!found || TIME_LT(deadline, *next))
+			*next = deadline;
+		found = true;
+	}
+
+	return found;
+}
+
+/*
+ * find the time the hardware timer should fire, the earliest deadline of
+ * any pending timer. populated slots are found through timer_wheel_map and
+ * walked in time order until they start after the best deadline found so
+ * far, so without slack this stops at the first populated slot of each level.
+ */
+static bool timer_wheel_next_event(time_t *next)
+{
+	bool found = false;
+	int level;
+	uint i;
+
+	for (level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+		if (timer_wheel_map[level] == 0)
+			continue;
+
+		time_t shift = TIMER_WHEEL_SHIFT(level);
+		time_t start = (timer_wheel_time + (1UL << shift) - 1) >> shift;
+
+		for (i = 0; i < TIMER_WHEEL_SIZE; i++) {
+			i += timer_wheel_next_slot(level, (start + i) & TIMER_WHEEL_MASK);
+			if (i >= TIMER_WHEEL_SIZE)
+				break;
+
+			time_t t = (start + i) << shift;
+
+			if (found && TIME_GT(t, *next))
+				break;
+
+			found = timer_list_next_deadline(&timer_wheel[level][(start + i) & TIMER_WHEEL_MASK], found, next);
 		}
 	}
 
-	/* walked off the end of the list */
-	list_add_tail(&timer_queue, &timer->node);
+	if (timer_wheel_count[TIMER_WHEEL_OVERFLOW] > 0) {
+		/* nothing on the overflow list is scheduled before the next top level boundary */
+		time_t mask = (1UL << TIMER_WHEEL_SHIFT(TIMER_WHEEL_LEVELS)) - 1;
+		time_t t = (timer_wheel_time + mask) & ~mask;
+
+		if (!found || TIME_LTE(t, *next))
+			found = timer_list_next_deadline(&timer_overflow, found, next);
+	}
+
+	return found;
+}
+
+/* convert a wheel time to usecs, given the current time in both */
+static inline bigtime_t timer_wheel_to_hires(time_t t, time_t now, bigtime_t now_hires)
+{
+	return now_hires + (bigtime_t)(long)(t - now) * 1000;
+}
+
+/* the earliest deadline of any pending timer, in usecs */
+static bool timer_next_event(time_t now, bigtime_t now_hires, bigtime_t *next)
+{
+	time_t wheel_next;
+	bool found;
+
+	found = timer_wheel_next_event(&wheel_next);
+	if (found)
+		*next = timer_wheel_to_hires(wheel_next, now, now_hires);
+
+#if PLATFORM_HAS_HIRES_TIMER
+	if (timer_hires_heap && (!found || timer_hires_heap->hires_deadline < *next)) {
+		*next = timer_hires_heap->hires_deadline;
+		found = true;
+	}
+#endif
+
+	return found;
+}
+
+static void timer_program_oneshot(bigtime_t deadline, bigtime_t now_hires)
+{
+	bigtime_t delay;
+
+	if (deadline < now_hires)
+		delay = 0;
+	else
+		delay = deadline - now_hires;
+
+	LTRACEF("setting new timer for %llu usecs\n", delay);
+
+	oneshot_armed = true;
+	oneshot_deadline = deadline;
+#if PLATFORM_HAS_HIRES_TIMER
+	platform_set_oneshot_timer_hires(timer_tick, NULL, delay);
+#else
+	platform_set_oneshot_timer(timer_tick, NULL, (time_t)((delay + 999) / 1000));
+#endif
+}
+
+/* make sure the hardware timer fires no later than deadline */
+static void timer_program_deadline(bigtime_t deadline, bigtime_t now_hires)
+{
+	if (!oneshot_armed || deadline < oneshot_deadline)
+		timer_program_oneshot(deadline, now_hires);
+}
+#endif
+
+/* put a timer in the wheel and make sure the hardware fires in time for it */
+static void timer_queue(timer_t *timer, time_t now)
+{
+	insert_timer_in_wheel(timer);
+
+#if PLATFORM_HAS_DYNAMIC_TIMER
+	bigtime_t now_hires = current_time_hires();
+	timer_program_deadline(timer_wheel_to_hires(timer_deadline(timer), now, now_hires), now_hires);
+#endif
 }
 
 static void timer_set(timer_t *timer, time_t delay, time_t period, timer_callback callback, void *arg)
@@ -86,7 +613,7 @@ static void timer_set(timer_t *timer, time_t delay, time_t period, timer_callbac
 
 	DEBUG_ASSERT(timer->magic == TIMER_MAGIC);	
 
-	if (list_in_list(&timer->node)) {
+	if (timer_is_queued(timer)) {
 		panic("timer %p already in list\n", timer);
 	}
 
@@ -100,18 +627,39 @@ static void timer_set(timer_t *timer, time_t delay, time_t period, timer_callbac
 
 	enter_critical_section();
 
-	insert_timer_in_queue(timer);
+	timer_queue(timer, now);
 
-#if PLATFORM_HAS_DYNAMIC_TIMER
-	if (list_peek_head_type(&timer_queue, timer_t, node) == timer) {
-		/* we just modified the head of the timer queue */
-		LTRACEF("setting new timer for %u msecs\n", (uint)delay);
-		platform_set_oneshot_timer(timer_tick, NULL, delay);
+	exit_critical_section();
+}
+
+#if PLATFORM_HAS_HIRES_TIMER
+static void timer_set_hires(timer_t *timer, bigtime_t delay, timer_callback callback, void *arg)
+{
+	bigtime_t now_hires;
+
+	LTRACEF("timer %p, delay %llu, callback %p, arg %p\n", timer, delay, callback, arg);
+
+	DEBUG_ASSERT(timer->magic == TIMER_MAGIC);
+
+	if (timer_is_queued(timer)) {
+		panic("timer %p already in list\n", timer);
 	}
-#endif
+
+	now_hires = current_time_hires();
+	timer->hires_time = now_hires + delay;
+	timer->scheduled_time = current_time() + (time_t)(delay / 1000);
+	timer->periodic_time = 0;
+	timer->callback = callback;
+	timer->arg = arg;
+
+	enter_critical_section();
+
+	insert_timer_in_hires_heap(timer);
+	timer_program_deadline(timer->hires_deadline, now_hires);
 
 	exit_critical_section();
 }
+#endif
 
 /**
  * @brief  Set up a timer that executes once
@@ -134,6 +682,29 @@ void timer_set_oneshot(timer_t *timer, time_t delay, timer_callback callback, vo
 	timer_set(timer, delay, 0, callback, arg);
 }
 
+/**
+ * @brief  Set up a timer that executes once, with a delay in usecs
+ *
+ * Like timer_set_oneshot(), but the delay is in usecs. If the platform
+ * can't program its timer at sub-ms granularity the delay is rounded up
+ * to the next ms.
+ *
+ * @param  timer The timer to use
+ * @param  delay The delay, in usecs, before the timer is executed
+ * @param  callback  The function to call when the timer expires
+ * @param  arg  The argument to pass to the callback
+ */
+void timer_set_oneshot_hires(timer_t *timer, bigtime_t delay, timer_callback callback, void *arg)
+{
+#if PLATFORM_HAS_HIRES_TIMER
+	if (delay == 0)
+		delay = 1;
+	timer_set_hires(timer, delay, callback, arg);
+#else
+	timer_set_oneshot(timer, (time_t)((delay + 999) / 1000), callback, arg);
+#endif
+}
+
 /**
  * @brief  Set up a timer that executes repeatedly
  *
@@ -164,12 +735,8 @@ void timer_cancel(timer_t *timer)
 
 	enter_critical_section();
 
-#if PLATFORM_HAS_DYNAMIC_TIMER
-	timer_t *oldhead = list_peek_head_type(&timer_queue, timer_t, node);
-#endif
-
-	if (list_in_list(&timer->node))
-		list_delete(&timer->node);
+	if (timer_is_queued(timer))
+		remove_timer_from_wheel(timer);
 
 	/* to keep it from being reinserted into the queue if called from 
 	 * periodic timer callback.
@@ -179,22 +746,15 @@ void timer_cancel(timer_t *timer)
 	timer->arg = NULL;
 
 #if PLATFORM_HAS_DYNAMIC_TIMER
-	/* see if we've just modified the head of the timer queue */
-	timer_t *newhead = list_peek_head_type(&timer_queue, timer_t, node);
-	if (newhead == NULL) {
+	/*
+	 * if no timers are left there is no reason to take another interrupt.
+	 * otherwise leave the hardware timer alone, the next deadline is only
+	 * worked out again when it fires, which at worst finds nothing to do.
+	 */
+	if (oneshot_armed && !timer_any_pending()) {
 		LTRACEF("clearing old hw timer, nothing in the queue\n");
+		oneshot_armed = false;
 		platform_stop_timer();
-	} else if (newhead != oldhead) {
-		time_t delay;
-		time_t now = current_time();
-
-		if (TIME_LT(newhead->scheduled_time, now))
-			delay = 0;
-		else
-			delay = newhead->scheduled_time - now;
-
-		LTRACEF("setting new timer to %d\n", delay);
-		platform_set_oneshot_timer(timer_tick, NULL, delay);
 	}
 #endif
 
@@ -205,58 +765,81 @@ void timer_cancel(timer_t *timer)
 static enum handler_return timer_tick(void *arg, time_t now)
 {
 	timer_t *timer;
+	struct list_node expired;
 	enum handler_return ret = INT_NO_RESCHEDULE;
+#if PLATFORM_HAS_DYNAMIC_TIMER
+	bigtime_t now_hires = current_time_hires();
+	bool fired = false;
+	time_t last_scheduled = 0;
+#endif
+	bool wake_thread = false;
 
 	THREAD_STATS_INC(timer_ints);
 
 	LTRACEF("now %d, sp 0x%x\n", now, __GET_FRAME());
 
-	for (;;) {
-		/* see if there's an event to process */
-		timer = list_peek_head_type(&timer_queue, timer_t, node);
-		if (likely(timer == 0))
-			break;
-		LTRACEF("next item on timer queue %p at %d now %d (%p, arg %p)\n", timer, timer->scheduled_time, now, timer->callback, timer->arg);
-		if (likely(TIME_LT(now, timer->scheduled_time)))
-			break;
+#if PLATFORM_HAS_DYNAMIC_TIMER
+	oneshot_armed = false;
+#endif
+
+	/* pull everything that is due out of the wheel */
+	list_initialize(&expired);
+	timer_wheel_advance(now, &expired);
+#if PLATFORM_HAS_HIRES_TIMER
+	timer_hires_advance(now_hires, &expired);
+#endif
 
-		/* process it */
+	/* callbacks may cancel timers still sitting on the expired list, so pop them one at a time */
+	while ((timer = list_remove_head_type(&expired, timer_t, node))) {
 		LTRACEF("timer %p\n", timer);
 		DEBUG_ASSERT(timer && timer->magic == TIMER_MAGIC);
-		list_delete(&timer->node);
 
 		LTRACEF("dequeued timer %p, scheduled %d periodic %d\n", timer, timer->scheduled_time, timer->periodic_time);
 
 		THREAD_STATS_INC(timers);
 
+#if PLATFORM_HAS_DYNAMIC_TIMER
+		/* without slack each distinct expiration would have taken its own interrupt */
+		if (fired && timer->scheduled_time != last_scheduled)
+			THREAD_STATS_INC(timer_coalesced);
+		fired = true;
+		last_scheduled = timer->scheduled_time;
+#endif
+
+		if (timer->threaded) {
+			/* the timer thread calls it and takes care of rearming it */
+			list_add_tail(&timer_thread_list, &timer->node);
+			wake_thread = true;
+			continue;
+		}
+
 		bool periodic = timer->periodic_time > 0;
 
 		LTRACEF("timer %p firing callback %p, arg %p\n", timer, timer->callback, timer->arg);
+		KTRACE(KTRACE_TIMER_CALLBACK, timer, timer->callback);
 		if (timer->callback(timer, now, timer->arg) == INT_RESCHEDULE)
 			ret = INT_RESCHEDULE;
 
 		/* if it was a periodic timer and it hasn't been requeued
 		 * by the callback put it back in the list
 		 */
-		if (periodic && !list_in_list(&timer->node) && timer->periodic_time > 0) {
+		if (periodic && !timer_is_queued(timer) && timer->periodic_time > 0) {
 			LTRACEF("periodic timer, period %u\n", (uint)timer->periodic_time);
 			timer->scheduled_time = now + timer->periodic_time;
-			insert_timer_in_queue(timer);
+			insert_timer_in_wheel(timer);
 		}
 	}
 
+	if (wake_thread) {
+		event_signal(&timer_thread_event, false);
+		ret = INT_RESCHEDULE;
+	}
+
 #if PLATFORM_HAS_DYNAMIC_TIMER
 	/* reset the timer to the next event */
-	timer = list_peek_head_type(&timer_queue, timer_t, node);
-	if (timer) {
-		/* has to be the case or it would have fired already */
-		ASSERT(TIME_GT(timer->scheduled_time, now));
-
-		time_t delay = timer->scheduled_time - now;
-
-		LTRACEF("setting new timer for %u msecs for event %p\n", (uint)delay, timer);
-		platform_set_oneshot_timer(timer_tick, NULL, delay);
-	}
+	bigtime_t next;
+	if (timer_next_event(now, now_hires, &next))
+		timer_program_oneshot(next, now_hires);
 #else
 	/* let the scheduler have a shot to do quantum expiration, etc */
 	/* in case of dynamic timer, the scheduler will set up a periodic timer */
@@ -268,12 +851,64 @@ static enum handler_return timer_tick(void *arg, time_t now)
 	return ret;
 }
 
+/* runs the callbacks of threaded timers */
+static int timer_thread(void *arg)
+{
+	timer_t *timer;
+
+	for (;;) {
+		event_wait(&timer_thread_event);
+
+		enter_critical_section();
+
+		while ((timer = list_remove_head_type(&timer_thread_list, timer_t, node))) {
+			DEBUG_ASSERT(timer->magic == TIMER_MAGIC);
+
+			bool periodic = timer->periodic_time > 0;
+			timer_callback callback = timer->callback;
+			void *callback_arg = timer->arg;
+
+			exit_critical_section();
+
+			KTRACE(KTRACE_TIMER_CALLBACK, timer, callback);
+			callback(timer, current_time(), callback_arg);
+
+			enter_critical_section();
+
+			/* same as timer_tick(), unless the callback rearmed or canceled it */
+			if (periodic && !timer_is_queued(timer) && timer->periodic_time > 0) {
+				time_t now = current_time();
+
+				timer->scheduled_time = now + timer->periodic_time;
+				timer_queue(timer, now);
+			}
+		}
+
+		exit_critical_section();
+	}
+
+	return 0;
+}
+
 void timer_init(void)
 {
-	list_initialize(&timer_queue);
+	int level, i;
+
+	for (level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+		for (i = 0; i < TIMER_WHEEL_SIZE; i++)
+			list_initialize(&timer_wheel[level][i]);
+	}
+	list_initialize(&timer_overflow);
+
+	timer_wheel_time = current_time();
 
+	list_initialize(&timer_thread_list);
+	event_init(&timer_thread_event, false, EVENT_FLAG_AUTOUNSIGNAL);
+
+#if !PLATFORM_HAS_DYNAMIC_TIMER
 	/* register for a periodic timer tick */
 	platform_set_periodic_timer(timer_tick, NULL, 10); /* 10ms */
+#endif
 }
 
 
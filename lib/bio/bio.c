@@ -27,13 +27,13 @@
 #include <assert.h>
 #include <list.h>
 #include <lib/bio.h>
-#include <kernel/mutex.h>
+#include <kernel/rwlock.h>
 
 #define LOCAL_TRACE 0
 
 struct bdev_struct {
 	struct list_node list;
-	mutex_t lock;
+	rwlock_t lock;
 };
 
 static struct bdev_struct *bdevs;
@@ -253,7 +253,7 @@ bdev_t *bio_open(const char *name)
 
 	/* see if it's in our list */
 	bdev_t *entry;
-	mutex_acquire(&bdevs->lock);
+	rwlock_acquire_read(&bdevs->lock);
 	list_for_every_entry(&bdevs->list, entry, bdev_t, node) {
 		DEBUG_ASSERT(entry->ref > 0);
 		if (!strcmp(entry->name, name)) {
@@ -262,7 +262,7 @@ bdev_t *bio_open(const char *name)
 			break;
 		}
 	}
-	mutex_release(&bdevs->lock);
+	rwlock_release_read(&bdevs->lock);
 
 	return bdev;
 }
@@ -406,9 +406,9 @@ void bio_register_device(bdev_t *dev)
 
 	bdev_inc_ref(dev);
 
-	mutex_acquire(&bdevs->lock);
+	rwlock_acquire_write(&bdevs->lock);
 	list_add_head(&bdevs->list, &dev->node);
-	mutex_release(&bdevs->lock);
+	rwlock_release_write(&bdevs->lock);
 }
 
 void bio_unregister_device(bdev_t *dev)
@@ -418,9 +418,9 @@ void bio_unregister_device(bdev_t *dev)
 	LTRACEF(" '%s'\n", dev->name);
 
 	// remove it from the list
-	mutex_acquire(&bdevs->lock);
+	rwlock_acquire_write(&bdevs->lock);
 	list_delete(&dev->node);
-	mutex_release(&bdevs->lock);
+	rwlock_release_write(&bdevs->lock);
 
 	bdev_dec_ref(dev); // remove the ref the list used to have
 }
@@ -429,11 +429,11 @@ void bio_dump_devices(void)
 {
 	printf("block devices:\n");
 	bdev_t *entry;
-	mutex_acquire(&bdevs->lock);
+	rwlock_acquire_read(&bdevs->lock);
 	list_for_every_entry(&bdevs->list, entry, bdev_t, node) {
 		printf("\t%s, size %lld, bsize %zd, ref %d\n", entry->name, entry->size, entry->block_size, entry->ref);
 	}
-	mutex_release(&bdevs->lock);
+	rwlock_release_read(&bdevs->lock);
 }
 
 void bio_init(void)
@@ -441,6 +441,6 @@ void bio_init(void)
 	bdevs = malloc(sizeof(*bdevs));
 
 	list_initialize(&bdevs->list);
-	mutex_init(&bdevs->lock);
+	rwlock_init(&bdevs->lock);
 }
 
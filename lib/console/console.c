@@ -24,10 +24,12 @@
 #include <assert.h>
 #include <string.h>
 #include <ctype.h>
+#include <err.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <kernel/thread.h>
 #include <kernel/mutex.h>
+#include <lib/arena.h>
 #include <lib/console.h>
 #if WITH_LIB_ENV
 #include <lib/env.h>
@@ -95,6 +97,7 @@ int console_init(void)
 
 	command_lock = malloc(sizeof(mutex_t));
 	mutex_init(command_lock);
+	mutex_register(command_lock, "console");
 
 	/* add all the statically defined commands to the list */
 	cmd_block *block;
@@ -534,8 +537,14 @@ static void command_loop(int (*get_line)(const char **, void *), void *get_line_
 	const char *continuebuffer;
 	char *outbuf;
 
+	/* commands run from here may use the scratch arena too, on top of outbuf */
+	arena_t *scratch = thread_scratch_arena();
+	arena_mark_t mark = arena_mark(scratch);
+
 	const size_t outbuflen = 1024;
-	outbuf = malloc(outbuflen);
+	outbuf = arena_alloc(scratch, outbuflen);
+	if (!outbuf)
+		return;
 
 	exit = false;
 	continuebuffer = NULL;
@@ -612,7 +621,7 @@ static void command_loop(int (*get_line)(const char **, void *), void *get_line_
 			mutex_release(command_lock);
 	}
 
-	free(outbuf);
+	arena_reset(scratch, mark);
 }
 
 void console_abort_script(void)
@@ -668,13 +677,20 @@ static int console_run_script_etc(const char *string, bool locked)
 {
 	struct line_read_struct lineread;
 
+	arena_t *scratch = thread_scratch_arena();
+	arena_mark_t mark = arena_mark(scratch);
+
 	lineread.string = string;
 	lineread.pos = 0;
-	lineread.buffer = malloc(LINE_LEN);
+	lineread.buffer = arena_alloc(scratch, LINE_LEN);
 	lineread.buflen = LINE_LEN;
+	if (!lineread.buffer)
+		return ERR_NO_MEMORY;
 
 	command_loop(&fetch_next_line, (void *)&lineread, false, locked);
 
+	arena_reset(scratch, mark);
+
 	return lastresult;
 }
 
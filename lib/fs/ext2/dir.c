@@ -24,11 +24,16 @@
 #include <stdlib.h>
 #include <debug.h>
 #include <err.h>
+#include <kernel/thread.h>
+#include <lib/arena.h>
 #include <lib/fs/ext2.h>
 #include "ext2_priv.h"
 
 #define LOCAL_TRACE 0
 
+/* longest path or symlink target a walk will follow */
+#define EXT2_WALK_PATH_LEN 512
+
 /* read in the dir, look for the entry */
 static int ext2_dir_lookup(ext2_t *ext2, struct ext2_inode *dir_inode, const char *name, inodenum_t *inum)
 {
@@ -40,14 +45,20 @@ static int ext2_dir_lookup(ext2_t *ext2, struct ext2_inode *dir_inode, const cha
 	if (!S_ISDIR(dir_inode->i_mode))
 		return ERR_NOT_DIR;
 
-	buf = malloc(EXT2_BLOCK_SIZE(ext2->sb));
+	/* the block buffer only lives for this call, the next component reuses it */
+	arena_t *scratch = thread_scratch_arena();
+	arena_mark_t mark = arena_mark(scratch);
+
+	buf = arena_alloc(scratch, EXT2_BLOCK_SIZE(ext2->sb));
+	if (!buf)
+		return ERR_NO_MEMORY;
 
 	file_blocknum = 0;
 	for (;;) {
 		/* read in the offset */
 		err = ext2_read_inode(ext2, dir_inode, buf, file_blocknum * EXT2_BLOCK_SIZE(ext2->sb), EXT2_BLOCK_SIZE(ext2->sb));
 		if (err <= 0) {
-			free(buf);
+			arena_reset(scratch, mark);
 			return -1;
 		}
 
@@ -68,7 +79,7 @@ static int ext2_dir_lookup(ext2_t *ext2, struct ext2_inode *dir_inode, const cha
 				// match
 				*inum = LE32(ent->inode);
 				LTRACEF("match: inode %d\n", *inum);
-				free(buf);
+				arena_reset(scratch, mark);
 				return 1;
 			}
 
@@ -79,13 +90,13 @@ static int ext2_dir_lookup(ext2_t *ext2, struct ext2_inode *dir_inode, const cha
 
 		/* sanity check the directory. 4MB should be enough */
 		if (file_blocknum > 1024) {
-			free(buf);
+			arena_reset(scratch, mark);
 			return -1;
 		}
 	}
 }
 
-/* note, trashes path */
+/* note, trashes path. scratch memory is released by ext2_lookup() */
 static int ext2_walk(ext2_t *ext2, char *path, struct ext2_inode *start_inode, inodenum_t *inum, int recurse)
 {
 	char *ptr;
@@ -134,11 +145,13 @@ nextcomponent:
 		
 		/* is it a symlink? */
 		if (S_ISLNK(inode.i_mode)) {
-			char link[512];
+			char *link = arena_alloc(thread_scratch_arena(), EXT2_WALK_PATH_LEN);
+			if (!link)
+				return ERR_NO_MEMORY;
 
 			LTRACEF("hit symlink\n");
 
-			err = ext2_read_link(ext2, &inode, link, sizeof(link));
+			err = ext2_read_link(ext2, &inode, link, EXT2_WALK_PATH_LEN);
 			if (err < 0)
 				return err;
 
@@ -190,9 +203,20 @@ int ext2_lookup(ext2_t *ext2, const char *_path, inodenum_t *inum)
 {
 	LTRACEF("path '%s', inum %p\n", _path, inum);
 
-	char path[512];
-	strlcpy(path, _path, sizeof(path));
+	/* the walk and any symlinks it follows work out of the scratch arena */
+	arena_t *scratch = thread_scratch_arena();
+	arena_mark_t mark = arena_mark(scratch);
+
+	char *path = arena_alloc(scratch, EXT2_WALK_PATH_LEN);
+	if (!path)
+		return ERR_NO_MEMORY;
+
+	strlcpy(path, _path, EXT2_WALK_PATH_LEN);
+
+	int err = ext2_walk(ext2, path, &ext2->root_inode, inum, 1);
+
+	arena_reset(scratch, mark);
 
-	return ext2_walk(ext2, path, &ext2->root_inode, inum, 1);
+	return err;
 }
 
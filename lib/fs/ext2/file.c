@@ -27,10 +27,14 @@
 #include <err.h>
 #include <debug.h>
 #include <lib/fs/ext2.h>
+#include <lib/kmem_cache.h>
 #include "ext2_priv.h"
 
 #define LOCAL_TRACE 0
 
+static kmem_cache_t ext2_file_cache =
+	KMEM_CACHE_INITIAL_VALUE(ext2_file_cache, "ext2 file", sizeof(ext2_file_t), 0, NULL);
+
 int ext2_open_file(fscookie cookie, const char *path, fsfilecookie *fcookie)
 {
 	ext2_t *ext2 = (ext2_t *)cookie;
@@ -43,13 +47,15 @@ int ext2_open_file(fscookie cookie, const char *path, fsfilecookie *fcookie)
 		return err;
 
 	/* create the file object */
-	ext2_file_t *file = malloc(sizeof(ext2_file_t));
+	ext2_file_t *file = kmem_cache_alloc(&ext2_file_cache);
+	if (!file)
+		return ERR_NO_MEMORY;
 	memset(file, 0, sizeof(ext2_file_t));
 
 	/* read in the inode */
 	err = ext2_load_inode(ext2, inum, &file->inode);
 	if (err < 0) {
-		free(file);
+		kmem_cache_free(&ext2_file_cache, file);
 		return err;
 	}
 
@@ -88,7 +94,7 @@ int ext2_close_file(fsfilecookie fcookie)
 		}
 	}
 
-	free(file);
+	kmem_cache_free(&ext2_file_cache, file);
 
 	return 0;
 }
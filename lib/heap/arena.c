@@ -0,0 +1,229 @@
+/*
+ * Copyright (c) 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/**
+ * @file
+ * @brief  Scratch arenas
+ *
+ * Each chunk is a single heap allocation: a struct arena_chunk followed by
+ * the space being bumped through. Chunks sit on a list newest first, so a
+ * mark is just the newest chunk and the bump pointer at the time, and
+ * resetting to it pops every newer chunk off the head of the list.
+ *
+ * Allocations too big for a regular chunk get a chunk of their own sized
+ * to fit. The last regular chunk to be emptied is kept as a spare, which
+ * keeps a caller that marks, allocates and resets in a loop off the heap
+ * entirely after the first pass.
+ *
+ * An arena has no lock, it belongs to whoever is using it.
+ */
+#include <debug.h>
+#include <assert.h>
+#include <lib/heap.h>
+#include <lib/arena.h>
+
+#define LOCAL_TRACE 0
+
+#define ROUNDUP(a, b) (((a) + ((b)-1)) & ~((b)-1))
+
+struct arena_chunk {
+	struct list_node node;
+	size_t size;		/* including this header */
+	size_t base_used;	/* bytes handed out in older chunks */
+};
+
+#define ARENA_CHUNK_HEADER ROUNDUP(sizeof(struct arena_chunk), ARENA_ALIGN)
+
+static inline uint8_t *chunk_data(struct arena_chunk *chunk)
+{
+	return (uint8_t *)chunk + ARENA_CHUNK_HEADER;
+}
+
+static inline struct arena_chunk *arena_newest_chunk(arena_t *arena)
+{
+	return list_peek_head_type(&arena->chunks, struct arena_chunk, node);
+}
+
+void arena_init(arena_t *arena, size_t chunk_size)
+{
+	if (chunk_size == 0)
+		chunk_size = ARENA_DEFAULT_CHUNK_SIZE;
+
+	DEBUG_ASSERT(chunk_size > ARENA_CHUNK_HEADER);
+
+	arena->magic = ARENA_MAGIC;
+	arena->chunk_size = ROUNDUP(chunk_size, ARENA_ALIGN);
+	list_initialize(&arena->chunks);
+	arena->spare = NULL;
+	arena->pos = NULL;
+	arena->end = NULL;
+	arena->chunk_count = 0;
+	arena->max_used = 0;
+}
+
+size_t arena_used(arena_t *arena)
+{
+	DEBUG_ASSERT(arena->magic == ARENA_MAGIC);
+
+	struct arena_chunk *chunk = arena_newest_chunk(arena);
+	if (!chunk)
+		return 0;
+
+	return chunk->base_used + (arena->pos - chunk_data(chunk));
+}
+
+static bool arena_add_chunk(arena_t *arena, size_t size)
+{
+	/* arenas set up with ARENA_INITIAL_VALUE may not have a chunk size */
+	if (arena->chunk_size == 0)
+		arena->chunk_size = ARENA_DEFAULT_CHUNK_SIZE;
+
+	size_t chunk_size = arena->chunk_size;
+	struct arena_chunk *chunk;
+
+	if (size > chunk_size - ARENA_CHUNK_HEADER) {
+		chunk_size = ARENA_CHUNK_HEADER + size;
+		chunk = heap_alloc(chunk_size, ARENA_ALIGN);
+	} else if (arena->spare) {
+		chunk = arena->spare;
+		arena->spare = NULL;
+	} else {
+		chunk = heap_alloc(chunk_size, ARENA_ALIGN);
+	}
+
+	if (!chunk)
+		return false;
+
+	LTRACEF("arena %p chunk %p size %zu\n", arena, chunk, chunk_size);
+
+	chunk->size = chunk_size;
+	chunk->base_used = arena_used(arena);
+	list_add_head(&arena->chunks, &chunk->node);
+	arena->chunk_count++;
+
+	arena->pos = chunk_data(chunk);
+	arena->end = (uint8_t *)chunk + chunk_size;
+
+	return true;
+}
+
+static void arena_release_chunk(arena_t *arena, struct arena_chunk *chunk)
+{
+	if (chunk->size == arena->chunk_size && !arena->spare)
+		arena->spare = chunk;
+	else
+		heap_free(chunk);
+}
+
+/**
+ * @brief  Allocate from an arena
+ *
+ * The memory stays valid until the arena is reset to a mark taken before
+ * this call, or destroyed.
+ *
+ * @return  ARENA_ALIGN aligned memory, or NULL if a new chunk was needed
+ *          and the heap is out of memory.
+ */
+void *arena_alloc(arena_t *arena, size_t size)
+{
+	DEBUG_ASSERT(arena->magic == ARENA_MAGIC);
+
+	/* chunks are aligned at both ends, so rounding sizes keeps pos aligned */
+	size = ROUNDUP(size, ARENA_ALIGN);
+
+	if (!arena->pos || size > (size_t)(arena->end - arena->pos)) {
+		if (!arena_add_chunk(arena, size))
+			return NULL;
+	}
+
+	void *ptr = arena->pos;
+	arena->pos += size;
+
+	size_t used = arena_used(arena);
+	if (used > arena->max_used)
+		arena->max_used = used;
+
+	return ptr;
+}
+
+/**
+ * @brief  Remember the current top of an arena
+ */
+arena_mark_t arena_mark(arena_t *arena)
+{
+	DEBUG_ASSERT(arena->magic == ARENA_MAGIC);
+
+	arena_mark_t mark = {
+		.chunk = arena_newest_chunk(arena),
+		.pos = arena->pos,
+	};
+
+	return mark;
+}
+
+/**
+ * @brief  Release everything allocated since a mark was taken
+ *
+ * Marks taken after this one are no longer valid once it's been reset to.
+ */
+void arena_reset(arena_t *arena, arena_mark_t mark)
+{
+	DEBUG_ASSERT(arena->magic == ARENA_MAGIC);
+
+	struct arena_chunk *chunk;
+	while ((chunk = arena_newest_chunk(arena)) != mark.chunk) {
+		/* running out of chunks means the mark wasn't from this arena */
+		DEBUG_ASSERT(chunk);
+
+		list_delete(&chunk->node);
+		arena->chunk_count--;
+		arena_release_chunk(arena, chunk);
+	}
+
+	if (mark.chunk) {
+		DEBUG_ASSERT(mark.pos >= chunk_data(mark.chunk));
+		DEBUG_ASSERT(mark.pos <= (uint8_t *)mark.chunk + mark.chunk->size);
+
+		arena->pos = mark.pos;
+		arena->end = (uint8_t *)mark.chunk + mark.chunk->size;
+	} else {
+		arena->pos = NULL;
+		arena->end = NULL;
+	}
+}
+
+/**
+ * @brief  Give all of an arena's memory back to the heap
+ */
+void arena_destroy(arena_t *arena)
+{
+	DEBUG_ASSERT(arena->magic == ARENA_MAGIC);
+
+	arena_mark_t empty = { NULL, NULL };
+	arena_reset(arena, empty);
+
+	if (arena->spare) {
+		heap_free(arena->spare);
+		arena->spare = NULL;
+	}
+}
+
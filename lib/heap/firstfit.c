@@ -0,0 +1,275 @@
+/*
+ * Copyright (c) 2008-2009 Travis Geiselbrecht
+ * Copyright (c) 2009 Corey Tabaka
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * first fit backend
+ *
+ * Each pool keeps its free chunks on a single list sorted by address.
+ * Allocation takes the first chunk that is big enough, freeing walks the
+ * list to find where the chunk goes and merges it with its neighbors.
+ */
+#include <debug.h>
+#include <assert.h>
+#include <list.h>
+#include <string.h>
+#include "heap_p.h"
+
+#define LOCAL_TRACE 0
+
+#define ROUNDUP(a, b) (((a) + ((b)-1)) & ~((b)-1))
+
+struct free_heap_chunk {
+	struct list_node node;
+	size_t len;
+};
+
+struct heap_pool {
+	struct list_node free_list;
+};
+
+static void dump_free_chunk(struct free_heap_chunk *chunk)
+{
+	dprintf(INFO, "\t\tbase %p, end 0x%lx, len 0x%zx\n", chunk, (vaddr_t)chunk + chunk->len, chunk->len);
+}
+
+void heap_backend_stats(struct heap_pool *pool, struct heap_stats *stats)
+{
+	struct free_heap_chunk *chunk;
+	list_for_every_entry(&pool->free_list, chunk, struct free_heap_chunk, node) {
+		heap_stats_add_free(stats, chunk->len);
+	}
+}
+
+void heap_backend_dump(struct heap_pool *pool)
+{
+	dprintf(INFO, "\tfree list:\n");
+
+	struct free_heap_chunk *chunk;
+	list_for_every_entry(&pool->free_list, chunk, struct free_heap_chunk, node) {
+		dump_free_chunk(chunk);
+	}
+}
+
+// try to insert this free chunk into the free list, consuming the chunk by merging it with
+// nearby ones if possible. Returns base of whatever chunk it became in the list.
+static struct free_heap_chunk *heap_insert_free_chunk(struct heap_pool *pool, struct free_heap_chunk *chunk)
+{
+#if DEBUGLEVEL > INFO
+	vaddr_t chunk_end = (vaddr_t)chunk + chunk->len;
+#endif
+
+//	dprintf("%s: chunk ptr %p, size 0x%lx, chunk_end 0x%x\n", __FUNCTION__, chunk, chunk->len, chunk_end);
+
+	struct free_heap_chunk *next_chunk;
+	struct free_heap_chunk *last_chunk;
+
+	// walk through the list, finding the node to insert before
+	list_for_every_entry(&pool->free_list, next_chunk, struct free_heap_chunk, node) {
+		if (chunk < next_chunk) {
+			DEBUG_ASSERT(chunk_end <= (vaddr_t)next_chunk);
+
+			list_add_before(&next_chunk->node, &chunk->node);
+
+			goto try_merge;
+		}
+	}
+
+	// walked off the end of the list, add it at the tail
+	list_add_tail(&pool->free_list, &chunk->node);
+
+	// try to merge with the previous chunk
+try_merge:
+	last_chunk = list_prev_type(&pool->free_list, &chunk->node, struct free_heap_chunk, node);
+	if (last_chunk) {
+		if ((vaddr_t)last_chunk + last_chunk->len == (vaddr_t)chunk) {
+			// easy, just extend the previous chunk
+			last_chunk->len += chunk->len;
+			
+			// remove ourself from the list
+			list_delete(&chunk->node);
+			
+			// set the chunk pointer to the newly extended chunk, in case 
+			// it needs to merge with the next chunk below
+			chunk = last_chunk;
+		}
+	}
+
+	// try to merge with the next chunk
+	if (next_chunk) {
+		if ((vaddr_t)chunk + chunk->len == (vaddr_t)next_chunk) {
+			// extend our chunk
+			chunk->len += next_chunk->len;
+
+			// remove them from the list
+			list_delete(&next_chunk->node);
+		}
+	}
+
+	return chunk;
+}
+
+static struct free_heap_chunk *heap_create_free_chunk(void *ptr, size_t len)
+{
+	DEBUG_ASSERT((len % sizeof(void *)) == 0); // size must be aligned on pointer boundary
+
+#if DEBUG_HEAP
+	memset(ptr, FREE_FILL, len);
+#endif
+
+	struct free_heap_chunk *chunk = (struct free_heap_chunk *)ptr;
+	chunk->len = len;
+
+	return chunk;
+}
+
+struct heap_pool *heap_backend_create(void *base, size_t len)
+{
+	// the pool lives at the start of the range, everything after it is free
+	vaddr_t start = ROUNDUP((vaddr_t)base, sizeof(void *));
+	vaddr_t end = ((vaddr_t)base + len) & ~(sizeof(void *) - 1);
+
+	if (end <= start || end - start < sizeof(struct heap_pool) + sizeof(struct free_heap_chunk))
+		return NULL;
+
+	struct heap_pool *pool = (struct heap_pool *)start;
+	list_initialize(&pool->free_list);
+
+	start += ROUNDUP(sizeof(struct heap_pool), sizeof(void *));
+	heap_insert_free_chunk(pool, heap_create_free_chunk((void *)start, end - start));
+
+	return pool;
+}
+
+void heap_backend_extend(struct heap_pool *pool, void *base, size_t len)
+{
+	vaddr_t start = ROUNDUP((vaddr_t)base, sizeof(void *));
+	vaddr_t end = ((vaddr_t)base + len) & ~(sizeof(void *) - 1);
+
+	if (end <= start || end - start < sizeof(struct free_heap_chunk))
+		return;
+
+	heap_insert_free_chunk(pool, heap_create_free_chunk((void *)start, end - start));
+}
+
+void *heap_backend_alloc(struct heap_pool *pool, size_t size, size_t *allocated)
+{
+	// make sure we allocate at least the size of a struct free_heap_chunk so that
+	// when we free it, we can create a struct free_heap_chunk struct and stick it
+	// in the spot
+	if (size < sizeof(struct free_heap_chunk))
+		size = sizeof(struct free_heap_chunk);
+
+	// walk through the list
+	struct free_heap_chunk *chunk;
+	list_for_every_entry(&pool->free_list, chunk, struct free_heap_chunk, node) {
+		DEBUG_ASSERT((chunk->len % sizeof(void *)) == 0); // len should always be a multiple of pointer size
+
+		// is it big enough to service our allocation?
+		if (chunk->len >= size) {
+			// remove it from the list
+			struct list_node *next_node = list_next(&pool->free_list, &chunk->node);
+			list_delete(&chunk->node);
+
+			if (chunk->len > size + sizeof(struct free_heap_chunk)) {
+				// there's enough space in this chunk to create a new one after the allocation
+				struct free_heap_chunk *newchunk = heap_create_free_chunk((uint8_t *)chunk + size, chunk->len - size);
+
+				// truncate this chunk
+				chunk->len -= chunk->len - size;
+
+				// add the new one where chunk used to be
+				if (next_node)
+					list_add_before(next_node, &newchunk->node);
+				else
+					list_add_tail(&pool->free_list, &newchunk->node);
+			}
+
+			// the allocated size is actually the length of this chunk, not the size requested
+			DEBUG_ASSERT(chunk->len >= size);
+			*allocated = chunk->len;
+
+			return chunk;
+		}
+	}
+
+	return NULL;
+}
+
+void heap_backend_free(struct heap_pool *pool, void *ptr, size_t len)
+{
+	heap_insert_free_chunk(pool, heap_create_free_chunk(ptr, len));
+}
+
+bool heap_backend_resize(struct heap_pool *pool, void *ptr, size_t len, size_t new_len, size_t *allocated)
+{
+	if (new_len < sizeof(struct free_heap_chunk))
+		new_len = sizeof(struct free_heap_chunk);
+
+	if (new_len <= len) {
+		// shrinking, hand the tail back if it is big enough to be a free chunk
+		if (len - new_len >= sizeof(struct free_heap_chunk)) {
+			heap_insert_free_chunk(pool, heap_create_free_chunk((uint8_t *)ptr + new_len, len - new_len));
+			len = new_len;
+		}
+
+		*allocated = len;
+		return true;
+	}
+
+	// growing, look for a free chunk that starts right where this one ends
+	vaddr_t end = (vaddr_t)ptr + len;
+	struct free_heap_chunk *chunk;
+	list_for_every_entry(&pool->free_list, chunk, struct free_heap_chunk, node) {
+		if ((vaddr_t)chunk > end)
+			break;
+		if ((vaddr_t)chunk < end)
+			continue;
+
+		if (len + chunk->len < new_len)
+			return false;
+
+		size_t needed = new_len - len;
+		struct list_node *next_node = list_next(&pool->free_list, &chunk->node);
+		list_delete(&chunk->node);
+
+		if (chunk->len > needed + sizeof(struct free_heap_chunk)) {
+			// leave the rest of the free chunk where it was
+			struct free_heap_chunk *newchunk = heap_create_free_chunk((uint8_t *)chunk + needed, chunk->len - needed);
+
+			if (next_node)
+				list_add_before(next_node, &newchunk->node);
+			else
+				list_add_tail(&pool->free_list, &newchunk->node);
+
+			len = new_len;
+		} else {
+			len += chunk->len;
+		}
+
+		*allocated = len;
+		return true;
+	}
+
+	return false;
+}
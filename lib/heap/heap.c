@@ -24,20 +24,18 @@
 #include <debug.h>
 #include <assert.h>
 #include <err.h>
-#include <list.h>
 #include <rand.h>
+#include <stdlib.h>
 #include <string.h>
 #include <kernel/thread.h>
+#include <platform.h>
 #include <lib/heap.h>
+#include <lib/kmem_cache.h>
+#include <lib/page_alloc.h>
+#include "heap_p.h"
 
 #define LOCAL_TRACE 0
 
-#define DEBUG_HEAP 0
-#define ALLOC_FILL 0x99
-#define FREE_FILL 0x77
-#define PADDING_FILL 0x55
-#define PADDING_SIZE 64
-
 #define ROUNDUP(a, b) (((a) + ((b)-1)) & ~((b)-1))
 
 #define HEAP_MAGIC 'HEAP'
@@ -59,48 +57,241 @@ extern int _heap_end;
 #define HEAP_LEN ((size_t)_heap_end - (size_t)&_end)
 #endif
 
-struct free_heap_chunk {
-	struct list_node node;
-	size_t len;
-};
+// attributes of the main heap range
+#ifndef HEAP_DEFAULT_FLAGS
+#define HEAP_DEFAULT_FLAGS HEAP_REGION_DMA
+#endif
+
+#ifndef HEAP_MAX_REGIONS
+#define HEAP_MAX_REGIONS PAGE_ALLOC_MAX_ARENAS
+#endif
+
+// pools grow by 2^HEAP_GROW_ORDER pages at a time, or less if that's all there is
+#ifndef HEAP_GROW_ORDER
+#define HEAP_GROW_ORDER 4
+#endif
 
-struct heap {
+// a range of memory with its own page allocator arena and backend pool
+struct heap_region {
 	void *base;
 	size_t len;
-	struct list_node free_list;
+	uint flags;
+	int arena;
+	struct heap_pool *pool;
 };
 
-// heap static vars
-static struct heap theheap;
+// heap static vars, the regions are searched in order
+static struct heap_region regions[HEAP_MAX_REGIONS];
+static uint region_count;
+
+// until heap_init() has added the main range, one slot is kept free for it
+static bool main_region_added;
+
+// who to charge an allocation to
+#if WITH_HEAP_PROFILE
+#define HEAP_CALLER() __GET_CALLER()
+#else
+#define HEAP_CALLER() NULL
+#endif
+
+// live usage counters, only touched inside a critical section
+static struct {
+	size_t used;
+	size_t max_used;
+	uint allocs;
+	uint frees;
+	uint failures;
+} heap_counters;
+
+static void heap_count_alloc(size_t len)
+{
+	heap_counters.used += len;
+	if (heap_counters.used > heap_counters.max_used)
+		heap_counters.max_used = heap_counters.used;
+	heap_counters.allocs++;
+}
+
+static void heap_count_free(size_t len)
+{
+	heap_counters.used -= len;
+	heap_counters.frees++;
+}
 
 // structure placed at the beginning every allocation
 struct alloc_struct_begin {
 	unsigned int magic;
 	void *ptr;
 	size_t size;
+#if WITH_HEAP_PROFILE
+	struct heap_profile_site *site;
+#endif
 #if DEBUG_HEAP
 	void *padding_start;
 	size_t padding_size;
 #endif
 };
 
-static void dump_free_chunk(struct free_heap_chunk *chunk)
+static void heap_dump(void)
 {
-	dprintf(INFO, "\t\tbase %p, end 0x%lx, len 0x%zx\n", chunk, (vaddr_t)chunk + chunk->len, chunk->len);
+	uint i;
+
+	dprintf(INFO, "Heap dump:\n");
+
+	enter_critical_section();
+	for (i = 0; i < region_count; i++) {
+		struct heap_region *r = &regions[i];
+
+		dprintf(INFO, "\tregion %u: base %p, len 0x%zx, flags%s%s%s\n", i, r->base, r->len,
+			(r->flags & HEAP_REGION_FAST) ? " fast" : "",
+			(r->flags & HEAP_REGION_DMA) ? " dma" : "",
+			(r->flags & HEAP_REGION_LARGE) ? " large" : "");
+		if (r->pool)
+			heap_backend_dump(r->pool);
+	}
+	exit_critical_section();
+
+	dprintf(INFO, "\tpages:\n");
+	page_alloc_dump();
 }
 
-static void heap_dump(void)
+static struct heap_region *heap_find_region(void *ptr)
 {
-	dprintf(INFO, "Heap dump:\n");
-	dprintf(INFO, "\tbase %p, len 0x%zx\n", theheap.base, theheap.len);
-	dprintf(INFO, "\tfree list:\n");
+	uint i;
 
-	struct free_heap_chunk *chunk;
-	list_for_every_entry(&theheap.free_list, chunk, struct free_heap_chunk, node) {
-		dump_free_chunk(chunk);
+	for (i = 0; i < region_count; i++) {
+		struct heap_region *r = &regions[i];
+
+		if ((addr_t)ptr >= (addr_t)r->base && (addr_t)ptr - (addr_t)r->base < r->len)
+			return r;
 	}
+
+	return NULL;
+}
+
+// can an allocation with these placement flags come out of this region
+static bool heap_region_usable(const struct heap_region *r, uint flags, bool exact)
+{
+	// fast memory is scarce, keep it for the allocations that ask for it
+	if ((r->flags & HEAP_REGION_FAST) && !(flags & HEAP_REGION_FAST))
+		return false;
+
+	// everything but dma is only a preference
+	uint need = exact ? flags : (flags & HEAP_REGION_DMA);
+
+	return (r->flags & need) == need;
+}
+
+// walk the regions an allocation with these flags may use, best suited first
+static struct heap_region *heap_next_region(uint flags, uint *cursor)
+{
+	// first the regions with every attribute asked for, then the ones that will do
+	while (*cursor < 2 * region_count) {
+		uint pass = *cursor / region_count;
+		struct heap_region *r = &regions[*cursor % region_count];
+
+		(*cursor)++;
+
+		if (!heap_region_usable(r, flags, pass == 0))
+			continue;
+		if (pass == 1 && heap_region_usable(r, flags, true))
+			continue;
+
+		return r;
+	}
+
+	return NULL;
 }
 
+// grow a region's pool by a block of pages that can hold size, inside a critical section
+static bool heap_grow_region(struct heap_region *r, size_t size)
+{
+	uint order = MAX(HEAP_GROW_ORDER, page_size_to_order(size));
+
+	for (;;) {
+		size_t len = (size_t)PAGE_SIZE << order;
+		if (len < size)
+			return false;
+
+		void *block = page_alloc_arena(r->arena, order, PAGE_ALLOC_FLAG_POOL);
+		if (block) {
+			LTRACEF("growing region %p by %zu bytes at %p\n", r->base, len, block);
+
+			if (r->pool) {
+				heap_backend_extend(r->pool, block, len);
+			} else {
+				r->pool = heap_backend_create(block, len);
+				if (!r->pool) {
+					page_free(block);
+					return false;
+				}
+			}
+			return true;
+		}
+
+		// settle for a smaller block
+		if (order == 0)
+			return false;
+		order--;
+	}
+}
+
+// find a chunk in the first region that suits the flags, inside a critical section
+static void *heap_alloc_chunk(size_t size, uint flags, size_t *allocated)
+{
+	struct heap_region *r;
+	uint cursor = 0;
+
+	while ((r = heap_next_region(flags, &cursor)) != NULL) {
+		void *chunk;
+
+		if (r->pool) {
+			chunk = heap_backend_alloc(r->pool, size, allocated);
+			if (chunk)
+				return chunk;
+		}
+
+		if (heap_grow_region(r, size)) {
+			chunk = heap_backend_alloc(r->pool, size, allocated);
+			if (chunk)
+				return chunk;
+		}
+	}
+
+	return NULL;
+}
+
+#if !DEBUG_HEAP
+// allocations of a page or more come straight from the page allocator
+static void *heap_alloc_pages(size_t size, uint flags, void *caller)
+{
+	struct heap_region *r;
+	uint cursor = 0;
+	uint order = page_size_to_order(size);
+	void *ptr = NULL;
+
+	enter_critical_section();
+	while ((r = heap_next_region(flags, &cursor)) != NULL) {
+		ptr = page_alloc_arena(r->arena, order, 0);
+		if (ptr)
+			break;
+	}
+
+	if (ptr) {
+		heap_count_alloc((size_t)PAGE_SIZE << order);
+#if WITH_HEAP_PROFILE
+		heap_profile_page_alloc(ptr, caller, (size_t)PAGE_SIZE << order);
+#endif
+	} else {
+		heap_counters.failures++;
+	}
+	exit_critical_section();
+
+	LTRACEF("size %zd order %u, returning ptr %p\n", size, order, ptr);
+
+	return ptr;
+}
+#endif
+
 static void heap_test(void)
 {
 	void *ptr[16];
@@ -125,6 +316,7 @@ static void heap_test(void)
 	for (i=0; i < 16; i++)
 		ptr[i] = 0;
 
+	bigtime_t t = current_time_hires();
 	for (i=0; i < 32768; i++) {
 		unsigned int index = (unsigned int)rand() % 16;
 		
@@ -149,107 +341,39 @@ static void heap_test(void)
 		if (ptr[i])
 			heap_free(ptr[i]);
 	}
+	t = current_time_hires() - t;
 
-	heap_dump();
-}
-
-// try to insert this free chunk into the free list, consuming the chunk by merging it with
-// nearby ones if possible. Returns base of whatever chunk it became in the list.
-static struct free_heap_chunk *heap_insert_free_chunk(struct free_heap_chunk *chunk)
-{
-#if DEBUGLEVEL > INFO
-	vaddr_t chunk_end = (vaddr_t)chunk + chunk->len;
-#endif
-
-//	dprintf("%s: chunk ptr %p, size 0x%lx, chunk_end 0x%x\n", __FUNCTION__, chunk, chunk->len, chunk_end);
-
-	struct free_heap_chunk *next_chunk;
-	struct free_heap_chunk *last_chunk;
-
-	// walk through the list, finding the node to insert before
-	list_for_every_entry(&theheap.free_list, next_chunk, struct free_heap_chunk, node) {
-		if (chunk < next_chunk) {
-			DEBUG_ASSERT(chunk_end <= (vaddr_t)next_chunk);
-
-			list_add_before(&next_chunk->node, &chunk->node);
-
-			goto try_merge;
-		}
-	}
-
-	// walked off the end of the list, add it at the tail
-	list_add_tail(&theheap.free_list, &chunk->node);
-
-	// try to merge with the previous chunk
-try_merge:
-	last_chunk = list_prev_type(&theheap.free_list, &chunk->node, struct free_heap_chunk, node);
-	if (last_chunk) {
-		if ((vaddr_t)last_chunk + last_chunk->len == (vaddr_t)chunk) {
-			// easy, just extend the previous chunk
-			last_chunk->len += chunk->len;
-			
-			// remove ourself from the list
-			list_delete(&chunk->node);
-			
-			// set the chunk pointer to the newly extended chunk, in case 
-			// it needs to merge with the next chunk below
-			chunk = last_chunk;
-		}
-	}
-
-	// try to merge with the next chunk
-	if (next_chunk) {
-		if ((vaddr_t)chunk + chunk->len == (vaddr_t)next_chunk) {
-			// extend our chunk
-			chunk->len += next_chunk->len;
+	printf("32768 random alloc/free pairs took %llu usecs\n", t);
 
-			// remove them from the list
-			list_delete(&next_chunk->node);
-		}
-	}
-
-	return chunk;
-}
-
-struct free_heap_chunk *heap_create_free_chunk(void *ptr, size_t len)
-{
-	DEBUG_ASSERT((len % sizeof(void *)) == 0); // size must be aligned on pointer boundary
-
-#if DEBUG_HEAP
-	memset(ptr, FREE_FILL, len);
-#endif
-
-	struct free_heap_chunk *chunk = (struct free_heap_chunk *)ptr;
-	chunk->len = len;
-
-	return chunk;
+	heap_dump();
 }
 
-void *heap_alloc(size_t size, unsigned int alignment)
+static void *heap_alloc_internal(size_t size, unsigned int alignment, uint flags, void *caller)
 {
 	void *ptr;
 #if DEBUG_HEAP
 	size_t original_size = size;
 #endif
 	
-	LTRACEF("size %zd, align %d\n", size, alignment);
+	LTRACEF("size %zd, align %d, flags 0x%x\n", size, alignment, flags);
 
 	// alignment must be power of 2
 	if (alignment & (alignment - 1))
 		return NULL;
 
+#if !DEBUG_HEAP
+	// pages are naturally aligned, so big or strictly aligned requests waste nothing there.
+	// with DEBUG_HEAP they go through the pools like everything else, to get padded and checked
+	if (size >= PAGE_SIZE || alignment >= PAGE_SIZE)
+		return heap_alloc_pages(MAX(size, alignment), flags, caller);
+#endif
+
 	// we always put a size field + base pointer + magic in front of the allocation
 	size += sizeof(struct alloc_struct_begin);
 #if DEBUG_HEAP
 	size += PADDING_SIZE;
 #endif
 
-	// make sure we allocate at least the size of a struct free_heap_chunk so that
-	// when we free it, we can create a struct free_heap_chunk struct and stick it
-	// in the spot
-	if (size < sizeof(struct free_heap_chunk))
-		size = sizeof(struct free_heap_chunk);
-
 	// round up size to a multiple of native pointer size
 	size = ROUNDUP(size, sizeof(void *));
 
@@ -265,64 +389,39 @@ void *heap_alloc(size_t size, unsigned int alignment)
 	// critical section
 	enter_critical_section();
 
-	// walk through the list
-	ptr = NULL;
-	struct free_heap_chunk *chunk;
-	list_for_every_entry(&theheap.free_list, chunk, struct free_heap_chunk, node) {
-		DEBUG_ASSERT((chunk->len % sizeof(void *)) == 0); // len should always be a multiple of pointer size
-
-		// is it big enough to service our allocation?
-		if (chunk->len >= size) {
-			ptr = chunk;
-
-			// remove it from the list
-			struct list_node *next_node = list_next(&theheap.free_list, &chunk->node);
-			list_delete(&chunk->node);
-
-			if (chunk->len > size + sizeof(struct free_heap_chunk)) {
-				// there's enough space in this chunk to create a new one after the allocation
-				struct free_heap_chunk *newchunk = heap_create_free_chunk((uint8_t *)ptr + size, chunk->len - size);
-
-				// truncate this chunk
-				chunk->len -= chunk->len - size;
-
-				// add the new one where chunk used to be
-				if (next_node)
-					list_add_before(next_node, &newchunk->node);
-				else
-					list_add_tail(&theheap.free_list, &newchunk->node);
-			}
-
-			// the allocated size is actually the length of this chunk, not the size requested
-			DEBUG_ASSERT(chunk->len >= size);
-			size = chunk->len;
-
+	void *chunk = heap_alloc_chunk(size, flags, &size);
+	ptr = chunk;
+	if (ptr) {
 #if DEBUG_HEAP
-			memset(ptr, ALLOC_FILL, size);
+		memset(ptr, ALLOC_FILL, size);
 #endif
 
-			ptr = (void *)((addr_t)ptr + sizeof(struct alloc_struct_begin));
+		ptr = (void *)((addr_t)ptr + sizeof(struct alloc_struct_begin));
 
-			// align the output if requested
-			if (alignment > 0) {
-				ptr = (void *)ROUNDUP((addr_t)ptr, alignment);
-			}
+		// align the output if requested
+		if (alignment > 0) {
+			ptr = (void *)ROUNDUP((addr_t)ptr, alignment);
+		}
 
-			struct alloc_struct_begin *as = (struct alloc_struct_begin *)ptr;
-			as--;
-			as->magic = HEAP_MAGIC;
-			as->ptr = (void *)chunk;
-			as->size = size;
+		struct alloc_struct_begin *as = (struct alloc_struct_begin *)ptr;
+		as--;
+		as->magic = HEAP_MAGIC;
+		as->ptr = chunk;
+		as->size = size;
 #if DEBUG_HEAP
-			as->padding_start = ((uint8_t *)ptr + original_size);
-			as->padding_size = (((addr_t)chunk + size) - ((addr_t)ptr + original_size));
-//			printf("padding start %p, size %u, chunk %p, size %u\n", as->padding_start, as->padding_size, chunk, size);
+		as->padding_start = ((uint8_t *)ptr + original_size);
+		as->padding_size = (((addr_t)chunk + size) - ((addr_t)ptr + original_size));
+//		printf("padding start %p, size %u, chunk %p, size %u\n", as->padding_start, as->padding_size, chunk, size);
 
-			memset(as->padding_start, PADDING_FILL, as->padding_size);
+		memset(as->padding_start, PADDING_FILL, as->padding_size);
 #endif
 
-			break;
-		}
+		heap_count_alloc(size);
+#if WITH_HEAP_PROFILE
+		as->site = heap_profile_alloc(caller, size);
+#endif
+	} else {
+		heap_counters.failures++;
 	}
 
 	LTRACEF("returning ptr %p\n", ptr);
@@ -341,6 +440,19 @@ void heap_free(void *ptr)
 
 	LTRACEF("ptr %p\n", ptr);
 
+	// blocks from the page allocator have no header
+	size_t block_size = page_alloc_size(ptr);
+	if (block_size) {
+		enter_critical_section();
+		page_free(ptr);
+		heap_count_free(block_size);
+#if WITH_HEAP_PROFILE
+		heap_profile_page_free(ptr, block_size);
+#endif
+		exit_critical_section();
+		return;
+	}
+
 	// check for the old allocation structure
 	struct alloc_struct_begin *as = (struct alloc_struct_begin *)ptr;
 	as--;
@@ -362,31 +474,234 @@ void heap_free(void *ptr)
 	}
 #endif
 
-	LTRACEF("allocation was %zd bytes long at ptr %p\n", as->size, as->ptr);
+	// the backend may write its free chunk bookkeeping over the header
+	void *chunk = as->ptr;
+	size_t size = as->size;
+#if WITH_HEAP_PROFILE
+	struct heap_profile_site *site = as->site;
+#endif
+
+	LTRACEF("allocation was %zd bytes long at ptr %p\n", size, chunk);
+
+	struct heap_region *r = heap_find_region(chunk);
+	DEBUG_ASSERT(r);
 
 	// looks good, create a free chunk and add it to the pool
 	enter_critical_section();
-	heap_insert_free_chunk(heap_create_free_chunk(as->ptr, as->size));
+	heap_backend_free(r->pool, chunk, size);
+	heap_count_free(size);
+#if WITH_HEAP_PROFILE
+	heap_profile_free(site, size);
+#endif
 	exit_critical_section();
 
 //	heap_dump();
 }
 
-void heap_init(void)
+static void *heap_realloc_internal(void *ptr, size_t size, void *caller)
 {
-	LTRACE_ENTRY;
+	if (ptr == 0)
+		return heap_alloc_internal(size, 0, 0, caller);
+
+	if (size == 0) {
+		heap_free(ptr);
+		return NULL;
+	}
+
+	LTRACEF("ptr %p, size %zd\n", ptr, size);
+
+	size_t block_size = page_alloc_size(ptr);
+	if (block_size) {
+		// keep the block unless it is more than twice as big as it needs to be
+		if (size <= block_size && (size > block_size / 2 || block_size == PAGE_SIZE))
+			return ptr;
+
+		struct heap_region *r = heap_find_region(ptr);
+		DEBUG_ASSERT(r);
+
+		void *newptr = heap_alloc_internal(size, 0, r->flags, caller);
+		if (!newptr)
+			return NULL;
+
+		memcpy(newptr, ptr, MIN(block_size, size));
+		heap_free(ptr);
+
+		return newptr;
+	}
+
+	struct alloc_struct_begin *as = (struct alloc_struct_begin *)ptr;
+	as--;
+
+	DEBUG_ASSERT(as->magic == HEAP_MAGIC);
+
+	struct heap_region *r = heap_find_region(as->ptr);
+	DEBUG_ASSERT(r);
+
+	// what the caller can use of the current allocation
+	size_t old_size = ((addr_t)as->ptr + as->size) - (addr_t)ptr;
+
+#if !DEBUG_HEAP
+	// try to resize the chunk under the allocation without moving it
+	size_t new_len = ((addr_t)ptr - (addr_t)as->ptr) + ROUNDUP(size, sizeof(void *));
+
+	enter_critical_section();
+	size_t old_len = as->size;
+	bool resized = heap_backend_resize(r->pool, as->ptr, as->size, new_len, &as->size);
+	if (resized) {
+		heap_counters.used += as->size - old_len;
+		if (heap_counters.used > heap_counters.max_used)
+			heap_counters.max_used = heap_counters.used;
+#if WITH_HEAP_PROFILE
+		heap_profile_resize(as->site, old_len, as->size);
+#endif
+	}
+	exit_critical_section();
+
+	if (resized) {
+		LTRACEF("resized in place to %zd bytes\n", as->size);
+		return ptr;
+	}
+#endif
+
+	// move it, preferably somewhere like where it was
+	void *newptr = heap_alloc_internal(size, 0, r->flags, caller);
+	if (!newptr)
+		return NULL;
+
+	memcpy(newptr, ptr, MIN(old_size, size));
+	heap_free(ptr);
+
+	return newptr;
+}
+
+void *heap_alloc(size_t size, unsigned int alignment)
+{
+	return heap_alloc_internal(size, alignment, 0, HEAP_CALLER());
+}
+
+void *heap_alloc_etc(size_t size, unsigned int alignment, uint flags)
+{
+	return heap_alloc_internal(size, alignment, flags, HEAP_CALLER());
+}
+
+void *heap_realloc(void *ptr, size_t size)
+{
+	return heap_realloc_internal(ptr, size, HEAP_CALLER());
+}
+
+#if WITH_HEAP_PROFILE
+void *heap_alloc_tagged(size_t size, unsigned int alignment, uint flags, void *caller)
+{
+	return heap_alloc_internal(size, alignment, flags, caller);
+}
+
+void *heap_realloc_tagged(void *ptr, size_t size, void *caller)
+{
+	return heap_realloc_internal(ptr, size, caller);
+}
+#endif
+
+void heap_stats_add_free(struct heap_stats *stats, size_t len)
+{
+	uint bucket = 0;
+
+	while (bucket < HEAP_STATS_BUCKETS - 1 && len >= ((size_t)32 << bucket))
+		bucket++;
+
+	stats->free += len;
+	stats->free_histogram[bucket]++;
+	if (len > stats->largest_free)
+		stats->largest_free = len;
+}
+
+void heap_get_stats(struct heap_stats *stats)
+{
+	uint i, order;
+
+	memset(stats, 0, sizeof(*stats));
+
+	enter_critical_section();
+
+	stats->used = heap_counters.used;
+	stats->max_used = heap_counters.max_used;
+	stats->allocs = heap_counters.allocs;
+	stats->frees = heap_counters.frees;
+	stats->failures = heap_counters.failures;
+
+	// the free space is counted up from the pools and page allocator as they are now
+	for (i = 0; i < region_count; i++) {
+		struct heap_region *r = &regions[i];
+
+		stats->size += page_arena_pages(r->arena) * PAGE_SIZE;
+
+		if (r->pool)
+			heap_backend_stats(r->pool, stats);
+
+		for (order = 0; order <= PAGE_ALLOC_MAX_ORDER; order++) {
+			uint count = page_arena_free_blocks(r->arena, order);
+
+			while (count--)
+				heap_stats_add_free(stats, (size_t)PAGE_SIZE << order);
+		}
+	}
+
+	exit_critical_section();
+
+	if (stats->free > 0)
+		stats->fragmentation = (uint)(100 - (uint64_t)stats->largest_free * 100 / stats->free);
+}
+
+static status_t heap_insert_region(uint index, void *base, size_t len, uint flags)
+{
+	status_t err = NO_ERROR;
+
+	LTRACEF("base %p size %zd bytes flags 0x%x\n", base, len, flags);
 
-	// set the heap range
-	theheap.base = (void *)HEAP_START;
-	theheap.len = HEAP_LEN;
+	enter_critical_section();
+
+	if (region_count == HEAP_MAX_REGIONS) {
+		err = ERR_NO_MEMORY;
+		goto out;
+	}
 
-	LTRACEF("base %p size %zd bytes\n", theheap.base, theheap.len);
+	// the pool is created the first time the region is used
+	int arena = page_add_arena(base, len);
+	if (arena < 0) {
+		err = arena;
+		goto out;
+	}
 
-	// initialize the free list
-	list_initialize(&theheap.free_list);
+	memmove(&regions[index + 1], &regions[index], (region_count - index) * sizeof(struct heap_region));
+	regions[index].base = base;
+	regions[index].len = len;
+	regions[index].flags = flags;
+	regions[index].arena = arena;
+	regions[index].pool = NULL;
+	region_count++;
 
-	// create an initial free chunk
-	heap_insert_free_chunk(heap_create_free_chunk(theheap.base, theheap.len));
+out:
+	exit_critical_section();
+
+	return err;
+}
+
+status_t heap_add_region(void *base, size_t len, uint flags)
+{
+	if (!main_region_added && region_count >= HEAP_MAX_REGIONS - 1)
+		return ERR_NO_MEMORY;
+
+	return heap_insert_region(region_count, base, len, flags);
+}
+
+void heap_init(void)
+{
+	LTRACE_ENTRY;
+
+	// the main range goes ahead of anything the platform has added already
+	status_t err = heap_insert_region(0, (void *)HEAP_START, HEAP_LEN, HEAP_DEFAULT_FLAGS);
+	if (err < 0)
+		panic("heap: failed to add the main heap range %p, len 0x%zx: %d\n", (void *)HEAP_START, (size_t)HEAP_LEN, err);
+	main_region_added = true;
 
 	// dump heap info
 //	heap_dump();
@@ -402,22 +717,77 @@ void heap_init(void)
 
 static int cmd_heap(int argc, const cmd_args *argv);
 
+// sites shown by heap profile unless told otherwise
+#define HEAP_PROFILE_TOP 16
+
 STATIC_COMMAND_START
 STATIC_COMMAND("heap", "heap debug commands", &cmd_heap)
 STATIC_COMMAND_END(heap);
 
+static void heap_print_stats(void)
+{
+	struct heap_stats stats;
+	uint i;
+
+	heap_get_stats(&stats);
+
+	printf("size %zu, used %zu, peak %zu, free %zu\n", stats.size, stats.used, stats.max_used, stats.free);
+	printf("allocs %u, frees %u, failures %u\n", stats.allocs, stats.frees, stats.failures);
+	printf("largest free chunk %zu, fragmentation %u%%\n", stats.largest_free, stats.fragmentation);
+	printf("free chunks:\n");
+	for (i = 0; i < HEAP_STATS_BUCKETS; i++) {
+		if (!stats.free_histogram[i])
+			continue;
+
+		if (i == 0)
+			printf("\t%10s < %-8u %u\n", "", 32, stats.free_histogram[i]);
+		else if (i == HEAP_STATS_BUCKETS - 1)
+			printf("\t%10u+ %-8s %u\n", 16U << i, "", stats.free_histogram[i]);
+		else
+			printf("\t%10u - %-8u %u\n", 16U << i, (32U << i) - 1, stats.free_histogram[i]);
+	}
+}
+
 static int cmd_heap(int argc, const cmd_args *argv)
 {
 	if (argc < 2) {
-		printf("not enough arguments\n");
+		printf("not enough arguments:\n");
+usage:
+		printf("%s info\n", argv[0].str);
+		printf("%s stats\n", argv[0].str);
+		printf("%s caches\n", argv[0].str);
+		printf("%s test\n", argv[0].str);
+#if WITH_HEAP_PROFILE
+		printf("%s profile [count]          : top allocation sites by live bytes\n", argv[0].str);
+		printf("%s profile snapshot\n", argv[0].str);
+		printf("%s profile diff [count]     : sites that changed since the snapshot\n", argv[0].str);
+#endif
 		return -1;
 	}
 
 	if (strcmp(argv[1].str, "info") == 0) {
 		heap_dump();
+	} else if (strcmp(argv[1].str, "test") == 0) {
+		heap_test();
+	} else if (strcmp(argv[1].str, "stats") == 0) {
+		heap_print_stats();
+	} else if (strcmp(argv[1].str, "caches") == 0) {
+		kmem_cache_dump();
+#if WITH_HEAP_PROFILE
+	} else if (strcmp(argv[1].str, "profile") == 0) {
+		if (argc < 3) {
+			heap_profile_dump(HEAP_PROFILE_TOP, false);
+		} else if (strcmp(argv[2].str, "snapshot") == 0) {
+			heap_profile_snapshot();
+		} else if (strcmp(argv[2].str, "diff") == 0) {
+			heap_profile_dump((argc < 4) ? HEAP_PROFILE_TOP : argv[3].u, true);
+		} else {
+			heap_profile_dump(argv[2].u, false);
+		}
+#endif
 	} else {
-		printf("unrecognized command\n");
-		return -1;
+		printf("unrecognized subcommand\n");
+		goto usage;
 	}
 
 	return 0;
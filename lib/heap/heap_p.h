@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef __LIB_HEAP_P_H
+#define __LIB_HEAP_P_H
+
+#include <sys/types.h>
+#include <lib/heap.h>
+
+/*
+ * DEBUG_HEAP fills allocations and checks the padding after them on free.
+ * Requests of a page or more normally bypass the pools for the page
+ * allocator, which has no room for padding, so with DEBUG_HEAP they stay
+ * in the pools and the pools grow by as much as they need.
+ */
+#define DEBUG_HEAP 0
+#define ALLOC_FILL 0x99
+#define FREE_FILL 0x77
+#define PADDING_FILL 0x55
+#define PADDING_SIZE 64
+
+/*
+ * allocator backends
+ *
+ * heap.c does everything that doesn't depend on how free memory is
+ * tracked: the allocation header, alignment, DEBUG_HEAP padding and the
+ * critical section, and it keeps track of the heap's regions. The backend,
+ * picked with HEAP_IMPLEMENTATION in rules.mk, runs one pool per region and
+ * only hands out and takes back chunks. Pools grow a block of pages at a
+ * time from the region's page allocator arena. All of these are called inside a
+ * critical section.
+ */
+struct heap_pool;
+
+/*
+ * start managing a range of memory. the pool's bookkeeping is carved out
+ * of the range itself. returns NULL if the range is too small to be useful.
+ */
+struct heap_pool *heap_backend_create(void *base, size_t len);
+
+/* hand a pool another range of memory, which need not be next to the others */
+void heap_backend_extend(struct heap_pool *pool, void *base, size_t len);
+
+/*
+ * find a chunk of at least size bytes. returns the chunk and sets
+ * *allocated to its real length, which may be larger than asked for.
+ */
+void *heap_backend_alloc(struct heap_pool *pool, size_t size, size_t *allocated);
+
+/* return a chunk, with the pointer and length heap_backend_alloc() gave out */
+void heap_backend_free(struct heap_pool *pool, void *ptr, size_t len);
+
+/*
+ * grow or shrink a chunk without moving it, splitting off or taking over
+ * the free memory right after it. returns false and leaves the chunk alone
+ * if it can't be grown in place, otherwise sets *allocated to its new length.
+ */
+bool heap_backend_resize(struct heap_pool *pool, void *ptr, size_t len, size_t new_len, size_t *allocated);
+
+/* report every free chunk in the pool to heap_stats_add_free() */
+void heap_backend_stats(struct heap_pool *pool, struct heap_stats *stats);
+
+void heap_backend_dump(struct heap_pool *pool);
+
+/* account for a free chunk of len bytes */
+void heap_stats_add_free(struct heap_stats *stats, size_t len);
+
+/*
+ * allocation site profiler, enabled with WITH_HEAP_PROFILE=1. The hooks
+ * are called inside a critical section.
+ */
+#if WITH_HEAP_PROFILE
+
+#ifndef HEAP_PROFILE_SITES
+#define HEAP_PROFILE_SITES 256
+#endif
+
+/* page allocations that can be traced back to their site at once */
+#ifndef HEAP_PROFILE_PAGE_ALLOCS
+#define HEAP_PROFILE_PAGE_ALLOCS 256
+#endif
+
+struct heap_profile_site;
+
+/* charge len bytes to the caller's site, returns the site to charge the free to */
+struct heap_profile_site *heap_profile_alloc(void *caller, size_t len);
+void heap_profile_free(struct heap_profile_site *site, size_t len);
+void heap_profile_resize(struct heap_profile_site *site, size_t old_len, size_t new_len);
+
+void heap_profile_page_alloc(void *ptr, void *caller, size_t len);
+void heap_profile_page_free(void *ptr, size_t len);
+
+void heap_profile_snapshot(void);
+void heap_profile_dump(uint count, bool diff);
+
+#endif
+
+#endif
+
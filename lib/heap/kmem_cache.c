@@ -0,0 +1,320 @@
+/*
+ * Copyright (c) 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file
+ * @brief  Object caches
+ *
+ * Every slab is a single heap allocation: a struct kmem_slab followed by
+ * an array of equally sized slots. The word in front of each object holds
+ * the next free slot while the object is free and the owning slab while it
+ * is allocated, so kmem_cache_free() finds its way back without searching.
+ *
+ * A cache keeps its slabs on three lists. Allocations come out of partial
+ * slabs first so that objects stay packed; at most one empty slab is kept
+ * around and the rest are given back to the heap.
+ */
+#include <debug.h>
+#include <assert.h>
+#include <string.h>
+#include <kernel/thread.h>
+#include <lib/heap.h>
+#include <lib/kmem_cache.h>
+
+#define LOCAL_TRACE 0
+
+#define ROUNDUP(a, b) (((a) + ((b)-1)) & ~((b)-1))
+
+/* slabs are a power of two multiple of this, and hold at least KMEM_SLAB_MIN_OBJECTS */
+#define KMEM_SLAB_SIZE 4096
+#define KMEM_SLAB_MIN_OBJECTS 4
+
+struct kmem_slab {
+	struct list_node node;
+	kmem_cache_t *cache;
+	void **free;
+	uint in_use;
+};
+
+static struct list_node cache_list = LIST_INITIAL_VALUE(cache_list);
+
+static size_t slab_header_size(const kmem_cache_t *cache)
+{
+	return ROUNDUP(sizeof(struct kmem_slab), cache->align);
+}
+
+/* offset of the object from the start of its slot */
+static size_t slot_object_offset(const kmem_cache_t *cache)
+{
+	return ROUNDUP(sizeof(void *), cache->align);
+}
+
+static void **object_to_slot(const kmem_cache_t *cache, void *obj)
+{
+	return (void **)((addr_t)obj - slot_object_offset(cache));
+}
+
+static void *slot_to_object(const kmem_cache_t *cache, void **slot)
+{
+	return (void *)((addr_t)slot + slot_object_offset(cache));
+}
+
+/* work out the slab geometry, called inside a critical section */
+static void kmem_cache_setup(kmem_cache_t *cache)
+{
+	DEBUG_ASSERT(cache->magic == KMEM_CACHE_MAGIC);
+	DEBUG_ASSERT(cache->object_size > 0);
+
+	if (cache->align < sizeof(void *))
+		cache->align = sizeof(void *);
+	DEBUG_ASSERT((cache->align & (cache->align - 1)) == 0);
+
+	cache->slot_size = ROUNDUP(slot_object_offset(cache) + cache->object_size, cache->align);
+
+	size_t header = slab_header_size(cache);
+	cache->slab_size = header + cache->slot_size * KMEM_SLAB_MIN_OBJECTS;
+
+	/* big slabs come from the page allocator in powers of two, so use all of it */
+	size_t slab_size = KMEM_SLAB_SIZE;
+	while (slab_size < cache->slab_size)
+		slab_size <<= 1;
+	cache->slab_size = slab_size;
+	cache->slab_objects = (cache->slab_size - header) / cache->slot_size;
+
+	list_add_tail(&cache_list, &cache->node);
+
+	LTRACEF("cache '%s' object %zu slot %zu slab %zu objects %u\n", cache->name,
+			cache->object_size, cache->slot_size, cache->slab_size, cache->slab_objects);
+}
+
+void kmem_cache_init(kmem_cache_t *cache, const char *name, size_t size, size_t align, kmem_cache_ctor ctor)
+{
+	memset(cache, 0, sizeof(*cache));
+
+	cache->magic = KMEM_CACHE_MAGIC;
+	cache->name = name;
+	cache->object_size = size;
+	cache->align = align;
+	cache->ctor = ctor;
+	list_initialize(&cache->partial_slabs);
+	list_initialize(&cache->full_slabs);
+	list_initialize(&cache->empty_slabs);
+
+	enter_critical_section();
+	kmem_cache_setup(cache);
+	exit_critical_section();
+}
+
+/* allocate and construct a slab, called outside of a critical section */
+static struct kmem_slab *kmem_slab_create(kmem_cache_t *cache)
+{
+	struct kmem_slab *slab = heap_alloc(cache->slab_size, cache->align);
+	uint i;
+
+	if (!slab)
+		return NULL;
+
+	slab->cache = cache;
+	slab->in_use = 0;
+	slab->free = NULL;
+
+	/* thread the slots onto the free list back to front so they come out in order */
+	addr_t slots = (addr_t)slab + slab_header_size(cache);
+	for (i = cache->slab_objects; i > 0; i--) {
+		void **slot = (void **)(slots + (i - 1) * cache->slot_size);
+
+		if (cache->ctor)
+			cache->ctor(slot_to_object(cache, slot));
+
+		*slot = slab->free;
+		slab->free = slot;
+	}
+
+	return slab;
+}
+
+void *kmem_cache_alloc(kmem_cache_t *cache)
+{
+	struct kmem_slab *slab;
+	struct kmem_slab *new_slab = NULL;
+
+	DEBUG_ASSERT(cache->magic == KMEM_CACHE_MAGIC);
+
+	enter_critical_section();
+
+	if (cache->slot_size == 0)
+		kmem_cache_setup(cache);
+
+	for (;;) {
+		slab = list_peek_head_type(&cache->partial_slabs, struct kmem_slab, node);
+		if (slab)
+			break;
+
+		slab = list_remove_head_type(&cache->empty_slabs, struct kmem_slab, node);
+		if (slab) {
+			list_add_head(&cache->partial_slabs, &slab->node);
+			break;
+		}
+
+		if (new_slab) {
+			/* use the slab we just built */
+			list_add_head(&cache->partial_slabs, &new_slab->node);
+			cache->slabs++;
+			slab = new_slab;
+			new_slab = NULL;
+			break;
+		}
+
+		/* build a new slab without holding everything else up */
+		exit_critical_section();
+		new_slab = kmem_slab_create(cache);
+		enter_critical_section();
+
+		if (!new_slab) {
+			cache->failures++;
+			exit_critical_section();
+			return NULL;
+		}
+	}
+
+	void **slot = slab->free;
+	DEBUG_ASSERT(slot);
+	slab->free = *slot;
+	*slot = slab;
+	slab->in_use++;
+
+	if (slab->in_use == cache->slab_objects) {
+		list_delete(&slab->node);
+		list_add_head(&cache->full_slabs, &slab->node);
+	}
+
+	cache->allocs++;
+	cache->active++;
+	if (cache->active > cache->max_active)
+		cache->max_active = cache->active;
+
+	exit_critical_section();
+
+	/* someone else refilled the cache while we were building a slab */
+	if (new_slab)
+		heap_free(new_slab);
+
+	return slot_to_object(cache, slot);
+}
+
+void kmem_cache_free(kmem_cache_t *cache, void *obj)
+{
+	struct kmem_slab *release = NULL;
+
+	if (!obj)
+		return;
+
+	DEBUG_ASSERT(cache->magic == KMEM_CACHE_MAGIC);
+
+	void **slot = object_to_slot(cache, obj);
+	struct kmem_slab *slab = *slot;
+
+	DEBUG_ASSERT(slab->cache == cache);
+	DEBUG_ASSERT(slab->in_use > 0);
+
+	enter_critical_section();
+
+	if (slab->in_use == cache->slab_objects) {
+		/* was full, it has room again */
+		list_delete(&slab->node);
+		list_add_head(&cache->partial_slabs, &slab->node);
+	}
+
+	*slot = slab->free;
+	slab->free = slot;
+	slab->in_use--;
+
+	if (slab->in_use == 0) {
+		list_delete(&slab->node);
+		if (list_is_empty(&cache->empty_slabs)) {
+			list_add_head(&cache->empty_slabs, &slab->node);
+		} else {
+			cache->slabs--;
+			release = slab;
+		}
+	}
+
+	cache->frees++;
+	cache->active--;
+
+	exit_critical_section();
+
+	if (release)
+		heap_free(release);
+}
+
+void kmem_cache_reap(kmem_cache_t *cache)
+{
+	struct kmem_slab *slab;
+
+	DEBUG_ASSERT(cache->magic == KMEM_CACHE_MAGIC);
+
+	for (;;) {
+		enter_critical_section();
+		slab = list_remove_head_type(&cache->empty_slabs, struct kmem_slab, node);
+		if (slab)
+			cache->slabs--;
+		exit_critical_section();
+
+		if (!slab)
+			break;
+
+		heap_free(slab);
+	}
+}
+
+void kmem_cache_destroy(kmem_cache_t *cache)
+{
+	DEBUG_ASSERT(cache->magic == KMEM_CACHE_MAGIC);
+	DEBUG_ASSERT(cache->active == 0);
+
+	kmem_cache_reap(cache);
+
+	enter_critical_section();
+	if (cache->slot_size != 0)
+		list_delete(&cache->node);
+	cache->magic = 0;
+	exit_critical_section();
+}
+
+void kmem_cache_dump(void)
+{
+	kmem_cache_t *cache;
+
+	printf("%-16s %6s %6s %6s %6s %6s %8s %8s %6s\n",
+			"name", "size", "slot", "slabs", "active", "max", "allocs", "frees", "fail");
+
+	enter_critical_section();
+	list_for_every_entry(&cache_list, cache, kmem_cache_t, node) {
+		printf("%-16s %6zu %6zu %6u %6u %6u %8u %8u %6u\n",
+				cache->name, cache->object_size, cache->slot_size, cache->slabs,
+				cache->active, cache->max_active, cache->allocs, cache->frees, cache->failures);
+	}
+	exit_critical_section();
+}
+
@@ -0,0 +1,318 @@
+/*
+ * Copyright (c) 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file
+ * @brief  Buddy page allocator
+ *
+ * Every arena starts with a byte of state per page, followed by the pages
+ * themselves. A block of 2^n pages is always aligned to its own size in
+ * absolute terms, so its buddy is found by flipping one address bit and
+ * the pair can be merged back together in constant time when both halves
+ * are free.
+ *
+ * Only the first page of a block has any state: whether the block is free
+ * or allocated, whether it was handed to a heap pool, and its order. Free blocks sit on a list per order, with the
+ * list node stored in the block itself.
+ */
+#include <debug.h>
+#include <assert.h>
+#include <err.h>
+#include <list.h>
+#include <stdlib.h>
+#include <string.h>
+#include <kernel/thread.h>
+#include <lib/page_alloc.h>
+
+#define LOCAL_TRACE 0
+
+#define ROUNDUP(a, b) (((a) + ((b)-1)) & ~((b)-1))
+
+#define PAGE_STATE_FREE 0x80
+#define PAGE_STATE_ALLOCATED 0x40
+#define PAGE_STATE_POOL 0x20
+#define PAGE_STATE_ORDER_MASK 0x1f
+
+struct page_arena {
+	addr_t base;
+	size_t pages;
+	size_t free_pages;
+	uint8_t *state;
+	struct list_node free_list[PAGE_ALLOC_MAX_ORDER + 1];
+	uint free_count[PAGE_ALLOC_MAX_ORDER + 1];
+};
+
+static struct page_arena arenas[PAGE_ALLOC_MAX_ARENAS];
+static uint arena_count;
+
+static inline size_t block_bytes(uint order)
+{
+	return (size_t)PAGE_SIZE << order;
+}
+
+static inline size_t page_index(const struct page_arena *arena, addr_t addr)
+{
+	return (addr - arena->base) / PAGE_SIZE;
+}
+
+static struct page_arena *find_arena(addr_t addr)
+{
+	uint i;
+
+	for (i = 0; i < arena_count; i++) {
+		struct page_arena *arena = &arenas[i];
+
+		if (addr >= arena->base && page_index(arena, addr) < arena->pages)
+			return arena;
+	}
+
+	return NULL;
+}
+
+static void free_block_insert(struct page_arena *arena, addr_t addr, uint order)
+{
+	arena->state[page_index(arena, addr)] = PAGE_STATE_FREE | order;
+	list_add_head(&arena->free_list[order], (struct list_node *)addr);
+	arena->free_count[order]++;
+}
+
+static void free_block_remove(struct page_arena *arena, addr_t addr)
+{
+	size_t index = page_index(arena, addr);
+
+	arena->free_count[arena->state[index] & PAGE_STATE_ORDER_MASK]--;
+	arena->state[index] = 0;
+	list_delete((struct list_node *)addr);
+}
+
+size_t page_arena_pages(int index)
+{
+	DEBUG_ASSERT(index >= 0 && (uint)index < arena_count);
+
+	return arenas[index].pages;
+}
+
+uint page_arena_free_blocks(int index, uint order)
+{
+	DEBUG_ASSERT(index >= 0 && (uint)index < arena_count);
+	DEBUG_ASSERT(order <= PAGE_ALLOC_MAX_ORDER);
+
+	return arenas[index].free_count[order];
+}
+
+uint page_size_to_order(size_t size)
+{
+	uint order = 0;
+
+	while (block_bytes(order) < size)
+		order++;
+
+	return order;
+}
+
+int page_add_arena(void *base, size_t len)
+{
+	int err;
+
+	/* a byte of state per page, then the pages from the next page boundary */
+	addr_t start = (addr_t)base;
+	addr_t end = ((addr_t)base + len) & ~(PAGE_SIZE - 1);
+
+	if (end <= start)
+		return ERR_INVALID_ARGS;
+
+	size_t state_bytes = (end - start) / (PAGE_SIZE + 1);
+	addr_t first = ROUNDUP(start + state_bytes, PAGE_SIZE);
+	if (first >= end)
+		return ERR_INVALID_ARGS;
+
+	/* rounding first up can leave room for one more page than there is state for */
+	size_t pages = MIN(state_bytes, (end - first) / PAGE_SIZE);
+	if (pages == 0)
+		return ERR_INVALID_ARGS;
+
+	enter_critical_section();
+
+	if (arena_count == PAGE_ALLOC_MAX_ARENAS) {
+		err = ERR_NO_MEMORY;
+		goto out;
+	}
+
+	struct page_arena *arena = &arenas[arena_count];
+	uint i;
+
+	arena->base = first;
+	arena->pages = pages;
+	arena->free_pages = pages;
+	arena->state = (uint8_t *)start;
+	memset(arena->state, 0, pages);
+	for (i = 0; i <= PAGE_ALLOC_MAX_ORDER; i++) {
+		list_initialize(&arena->free_list[i]);
+		arena->free_count[i] = 0;
+	}
+
+	/* carve the pages up into the biggest aligned blocks that fit */
+	size_t index = 0;
+	while (index < pages) {
+		addr_t addr = first + index * PAGE_SIZE;
+		uint order = 0;
+
+		while (order < PAGE_ALLOC_MAX_ORDER &&
+				(addr & (block_bytes(order + 1) - 1)) == 0 &&
+				index + (1U << (order + 1)) <= pages)
+			order++;
+
+		free_block_insert(arena, addr, order);
+		index += 1U << order;
+	}
+
+	LTRACEF("arena %u: base 0x%lx, %zu pages\n", arena_count, first, pages);
+
+	err = arena_count++;
+
+out:
+	exit_critical_section();
+
+	return err;
+}
+
+void *page_alloc_arena(int index, uint order, uint flags)
+{
+	DEBUG_ASSERT(index >= 0 && (uint)index < arena_count);
+
+	if (order > PAGE_ALLOC_MAX_ORDER)
+		return NULL;
+
+	struct page_arena *arena = &arenas[index];
+	uint o;
+
+	enter_critical_section();
+
+	/* the smallest free block that is big enough */
+	for (o = order; o <= PAGE_ALLOC_MAX_ORDER; o++) {
+		if (!list_is_empty(&arena->free_list[o]))
+			break;
+	}
+
+	if (o > PAGE_ALLOC_MAX_ORDER) {
+		exit_critical_section();
+		return NULL;
+	}
+
+	addr_t addr = (addr_t)list_peek_head(&arena->free_list[o]);
+	free_block_remove(arena, addr);
+
+	/* split it, handing the top halves back */
+	while (o > order) {
+		o--;
+		free_block_insert(arena, addr + block_bytes(o), o);
+	}
+
+	arena->state[page_index(arena, addr)] = PAGE_STATE_ALLOCATED | order |
+		((flags & PAGE_ALLOC_FLAG_POOL) ? PAGE_STATE_POOL : 0);
+	arena->free_pages -= 1U << order;
+
+	exit_critical_section();
+
+	LTRACEF("arena %d order %u: 0x%lx\n", index, order, addr);
+
+	return (void *)addr;
+}
+
+void page_free(void *ptr)
+{
+	addr_t addr = (addr_t)ptr;
+
+	if (!ptr)
+		return;
+
+	enter_critical_section();
+
+	struct page_arena *arena = find_arena(addr);
+	DEBUG_ASSERT(arena);
+
+	size_t index = page_index(arena, addr);
+	DEBUG_ASSERT(arena->state[index] & PAGE_STATE_ALLOCATED);
+
+	uint order = arena->state[index] & PAGE_STATE_ORDER_MASK;
+	arena->state[index] = 0;
+	arena->free_pages += 1U << order;
+
+	/* merge with the buddy for as long as it is free and whole */
+	while (order < PAGE_ALLOC_MAX_ORDER) {
+		addr_t buddy = addr ^ block_bytes(order);
+
+		if (buddy < arena->base || page_index(arena, buddy) >= arena->pages)
+			break;
+		if (arena->state[page_index(arena, buddy)] != (PAGE_STATE_FREE | order))
+			break;
+
+		free_block_remove(arena, buddy);
+		if (buddy < addr)
+			addr = buddy;
+		order++;
+	}
+
+	free_block_insert(arena, addr, order);
+
+	exit_critical_section();
+}
+
+size_t page_alloc_size(const void *ptr)
+{
+	addr_t addr = (addr_t)ptr;
+
+	if (addr & (PAGE_SIZE - 1))
+		return 0;
+
+	struct page_arena *arena = find_arena(addr);
+	if (!arena)
+		return 0;
+
+	uint8_t state = arena->state[page_index(arena, addr)];
+	if (!(state & PAGE_STATE_ALLOCATED) || (state & PAGE_STATE_POOL))
+		return 0;
+
+	return block_bytes(state & PAGE_STATE_ORDER_MASK);
+}
+
+void page_alloc_dump(void)
+{
+	uint i, order;
+
+	enter_critical_section();
+	for (i = 0; i < arena_count; i++) {
+		struct page_arena *arena = &arenas[i];
+
+		dprintf(INFO, "\tarena %u: base 0x%lx, %zu pages, %zu free\n", i,
+			arena->base, arena->pages, arena->free_pages);
+
+		for (order = 0; order <= PAGE_ALLOC_MAX_ORDER; order++) {
+			if (arena->free_count[order])
+				dprintf(INFO, "\t\torder %2u (%7zu bytes): %u free\n", order, block_bytes(order),
+					arena->free_count[order]);
+		}
+	}
+	exit_critical_section();
+}
+
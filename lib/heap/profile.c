@@ -0,0 +1,254 @@
+/*
+ * Copyright (c) 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file
+ * @brief  Heap allocation site profiler
+ *
+ * With WITH_HEAP_PROFILE=1 every allocation is charged to the return
+ * address of whoever called into the heap. Sites live in a fixed size open
+ * addressed table; once it fills up new sites are lumped together as
+ * "other". Chunk allocations remember their site in the allocation header.
+ * Page allocations have no header, so their sites are kept in a second
+ * fixed table keyed by address, and anything that doesn't fit there is
+ * charged to "other" as well. Either way the cost per allocation is a
+ * single pointer.
+ *
+ * The hooks are called from inside the heap's critical section.
+ */
+#include <debug.h>
+#include <string.h>
+#include <kernel/thread.h>
+#include "heap_p.h"
+
+#if WITH_HEAP_PROFILE
+
+#if (HEAP_PROFILE_SITES & (HEAP_PROFILE_SITES - 1)) != 0
+#error HEAP_PROFILE_SITES must be a power of 2
+#endif
+
+#if (HEAP_PROFILE_PAGE_ALLOCS & (HEAP_PROFILE_PAGE_ALLOCS - 1)) != 0
+#error HEAP_PROFILE_PAGE_ALLOCS must be a power of 2
+#endif
+
+struct heap_profile_site {
+	void *caller;
+	size_t live_bytes;
+	uint live_count;
+	uint allocs;
+
+	/* as of the last snapshot */
+	size_t snap_bytes;
+	uint snap_count;
+};
+
+struct heap_profile_page {
+	void *ptr;
+	struct heap_profile_site *site;
+};
+
+static struct heap_profile_site sites[HEAP_PROFILE_SITES];
+static struct heap_profile_site other_site;
+static struct heap_profile_page pages[HEAP_PROFILE_PAGE_ALLOCS];
+
+static inline uint profile_hash(const void *p, uint size)
+{
+	return (uint)(((addr_t)p >> 2) * 2654435761U) & (size - 1);
+}
+
+static struct heap_profile_site *profile_lookup(void *caller)
+{
+	uint i;
+	uint index = profile_hash(caller, HEAP_PROFILE_SITES);
+
+	for (i = 0; i < HEAP_PROFILE_SITES; i++) {
+		struct heap_profile_site *site = &sites[(index + i) & (HEAP_PROFILE_SITES - 1)];
+
+		if (site->caller == caller)
+			return site;
+
+		if (!site->caller) {
+			site->caller = caller;
+			return site;
+		}
+	}
+
+	return &other_site;
+}
+
+struct heap_profile_site *heap_profile_alloc(void *caller, size_t len)
+{
+	struct heap_profile_site *site = caller ? profile_lookup(caller) : &other_site;
+
+	site->live_bytes += len;
+	site->live_count++;
+	site->allocs++;
+
+	return site;
+}
+
+void heap_profile_free(struct heap_profile_site *site, size_t len)
+{
+	site->live_bytes -= len;
+	site->live_count--;
+}
+
+void heap_profile_resize(struct heap_profile_site *site, size_t old_len, size_t new_len)
+{
+	site->live_bytes += new_len - old_len;
+}
+
+static bool page_table_insert(void *ptr, struct heap_profile_site *site)
+{
+	uint i;
+	uint index = profile_hash(ptr, HEAP_PROFILE_PAGE_ALLOCS);
+
+	for (i = 0; i < HEAP_PROFILE_PAGE_ALLOCS; i++) {
+		struct heap_profile_page *page = &pages[(index + i) & (HEAP_PROFILE_PAGE_ALLOCS - 1)];
+
+		if (!page->ptr) {
+			page->ptr = ptr;
+			page->site = site;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void heap_profile_page_alloc(void *ptr, void *caller, size_t len)
+{
+	struct heap_profile_site *site = heap_profile_alloc(caller, len);
+
+	if (!page_table_insert(ptr, site)) {
+		/* no room to remember it, so the free will be charged to other */
+		heap_profile_free(site, len);
+		other_site.live_bytes += len;
+		other_site.live_count++;
+	}
+}
+
+void heap_profile_page_free(void *ptr, size_t len)
+{
+	uint i;
+	uint index = profile_hash(ptr, HEAP_PROFILE_PAGE_ALLOCS);
+
+	for (i = 0; i < HEAP_PROFILE_PAGE_ALLOCS; i++) {
+		uint slot = (index + i) & (HEAP_PROFILE_PAGE_ALLOCS - 1);
+
+		if (!pages[slot].ptr)
+			break;
+		if (pages[slot].ptr != ptr)
+			continue;
+
+		heap_profile_free(pages[slot].site, len);
+		pages[slot].ptr = NULL;
+
+		/* put back the rest of the run so none of it is cut off by the hole */
+		for (slot = (slot + 1) & (HEAP_PROFILE_PAGE_ALLOCS - 1); pages[slot].ptr;
+				slot = (slot + 1) & (HEAP_PROFILE_PAGE_ALLOCS - 1)) {
+			struct heap_profile_page moved = pages[slot];
+
+			pages[slot].ptr = NULL;
+			page_table_insert(moved.ptr, moved.site);
+		}
+		return;
+	}
+
+	heap_profile_free(&other_site, len);
+}
+
+void heap_profile_snapshot(void)
+{
+	uint i;
+
+	enter_critical_section();
+	for (i = 0; i < HEAP_PROFILE_SITES; i++) {
+		sites[i].snap_bytes = sites[i].live_bytes;
+		sites[i].snap_count = sites[i].live_count;
+	}
+	other_site.snap_bytes = other_site.live_bytes;
+	other_site.snap_count = other_site.live_count;
+	exit_critical_section();
+}
+
+/* what a site is ranked by, live bytes or their growth since the snapshot */
+static long profile_key(const struct heap_profile_site *site, bool diff)
+{
+	return diff ? (long)(site->live_bytes - site->snap_bytes) : (long)site->live_bytes;
+}
+
+void heap_profile_dump(uint count, bool diff)
+{
+	static struct heap_profile_site copy[HEAP_PROFILE_SITES + 1];
+	uint used = 0;
+	uint shown = 0;
+	uint i, j;
+
+	/* take a consistent copy, then sort and print it at leisure */
+	enter_critical_section();
+	for (i = 0; i < HEAP_PROFILE_SITES; i++) {
+		if (sites[i].caller)
+			copy[used++] = sites[i];
+	}
+	if (other_site.allocs || other_site.live_count)
+		copy[used++] = other_site;
+	exit_critical_section();
+
+	for (i = 1; i < used; i++) {
+		struct heap_profile_site site = copy[i];
+		long key = profile_key(&site, diff);
+
+		for (j = i; j > 0 && profile_key(&copy[j - 1], diff) < key; j--)
+			copy[j] = copy[j - 1];
+		copy[j] = site;
+	}
+
+	if (diff)
+		printf("%-10s %10s %8s %10s %8s\n", "caller", "bytes", "count", "+bytes", "+count");
+	else
+		printf("%-10s %10s %8s %10s\n", "caller", "bytes", "count", "allocs");
+
+	for (i = 0; i < used && shown < count; i++) {
+		const struct heap_profile_site *site = &copy[i];
+
+		if (diff && site->live_bytes == site->snap_bytes && site->live_count == site->snap_count)
+			continue;
+		shown++;
+
+		if (site->caller)
+			printf("%-10p ", site->caller);
+		else
+			printf("%-10s ", "other");
+
+		if (diff) {
+			printf("%10zu %8u %+10ld %+8d\n", site->live_bytes, site->live_count,
+				profile_key(site, true), (int)(site->live_count - site->snap_count));
+		} else {
+			printf("%10zu %8u %10u\n", site->live_bytes, site->live_count, site->allocs);
+		}
+	}
+}
+
+#endif
+
@@ -1,4 +1,12 @@
 LOCAL_DIR := $(GET_LOCAL_DIR)
 
+# the allocator backend, firstfit or tlsf
+HEAP_IMPLEMENTATION ?= firstfit
+
 OBJS += \
-	$(LOCAL_DIR)/heap.o
+	$(LOCAL_DIR)/arena.o \
+	$(LOCAL_DIR)/heap.o \
+	$(LOCAL_DIR)/kmem_cache.o \
+	$(LOCAL_DIR)/page_alloc.o \
+	$(LOCAL_DIR)/profile.o \
+	$(LOCAL_DIR)/$(HEAP_IMPLEMENTATION).o
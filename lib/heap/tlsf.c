@@ -0,0 +1,473 @@
+/*
+ * Copyright (c) 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * two level segregated fit backend
+ *
+ * Each pool keeps its free blocks on one of FL_COUNT * SL_COUNT lists. The
+ * first level splits sizes by power of two, the second level splits each
+ * power of two range into SL_COUNT equal parts. A bitmap per level records
+ * which lists are populated, so finding a fitting block is a couple of
+ * find-first-set operations no matter how many blocks are free or how
+ * fragmented the heap is.
+ *
+ * Every block starts with its size. The low bits of the size say whether
+ * the block is free and whether the block physically before it is free.
+ * A free block keeps a pointer back to its start in its last word, so a
+ * block being freed can find and merge with both of its neighbors in
+ * constant time. The end of each pool is marked with a zero sized block
+ * that is always in use. The pool's own bookkeeping sits at the start of
+ * the range it manages.
+ */
+#include <debug.h>
+#include <assert.h>
+#include <string.h>
+#include <compiler.h>
+#include "heap_p.h"
+
+#define LOCAL_TRACE 0
+
+#define ROUNDUP(a, b) (((a) + ((b)-1)) & ~((b)-1))
+
+#define ALIGN_SHIFT 3
+#define ALIGN_SIZE (1 << ALIGN_SHIFT)
+
+#define SL_SHIFT 4
+#define SL_COUNT (1 << SL_SHIFT)
+
+/* blocks below SMALL_BLOCK all share the first list of the first level */
+#define FL_SHIFT (SL_SHIFT + ALIGN_SHIFT)
+#define SMALL_BLOCK (1 << FL_SHIFT)
+
+/* the largest block is just under 2^FL_MAX bytes */
+#define FL_MAX 31
+#define FL_COUNT (FL_MAX - FL_SHIFT + 1)
+
+#define BLOCK_FREE 0x1
+#define BLOCK_PREV_FREE 0x2
+#define BLOCK_FLAGS (BLOCK_FREE | BLOCK_PREV_FREE)
+
+struct tlsf_block {
+	size_t size;	/* including this header, with the BLOCK_ flags in the low bits */
+
+	/* only valid while the block is free */
+	struct tlsf_block *next_free;
+	struct tlsf_block *prev_free;
+};
+
+/* the part of the header that stays in front of an allocated block */
+#define BLOCK_HEADER_SIZE (sizeof(size_t))
+
+/* a free block has to hold its header, free list links and the back pointer */
+#define BLOCK_MIN_SIZE ROUNDUP(sizeof(struct tlsf_block) + sizeof(struct tlsf_block *), ALIGN_SIZE)
+
+/* the largest block a range can be made into */
+#define BLOCK_MAX_SIZE ((1UL << FL_MAX) - ALIGN_SIZE)
+
+struct heap_pool {
+	uint32_t fl_bitmap;
+	uint32_t sl_bitmap[FL_COUNT];
+	struct tlsf_block *free_lists[FL_COUNT][SL_COUNT];
+};
+
+/* index of the highest and lowest set bits, x must not be 0 */
+static inline int tlsf_fls(size_t x)
+{
+	return (int)(sizeof(unsigned long) * 8) - 1 - __builtin_clzl(x);
+}
+
+static inline int tlsf_ffs(uint32_t x)
+{
+	return __builtin_ctz(x);
+}
+
+static inline size_t block_size(const struct tlsf_block *block)
+{
+	return block->size & ~BLOCK_FLAGS;
+}
+
+static inline bool block_is_free(const struct tlsf_block *block)
+{
+	return (block->size & BLOCK_FREE) != 0;
+}
+
+static inline struct tlsf_block *block_next(const struct tlsf_block *block)
+{
+	return (struct tlsf_block *)((uint8_t *)block + block_size(block));
+}
+
+/* only valid if the previous block is free */
+static inline struct tlsf_block *block_prev(const struct tlsf_block *block)
+{
+	return ((struct tlsf_block **)block)[-1];
+}
+
+static inline void *block_to_ptr(const struct tlsf_block *block)
+{
+	return (uint8_t *)block + BLOCK_HEADER_SIZE;
+}
+
+static inline struct tlsf_block *ptr_to_block(const void *ptr)
+{
+	return (struct tlsf_block *)((uint8_t *)ptr - BLOCK_HEADER_SIZE);
+}
+
+/* the list a block of this size is kept on */
+static void mapping_insert(size_t size, int *fl, int *sl)
+{
+	if (size < SMALL_BLOCK) {
+		*fl = 0;
+		*sl = size >> ALIGN_SHIFT;
+	} else {
+		int f = tlsf_fls(size);
+
+		*sl = (size >> (f - SL_SHIFT)) ^ SL_COUNT;
+		*fl = f - FL_SHIFT + 1;
+	}
+}
+
+/* the first list whose blocks are all at least this size */
+static void mapping_search(size_t size, int *fl, int *sl)
+{
+	if (size >= SMALL_BLOCK)
+		size += (1UL << (tlsf_fls(size) - SL_SHIFT)) - 1;
+
+	mapping_insert(size, fl, sl);
+}
+
+static struct tlsf_block *find_suitable_block(struct heap_pool *pool, int *fl, int *sl)
+{
+	uint32_t sl_map = pool->sl_bitmap[*fl] & (~0U << *sl);
+
+	if (!sl_map) {
+		/* nothing left at this level, move up to the next populated one */
+		uint32_t fl_map = pool->fl_bitmap & (~0U << (*fl + 1));
+		if (!fl_map)
+			return NULL;
+
+		*fl = tlsf_ffs(fl_map);
+		sl_map = pool->sl_bitmap[*fl];
+	}
+
+	*sl = tlsf_ffs(sl_map);
+
+	return pool->free_lists[*fl][*sl];
+}
+
+static void remove_free_block(struct heap_pool *pool, struct tlsf_block *block, int fl, int sl)
+{
+	struct tlsf_block *prev = block->prev_free;
+	struct tlsf_block *next = block->next_free;
+
+	if (next)
+		next->prev_free = prev;
+	if (prev)
+		prev->next_free = next;
+
+	if (pool->free_lists[fl][sl] == block) {
+		pool->free_lists[fl][sl] = next;
+
+		if (!next) {
+			pool->sl_bitmap[fl] &= ~(1U << sl);
+			if (!pool->sl_bitmap[fl])
+				pool->fl_bitmap &= ~(1U << fl);
+		}
+	}
+}
+
+static void insert_free_block(struct heap_pool *pool, struct tlsf_block *block, int fl, int sl)
+{
+	struct tlsf_block *head = pool->free_lists[fl][sl];
+
+	block->next_free = head;
+	block->prev_free = NULL;
+	if (head)
+		head->prev_free = block;
+
+	pool->free_lists[fl][sl] = block;
+	pool->fl_bitmap |= 1U << fl;
+	pool->sl_bitmap[fl] |= 1U << sl;
+}
+
+static void block_remove(struct heap_pool *pool, struct tlsf_block *block)
+{
+	int fl, sl;
+
+	mapping_insert(block_size(block), &fl, &sl);
+	remove_free_block(pool, block, fl, sl);
+}
+
+static void block_insert(struct heap_pool *pool, struct tlsf_block *block)
+{
+	int fl, sl;
+
+	mapping_insert(block_size(block), &fl, &sl);
+	insert_free_block(pool, block, fl, sl);
+}
+
+/* flag a block free and leave a pointer to it where the next block can find it */
+static void block_mark_free(struct tlsf_block *block)
+{
+	struct tlsf_block *next = block_next(block);
+
+	block->size |= BLOCK_FREE;
+	((struct tlsf_block **)next)[-1] = block;
+	next->size |= BLOCK_PREV_FREE;
+}
+
+static void block_mark_used(struct tlsf_block *block)
+{
+	block->size &= ~BLOCK_FREE;
+	block_next(block)->size &= ~BLOCK_PREV_FREE;
+}
+
+/* set a block's size, keeping its flags */
+static inline void block_set_size(struct tlsf_block *block, size_t size)
+{
+	block->size = size | (block->size & BLOCK_FLAGS);
+}
+
+/* size of the block needed to hand out len bytes */
+static inline size_t adjust_request_size(size_t len)
+{
+	size_t size = ROUNDUP(len + BLOCK_HEADER_SIZE, ALIGN_SIZE);
+
+	return (size < BLOCK_MIN_SIZE) ? BLOCK_MIN_SIZE : size;
+}
+
+/*
+ * cut a block down to size, giving back whatever is left over if it is big
+ * enough to be a block. The block must not be on a free list.
+ */
+static void block_trim(struct heap_pool *pool, struct tlsf_block *block, size_t size)
+{
+	size_t remaining = block_size(block) - size;
+	if (remaining < BLOCK_MIN_SIZE)
+		return;
+
+	struct tlsf_block *rest = (struct tlsf_block *)((uint8_t *)block + size);
+
+	block_set_size(block, size);
+	rest->size = remaining;
+
+	/* the tail of a shrinking allocation may have a free neighbor */
+	struct tlsf_block *next = block_next(rest);
+	if (block_is_free(next)) {
+		block_remove(pool, next);
+		block_set_size(rest, block_size(rest) + block_size(next));
+	}
+
+	block_mark_free(rest);
+	block_insert(pool, rest);
+}
+
+/* turn a range into one big free block, capped by a sentinel */
+static void pool_add_range(struct heap_pool *pool, vaddr_t start, vaddr_t end)
+{
+	struct tlsf_block *block;
+	struct tlsf_block *sentinel;
+
+	/* the top level list can't hold anything bigger */
+	if (end - start > BLOCK_MAX_SIZE) {
+		dprintf(INFO, "tlsf: only using 0x%lx of 0x%lx bytes at 0x%lx\n", BLOCK_MAX_SIZE, end - start, start);
+		end = start + BLOCK_MAX_SIZE;
+	}
+
+	LTRACEF("start 0x%lx end 0x%lx\n", start, end);
+
+	block = (struct tlsf_block *)start;
+	block->size = end - start;
+	sentinel = block_next(block);
+	sentinel->size = 0;
+
+#if DEBUG_HEAP
+	memset(block_to_ptr(block), FREE_FILL, block_size(block) - BLOCK_HEADER_SIZE);
+#endif
+
+	block_mark_free(block);
+	block_insert(pool, block);
+}
+
+struct heap_pool *heap_backend_create(void *base, size_t len)
+{
+	struct heap_pool *pool;
+
+	/* trim the range to block alignment and leave room for the sentinel */
+	vaddr_t start = ROUNDUP((vaddr_t)base, ALIGN_SIZE);
+	vaddr_t end = ((vaddr_t)base + len - BLOCK_HEADER_SIZE) & ~(ALIGN_SIZE - 1);
+
+	if (end <= start || end - start < ROUNDUP(sizeof(struct heap_pool), ALIGN_SIZE) + BLOCK_MIN_SIZE)
+		return NULL;
+
+	/* the pool goes first, the rest of the range is one big free block */
+	pool = (struct heap_pool *)start;
+	memset(pool, 0, sizeof(*pool));
+	start += ROUNDUP(sizeof(struct heap_pool), ALIGN_SIZE);
+
+	pool_add_range(pool, start, end);
+
+	return pool;
+}
+
+void heap_backend_extend(struct heap_pool *pool, void *base, size_t len)
+{
+	vaddr_t start = ROUNDUP((vaddr_t)base, ALIGN_SIZE);
+	vaddr_t end = ((vaddr_t)base + len - BLOCK_HEADER_SIZE) & ~(ALIGN_SIZE - 1);
+
+	if (end <= start || end - start < BLOCK_MIN_SIZE)
+		return;
+
+	pool_add_range(pool, start, end);
+}
+
+void *heap_backend_alloc(struct heap_pool *pool, size_t size, size_t *allocated)
+{
+	struct tlsf_block *block;
+	int fl, sl;
+
+	if (size > BLOCK_MAX_SIZE / 2)
+		return NULL;
+
+	size = adjust_request_size(size);
+
+	mapping_search(size, &fl, &sl);
+	block = find_suitable_block(pool, &fl, &sl);
+	if (!block)
+		return NULL;
+
+	DEBUG_ASSERT(block_is_free(block));
+	DEBUG_ASSERT(block_size(block) >= size);
+
+	remove_free_block(pool, block, fl, sl);
+	block_trim(pool, block, size);
+	block_mark_used(block);
+
+	*allocated = block_size(block) - BLOCK_HEADER_SIZE;
+
+	LTRACEF("block %p size %zu\n", block, block_size(block));
+
+	return block_to_ptr(block);
+}
+
+void heap_backend_free(struct heap_pool *pool, void *ptr, size_t len)
+{
+	struct tlsf_block *block = ptr_to_block(ptr);
+
+	DEBUG_ASSERT(!block_is_free(block));
+	DEBUG_ASSERT(len == block_size(block) - BLOCK_HEADER_SIZE);
+
+#if DEBUG_HEAP
+	memset(ptr, FREE_FILL, len);
+#endif
+
+	/* merge with the block before us */
+	if (block->size & BLOCK_PREV_FREE) {
+		struct tlsf_block *prev = block_prev(block);
+
+		DEBUG_ASSERT(block_is_free(prev));
+		block_remove(pool, prev);
+		block_set_size(prev, block_size(prev) + block_size(block));
+		block = prev;
+	}
+
+	/* and with the one after */
+	struct tlsf_block *next = block_next(block);
+	if (block_is_free(next)) {
+		block_remove(pool, next);
+		block_set_size(block, block_size(block) + block_size(next));
+	}
+
+	block_mark_free(block);
+	block_insert(pool, block);
+}
+
+bool heap_backend_resize(struct heap_pool *pool, void *ptr, size_t len, size_t new_len, size_t *allocated)
+{
+	struct tlsf_block *block = ptr_to_block(ptr);
+
+	DEBUG_ASSERT(!block_is_free(block));
+	DEBUG_ASSERT(len == block_size(block) - BLOCK_HEADER_SIZE);
+
+	if (new_len > BLOCK_MAX_SIZE / 2)
+		return false;
+
+	size_t size = adjust_request_size(new_len);
+
+	if (size > block_size(block)) {
+		/* soak up the next block if it is free and makes us big enough */
+		struct tlsf_block *next = block_next(block);
+		if (!block_is_free(next) || block_size(block) + block_size(next) < size)
+			return false;
+
+		block_remove(pool, next);
+		block_set_size(block, block_size(block) + block_size(next));
+		block_mark_used(block);
+	}
+
+	block_trim(pool, block, size);
+
+	*allocated = block_size(block) - BLOCK_HEADER_SIZE;
+
+	LTRACEF("block %p size %zu\n", block, block_size(block));
+
+	return true;
+}
+
+void heap_backend_stats(struct heap_pool *pool, struct heap_stats *stats)
+{
+	int fl, sl;
+	struct tlsf_block *block;
+
+	for (fl = 0; fl < FL_COUNT; fl++) {
+		if (!(pool->fl_bitmap & (1U << fl)))
+			continue;
+
+		for (sl = 0; sl < SL_COUNT; sl++) {
+			for (block = pool->free_lists[fl][sl]; block; block = block->next_free)
+				heap_stats_add_free(stats, block_size(block) - BLOCK_HEADER_SIZE);
+		}
+	}
+}
+
+void heap_backend_dump(struct heap_pool *pool)
+{
+	int fl, sl;
+	struct tlsf_block *block;
+
+	dprintf(INFO, "\tfree lists:\n");
+
+	for (fl = 0; fl < FL_COUNT; fl++) {
+		if (!(pool->fl_bitmap & (1U << fl)))
+			continue;
+
+		for (sl = 0; sl < SL_COUNT; sl++) {
+			if (!(pool->sl_bitmap[fl] & (1U << sl)))
+				continue;
+
+			for (block = pool->free_lists[fl][sl]; block; block = block->next_free) {
+				dprintf(INFO, "\t\t[%d][%d] base %p, end 0x%lx, len 0x%zx\n", fl, sl,
+					block, (vaddr_t)block + block_size(block), block_size(block));
+			}
+		}
+	}
+}
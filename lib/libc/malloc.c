@@ -23,16 +23,17 @@
 #include <debug.h>
 #include <malloc.h>
 #include <string.h>
+#include <compiler.h>
 #include <lib/heap.h>
 
 void *malloc(size_t size)
 {
-	return heap_alloc(size, 0);
+	return heap_alloc_tagged(size, 0, 0, __GET_CALLER());
 }
 
 void *memalign(size_t boundary, size_t size)
 {
-	return heap_alloc(size, boundary);
+	return heap_alloc_tagged(size, boundary, 0, __GET_CALLER());
 }
 
 void *calloc(size_t count, size_t size)
@@ -40,7 +41,7 @@ void *calloc(size_t count, size_t size)
 	void *ptr;
 	size_t realsize = count * size;
 
-	ptr = heap_alloc(realsize, 0);
+	ptr = heap_alloc_tagged(realsize, 0, 0, __GET_CALLER());
 	if (!ptr)
 		return NULL;
 
@@ -50,18 +51,7 @@ void *calloc(size_t count, size_t size)
 
 void *realloc(void *ptr, size_t size)
 {
-	if (!ptr)
-		return malloc(size);
-
-	// XXX better implementation
-	void *p = malloc(size);
-	if (!p)
-		return NULL;
-
-	memcpy(p, ptr, size); // XXX wrong
-	free(ptr);
-
-	return p;
+	return heap_realloc_tagged(ptr, size, __GET_CALLER());
 }
 
 void free(void *ptr)
@@ -319,13 +319,14 @@ ethernetif_input(struct netif *netif)
   }
 }
 
+/* runs from the interrupt thread, the lwIP input path is too long for interrupt context */
 static enum handler_return ethernet_int(void *arg)
 {
 	struct netif *netif = (struct netif *)arg;
 
 	ethernetif_input(netif);
 
-	return INT_RESCHEDULE;
+	return INT_NO_RESCHEDULE;
 }
 
 
@@ -386,7 +387,9 @@ status_t ethernet_init(void)
 	}
 
 	/* register for interrupt handlers */
-	register_int_handler(INT_NET, ethernet_int, netif);
+	status_t err = register_threaded_int_handler(INT_NET, NULL, ethernet_int, netif);
+	if (err < 0)
+		return err;
 
 	netif_set_default(netif);
 
@@ -208,6 +208,7 @@ void emac_init_send(void)
     emac->TBQP = (unsigned) xmit_list;
 
     mutex_init(&xmit_lock);
+    mutex_register(&xmit_lock, "emac xmit");
 }
 
 int ethernet_send(void *data, unsigned len)
@@ -53,7 +53,35 @@
 #define PL011_UARTICR (17)
 #define PL011_UARTMACR (18)
 
-#define INT_VECTORS 32 // XXX just made this up
+/* interrupt controller */
+#define PIC_IRQ_STATUS    (INTEGRATOR_INT_REG_BASE + 0x00)
+#define PIC_IRQ_RAWSTAT   (INTEGRATOR_INT_REG_BASE + 0x04)
+#define PIC_IRQ_ENABLESET (INTEGRATOR_INT_REG_BASE + 0x08)
+#define PIC_IRQ_ENABLECLR (INTEGRATOR_INT_REG_BASE + 0x0c)
+
+#define INT_VECTORS 32
+
+#define INT_TIMER0 5
+#define INT_TIMER1 6
+#define INT_TIMER2 7
+
+/* SP804 style counter/timers, timers 1 and 2 are clocked at 1MHz */
+#define TIMER_REG(n, reg) (INTEGRATOR_TIMER_REG_BASE + (n) * 0x100 + (reg))
+#define TIMER_LOAD    0x00
+#define TIMER_VALUE   0x04
+#define TIMER_CONTROL 0x08
+#define TIMER_INTCLR  0x0c
+#define TIMER_RIS     0x10
+#define TIMER_MIS     0x14
+#define TIMER_BGLOAD  0x18
+
+#define TIMER_CTRL_ONESHOT  (1<<0)
+#define TIMER_CTRL_32BIT    (1<<1)
+#define TIMER_CTRL_INTEN    (1<<5)
+#define TIMER_CTRL_PERIODIC (1<<6)
+#define TIMER_CTRL_ENABLE   (1<<7)
+
+#define TIMER_FREQ 1000000
 
 #endif
 
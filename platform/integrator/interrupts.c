@@ -25,6 +25,7 @@
 #include <debug.h>
 #include <reg.h>
 #include <kernel/thread.h>
+#include <kernel/ktrace.h>
 #include <platform/interrupts.h>
 #include <arch/ops.h>
 #include <arch/arm.h>
@@ -38,99 +39,14 @@ struct int_handler_struct {
 
 static struct int_handler_struct int_handler_table[INT_VECTORS];
 
-#if 0
-static const uint32_t icBase[5] = {
-	INTCON0_BASE, INTCON1_BASE, INTCON2_BASE, INTCON3_BASE, INTCON4_BASE };
-
-/* a bitmap of the level triggered interrupt vectors */
-static uint32_t level_trigger[5] = {
-	0xb3fefe8f,	// level 1 0-31
-	0xfdb3c1fd,	// level 2 0-31
-	0xfffff7ff, // level 2 32-63
-	0xbfffffff, // level 2 64-95
-	0xffffffff // level 2 96-128
-};
-
-inline volatile uint32_t *ICReg(uint controller, uint reg)
-{
-	return (volatile uint32_t *)(icBase[controller] + reg);
-}
-
-inline uint32_t readICReg(uint controller, uint reg)
-{
-	return *ICReg(controller, reg);
-}
-inline void writeICReg(uint controller, uint reg, uint val)
-{
-	*ICReg(controller, reg) = val;
-}
-
-inline uint vectorToController(uint vector)
-{
-	return vector / 32;
-}
-#endif
-
 void platform_init_interrupts(void)
 {
-#if 0
-	unsigned int i;
-
-	// mask all interrupts
-	*ICReg(0, INTCON_MIR) = 0xfffffffa;
-	*ICReg(1, INTCON_MIR) = 0xffffffff;
-	*ICReg(2, INTCON_MIR) = 0xffffffff;
-	*ICReg(3, INTCON_MIR) = 0xffffffff;
-	*ICReg(4, INTCON_MIR) = 0xffffffff;
-
-	// set up each of the interrupts
-	for (i = 0; i < INT_VECTORS; i++) {
-		// set each vector up as high priority, IRQ, and default edge/level sensitivity
-		*ICReg(i / 32, INTCON_ILR_BASE + 4*(i%32)) = ((level_trigger[i/32] & (1<<(i%32))) ? (1<<1) : (0<<1)) | 0;
-	}
-
-	// clear any pending interrupts
-	*ICReg(0, INTCON_ITR) = 0;
-	*ICReg(1, INTCON_ITR) = 0;
-	*ICReg(2, INTCON_ITR) = 0;
-	*ICReg(3, INTCON_ITR) = 0;
-	*ICReg(4, INTCON_ITR) = 0;
-
-	// globally unmask interrupts
-	*ICReg(1, INTCON_CONTROL) = 3;
-	*ICReg(0, INTCON_CONTROL) = 3;
-	*ICReg(0, INTCON_GMR) = 0;
-
-	dprintf("end of platform_init_interrupts\n");
-
-#if 0
-	arch_enable_ints();
-
-	dprintf("&ITR0 0x%x\n", (uint32_t)ICReg(0, INTCON_ITR));
-
-	dprintf("ITR0 0x%x\n", *ICReg(0, INTCON_ITR));
-	dprintf("MIR0 0x%x\n", *ICReg(0, INTCON_MIR));
-	dprintf("SIR_IRQ0 0x%x\n", *ICReg(0, INTCON_SIR_IRQ));
-
-	*ICReg(0, INTCON_ILR_BASE + 4*7) = 0;
-	*ICReg(0, INTCON_MIR) &= ~0x80;
-
-	dprintf("triggering int\n");
-	
-	*ICReg(0, INTCON_SISR) = 0x80;
-
-	dprintf("ITR0 0x%x\n", *ICReg(0, INTCON_ITR));
-	dprintf("MIR0 0x%x\n", *ICReg(0, INTCON_MIR));
-	dprintf("SIR_IRQ0 0x%x\n", *ICReg(0, INTCON_SIR_IRQ));
-
-	for(;;);
-#endif
-#endif
+	// mask all the interrupts
+	*REG32(PIC_IRQ_ENABLECLR) = 0xffffffff;
 }
 
 status_t mask_interrupt(unsigned int vector)
 {
-#if 0
 	if (vector >= INT_VECTORS)
 		return ERR_INVALID_ARGS;
 
@@ -138,21 +54,15 @@ status_t mask_interrupt(unsigned int vector)
 
 	enter_critical_section();
 
-	if (oldstate)
-		*oldstate = false;
-
-	volatile uint32_t *mir = ICReg(vectorToController(vector), INTCON_MIR);
-	*mir = *mir | (1<<(vector % 32));
+	*REG32(PIC_IRQ_ENABLECLR) = 1 << vector;
 
 	exit_critical_section();
-#endif
 
 	return NO_ERROR;
 }
 
 status_t unmask_interrupt(unsigned int vector)
 {
-#if 0
 	if (vector >= INT_VECTORS)
 		return ERR_INVALID_ARGS;
 
@@ -160,67 +70,49 @@ status_t unmask_interrupt(unsigned int vector)
 
 	enter_critical_section();
 
-	if (oldstate)
-		*oldstate = false;
-
-	volatile uint32_t *mir = ICReg(vectorToController(vector), INTCON_MIR);
-	*mir = *mir & ~(1<<(vector % 32));
+	*REG32(PIC_IRQ_ENABLESET) = 1 << vector;
 
 	exit_critical_section();
-#endif
 
 	return NO_ERROR;
 }
 
-void platform_irq(struct arm_iframe *frame)
+enum handler_return platform_irq(struct arm_iframe *frame)
 {
-	PANIC_UNIMPLEMENTED;
-#if 0
-	// get the current vector
-	unsigned int vector;
-   
-	inc_critical_section();
-
-	// read from the first level int handler
-	vector = *ICReg(0, INTCON_SIR_IRQ);
-	
-	// see if it's coming from the second level handler
-	if (vector == 0) {
-		vector = *ICReg(1, INTCON_SIR_IRQ) + 32;
-	}
+	// get the pending vectors
+	uint32_t status = *REG32(PIC_IRQ_STATUS);
+	if (status == 0)
+		return INT_NO_RESCHEDULE;
 
-//	dprintf("platform_irq: spsr 0x%x, pc 0x%x, currthread %p, vector %d\n", frame->spsr, frame->pc, current_thread, vector);
+	THREAD_STATS_INC(interrupts);
 
-	// deliver the interrupt
-	enum handler_return ret; 
+//	dprintf("platform_irq: spsr 0x%x, pc 0x%x, currthread %p, status 0x%x\n", frame->spsr, frame->pc, current_thread, status);
 
-	ret = INT_NO_RESCHEDULE;
-	if (int_handler_table[vector].handler)
-		ret = int_handler_table[vector].handler(int_handler_table[vector].arg);
+	// deliver every pending interrupt, lowest vector first
+	enum handler_return ret = INT_NO_RESCHEDULE;
+	while (status != 0) {
+		unsigned int vector = __builtin_ctz(status);
+		status &= ~(1 << vector);
 
-	// ack the interrupt
-	if (vector >= 32) {
-		// interrupt is chained, so ack the second level first, and then the first
-		*ICReg(vector / 32, INTCON_ITR) = ~(1 << (vector % 32));
-		*ICReg(1, INTCON_CONTROL) |= 1;
-		vector = 0; // force the following code to ack the chained first level vector
-	} 
+		KTRACE(KTRACE_IRQ_ENTER, vector, 0);
 
-	*ICReg(0, INTCON_ITR) = ~(1 << vector);
-	*ICReg(0, INTCON_CONTROL) = 1;
+		enum handler_return vret = INT_NO_RESCHEDULE;
+		if (int_handler_table[vector].handler)
+			vret = int_handler_table[vector].handler(int_handler_table[vector].arg);
+		if (vret == INT_RESCHEDULE)
+			ret = INT_RESCHEDULE;
 
-	if (ret == INT_RESCHEDULE)
-		thread_preempt();
+		KTRACE(KTRACE_IRQ_EXIT, vector, vret);
+	}
 
-	dec_critical_section();
+//	dprintf("platform_irq: exit %d\n", ret);
 
-//	dprintf("platform_irq: exit\n");
-#endif
+	return ret;
 }
 
 void platform_fiq(struct arm_iframe *frame)
 {
-	PANIC_UNIMPLEMENTED;
+	panic("FIQ: unimplemented\n");
 }
 
 void register_int_handler(unsigned int vector, int_handler handler, void *arg)
@@ -40,13 +40,13 @@ void platform_early_init(void)
 	for (addr = SDRAM_BASE; addr < SDRAM_BASE + SDRAM_SIZE; addr += (1024*1024)) {
 		arm_mmu_map_section(addr, addr, MMU_FLAG_CACHED|MMU_FLAG_BUFFERED|MMU_FLAG_READWRITE);
 	}
+#endif
 
 	/* initialize the interrupt controller */
 	platform_init_interrupts();
 
 	/* initialize the timer block */
 	platform_init_timer();
-#endif
 }
 
 void platform_init(void)
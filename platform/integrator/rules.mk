@@ -18,6 +18,10 @@ OBJS += \
 
 #	$(LOCAL_DIR)/console.o \
 
+DEFINES += \
+	PLATFORM_HAS_DYNAMIC_TIMER=1 \
+	PLATFORM_HAS_HIRES_TIMER=1
+
 MEMBASE ?= 0x0
 MEMSIZE ?= 0x08000000	# 128MB
 
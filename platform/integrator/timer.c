@@ -24,83 +24,163 @@
 #include <err.h>
 #include <kernel/thread.h>
 #include <debug.h>
+#include <reg.h>
 #include <platform.h>
 #include <platform/interrupts.h>
 #include <platform/timer.h>
 #include <platform/integrator.h>
 #include "platform_p.h"
 
-static time_t system_time = 0;
+/*
+ * timer 1 free runs as the timebase, interrupting once per wrap of its 32 bit
+ * counter (~71 minutes) so we can extend it to 64 bits. timer 2 is programmed
+ * in one-shot mode for each kernel timer event, so an idle system takes no
+ * interrupts at all other than the timebase wrap.
+ */
+#define TIMEBASE_TIMER 1
+#define EVENT_TIMER 2
+
+static volatile uint32_t timebase_wraps;
 
-static time_t tick_interval;
-static uint32_t ticks_per_interval;
 static platform_timer_callback t_callback;
 static void *callback_arg;
 
+static uint32_t usec_to_ticks(bigtime_t interval)
+{
+	uint64_t ticks = interval * TIMER_FREQ / 1000000;
+
+	if (ticks == 0)
+		ticks = 1;
+	if (ticks > 0xffffffff)
+		ticks = 0xffffffff;
+
+	return ticks;
+}
+
+static void program_event_timer(bigtime_t interval, uint32_t mode)
+{
+	*REG32(TIMER_REG(EVENT_TIMER, TIMER_CONTROL)) = 0; // stop it
+	*REG32(TIMER_REG(EVENT_TIMER, TIMER_INTCLR)) = 1;
+	*REG32(TIMER_REG(EVENT_TIMER, TIMER_LOAD)) = usec_to_ticks(interval);
+	*REG32(TIMER_REG(EVENT_TIMER, TIMER_CONTROL)) = TIMER_CTRL_ENABLE | TIMER_CTRL_INTEN | TIMER_CTRL_32BIT | mode;
+}
+
 status_t platform_set_periodic_timer(platform_timer_callback callback, void *arg, time_t interval)
 {
-#if 0
 	enter_critical_section();
 
 	t_callback = callback;
 	callback_arg = arg;
-	tick_interval = interval;
-	ticks_per_interval = interval * 32768 / 1000; // interval is in ms
 
-	OS_TIMER_CTRL_REG = 0; // stop it
-	OS_TIMER_TICK_VALUE_REG = ticks_per_interval;
-	OS_TIMER_CTRL_REG = (1<<3) | (1<<2) | (1<<1) | (1<<0);
+	program_event_timer((bigtime_t)interval * 1000, TIMER_CTRL_PERIODIC);
 
 	exit_critical_section();
-#endif
 
 	return NO_ERROR;
 }
 
-time_t current_time(void)
+status_t platform_set_oneshot_timer(platform_timer_callback callback, void *arg, time_t interval)
 {
-#if 0
-	time_t t;
-	uint32_t delta_ticks;
-	uint32_t delta_ticks2;
-	
-retry:
-	delta_ticks = OS_TIMER_TICK_COUNTER_REG;
-	t = system_time;
-	delta_ticks2 = OS_TIMER_TICK_COUNTER_REG;
-	if (delta_ticks2 > delta_ticks)
-		goto retry;
-
-	t += ((ticks_per_interval - delta_ticks2) * tick_interval) / ticks_per_interval;
-
-	return t;
-#else
-	static time_t time = 0;
-	return time++;
-#endif
+	enter_critical_section();
+
+	t_callback = callback;
+	callback_arg = arg;
 
+	program_event_timer((bigtime_t)interval * 1000, TIMER_CTRL_ONESHOT);
+
+	exit_critical_section();
+
+	return NO_ERROR;
+}
+
+status_t platform_set_oneshot_timer_hires(platform_timer_callback callback, void *arg, bigtime_t interval)
+{
+	enter_critical_section();
+
+	t_callback = callback;
+	callback_arg = arg;
+
+	program_event_timer(interval, TIMER_CTRL_ONESHOT);
+
+	exit_critical_section();
+
+	return NO_ERROR;
+}
+
+void platform_stop_timer(void)
+{
+	enter_critical_section();
+
+	*REG32(TIMER_REG(EVENT_TIMER, TIMER_CONTROL)) = 0;
+	*REG32(TIMER_REG(EVENT_TIMER, TIMER_INTCLR)) = 1;
+
+	exit_critical_section();
 }
 
 bigtime_t current_time_hires(void)
 {
-	return (bigtime_t)current_time() * 1000;
+	uint32_t wraps;
+	uint32_t count;
+	uint32_t count2;
+
+	enter_critical_section();
+
+	/*
+	 * if the counter wrapped but we haven't serviced the interrupt yet,
+	 * account for it here using a value read after the wrap.
+	 */
+	wraps = timebase_wraps;
+	count = *REG32(TIMER_REG(TIMEBASE_TIMER, TIMER_VALUE));
+	if (*REG32(TIMER_REG(TIMEBASE_TIMER, TIMER_RIS)) & 1) {
+		count2 = *REG32(TIMER_REG(TIMEBASE_TIMER, TIMER_VALUE));
+		wraps++;
+		count = count2;
+	}
+
+	exit_critical_section();
+
+	/* the counter counts down from 0xffffffff at 1MHz */
+	return ((bigtime_t)wraps << 32) | (bigtime_t)(0xffffffff - count);
 }
 
-static enum handler_return os_timer_tick(void *arg)
+time_t current_time(void)
 {
-	system_time += tick_interval;
-//	dprintf("os_timer_tick %d\n", system_time);
+	return current_time_hires() / 1000;
+}
 
-	return t_callback(callback_arg, system_time);
+static enum handler_return timebase_tick(void *arg)
+{
+	*REG32(TIMER_REG(TIMEBASE_TIMER, TIMER_INTCLR)) = 1;
+	timebase_wraps++;
+
+	return INT_NO_RESCHEDULE;
 }
 
-void platform_init_timer(void)
+static enum handler_return os_timer_tick(void *arg)
 {
-#if 0
-	OS_TIMER_CTRL_REG = 0; // stop the timer if it's already running
+	*REG32(TIMER_REG(EVENT_TIMER, TIMER_INTCLR)) = 1;
 
-	register_int_handler(IRQ_OS_TIMER, &os_timer_tick, NULL);
-	unmask_interrupt(IRQ_OS_TIMER, NULL);
-#endif
+	if (t_callback) {
+		return t_callback(callback_arg, current_time());
+	} else {
+		return INT_NO_RESCHEDULE;
+	}
 }
 
+void platform_init_timer(void)
+{
+	// stop the timers if they're already running
+	*REG32(TIMER_REG(TIMEBASE_TIMER, TIMER_CONTROL)) = 0;
+	*REG32(TIMER_REG(EVENT_TIMER, TIMER_CONTROL)) = 0;
+
+	// start the free running timebase
+	timebase_wraps = 0;
+	*REG32(TIMER_REG(TIMEBASE_TIMER, TIMER_INTCLR)) = 1;
+	*REG32(TIMER_REG(TIMEBASE_TIMER, TIMER_LOAD)) = 0xffffffff;
+	*REG32(TIMER_REG(TIMEBASE_TIMER, TIMER_CONTROL)) = TIMER_CTRL_ENABLE | TIMER_CTRL_INTEN | TIMER_CTRL_32BIT | TIMER_CTRL_PERIODIC;
+
+	register_int_handler(INT_TIMER1, &timebase_tick, NULL);
+	register_int_handler(INT_TIMER2, &os_timer_tick, NULL);
+	unmask_interrupt(INT_TIMER1);
+	unmask_interrupt(INT_TIMER2);
+}
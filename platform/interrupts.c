@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <err.h>
+#include <debug.h>
+#include <assert.h>
+#include <malloc.h>
+#include <printf.h>
+#include <compiler.h>
+#include <kernel/thread.h>
+#include <kernel/event.h>
+#include <platform/interrupts.h>
+
+/*
+ * default implementations of these routines, for platforms without
+ * vectored interrupt handlers.
+ */
+
+__WEAK status_t mask_interrupt(unsigned int vector)
+{
+	return ERR_NOT_SUPPORTED;
+}
+
+__WEAK status_t unmask_interrupt(unsigned int vector)
+{
+	return ERR_NOT_SUPPORTED;
+}
+
+__WEAK void register_int_handler(unsigned int vector, int_handler handler, void *arg)
+{
+	panic("register_int_handler: platform has no interrupt handlers\n");
+}
+
+/*
+ * threaded interrupt handlers
+ *
+ * The top half runs in interrupt context. It calls the optional ack routine
+ * to quiet the device, masks the vector and wakes the handler thread. The
+ * thread runs the real handler with interrupts enabled, where it can be
+ * preempted by anything of higher priority, and unmasks the vector when
+ * the handler returns. Since the vector stays masked in between, the
+ * handler never runs concurrently with itself and a level triggered
+ * device can't storm while it is waiting to be serviced.
+ */
+struct int_thread {
+	unsigned int vector;
+	int_handler ack;
+	int_handler handler;
+	void *arg;
+
+	event_t event;
+	thread_t *thread;
+};
+
+static enum handler_return int_thread_top_half(void *arg)
+{
+	struct int_thread *it = (struct int_thread *)arg;
+
+	if (it->ack)
+		it->ack(it->arg);
+
+	mask_interrupt(it->vector);
+	event_signal(&it->event, false);
+
+	return INT_RESCHEDULE;
+}
+
+static int int_thread_entry(void *arg)
+{
+	struct int_thread *it = (struct int_thread *)arg;
+
+	for (;;) {
+		event_wait(&it->event);
+
+		it->handler(it->arg);
+
+		unmask_interrupt(it->vector);
+	}
+
+	return 0;
+}
+
+/**
+ * @brief  Register an interrupt handler that runs in its own thread
+ *
+ * @param vector   Interrupt vector
+ * @param ack      Called in interrupt context before the thread is woken,
+ *                 to acknowledge the device. May be NULL.
+ * @param handler  Called from the handler thread with interrupts enabled,
+ *                 its return value is ignored.
+ * @param arg      Passed to ack and handler
+ *
+ * The vector is left unmasked, as it would be after register_int_handler().
+ *
+ * @return  NO_ERROR on success, ERR_NO_MEMORY if the thread could not be created
+ */
+status_t register_threaded_int_handler(unsigned int vector, int_handler ack, int_handler handler, void *arg)
+{
+	struct int_thread *it;
+	char name[32];
+
+	DEBUG_ASSERT(handler);
+
+	it = malloc(sizeof(struct int_thread));
+	if (!it)
+		return ERR_NO_MEMORY;
+
+	it->vector = vector;
+	it->ack = ack;
+	it->handler = handler;
+	it->arg = arg;
+	event_init(&it->event, false, EVENT_FLAG_AUTOUNSIGNAL);
+	snprintf(name, sizeof(name), "irq %u", vector);
+
+	it->thread = thread_create(name, &int_thread_entry, it, HIGH_PRIORITY, DEFAULT_STACK_SIZE);
+	if (!it->thread) {
+		event_destroy(&it->event);
+		free(it);
+		return ERR_NO_MEMORY;
+	}
+	thread_resume(it->thread);
+
+	register_int_handler(vector, &int_thread_top_half, it);
+
+	return NO_ERROR;
+}
@@ -25,6 +25,7 @@
 #include <err.h>
 #include <reg.h>
 #include <kernel/thread.h>
+#include <kernel/ktrace.h>
 #include <platform/interrupts.h>
 #include <arch/ops.h>
 #include <arch/arm.h>
@@ -124,6 +125,7 @@ enum handler_return platform_irq(struct arm_iframe *frame)
 //	TRACEF("spsr 0x%x, pc 0x%x, currthread %p, vector %d, handler %p\n", frame->spsr, frame->pc, current_thread, vector, int_handler_table[vector].handler);
 
 	THREAD_STATS_INC(interrupts);
+	KTRACE(KTRACE_IRQ_ENTER, vector, 0);
 
 	// deliver the interrupt
 	enum handler_return ret; 
@@ -135,6 +137,8 @@ enum handler_return platform_irq(struct arm_iframe *frame)
 	// ack the interrupt
 	*REG32(INTC_CONTROL) = 0x1;
 
+	KTRACE(KTRACE_IRQ_EXIT, vector, ret);
+
 	return ret;
 }
 
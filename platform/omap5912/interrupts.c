@@ -25,6 +25,7 @@
 #include <debug.h>
 #include <reg.h>
 #include <kernel/thread.h>
+#include <kernel/ktrace.h>
 #include <platform/interrupts.h>
 #include <arch/ops.h>
 #include <arch/arm.h>
@@ -150,6 +151,8 @@ enum handler_return platform_irq(struct arm_iframe *frame)
 
 //	dprintf("platform_irq: spsr 0x%x, pc 0x%x, currthread %p, vector %d\n", frame->spsr, frame->pc, current_thread, vector);
 
+	KTRACE(KTRACE_IRQ_ENTER, vector, 0);
+
 	// deliver the interrupt
 	enum handler_return ret; 
 
@@ -157,6 +160,8 @@ enum handler_return platform_irq(struct arm_iframe *frame)
 	if (int_handler_table[vector].handler)
 		ret = int_handler_table[vector].handler(int_handler_table[vector].arg);
 
+	KTRACE(KTRACE_IRQ_EXIT, vector, ret);
+
 	// ack the interrupt
 	if (vector >= 32) {
 		// interrupt is chained, so ack the second level first, and then the first
@@ -29,7 +29,11 @@
 /* NOTE: keep arch/x86/crt0.S in sync with these definitions */
 
 /* interrupts */
+#if WITH_SMP
+#define INT_VECTORS 0x40
+#else
 #define INT_VECTORS 0x31
+#endif
 
 /* defined interrupts */
 #define INT_BASE			0x20
@@ -59,6 +63,11 @@
 
 #define INT_SYSCALL			0x30
 
+/* inter processor interrupts */
+#define INT_IPI_RESCHEDULE	0x31
+#define INT_IPI_TIMER		0x32
+#define INT_APIC_SPURIOUS	0x3f
+
 /* PIC remap bases */
 #define PIC1_BASE 0x20
 #define PIC2_BASE 0x28
@@ -26,6 +26,10 @@
 /* i8253/i8254 programmable interval timer registers */
 #define I8253_CONTROL_REG	0x43
 #define I8253_DATA_REG		0x40
+#define I8253_CHANNEL2_REG	0x42
+
+/* port B, gates PIT channel 2 and connects it to the speaker */
+#define PC_SPEAKER_CONTROL_REG	0x61
 
 /* i8042 keyboard controller registers */
 #define I8042_COMMAND_REG	0x64
@@ -25,6 +25,7 @@
 #include <err.h>
 #include <reg.h>
 #include <kernel/thread.h>
+#include <kernel/ktrace.h>
 #include <platform/interrupts.h>
 #include <arch/ops.h>
 #include <arch/x86.h>
@@ -202,6 +203,7 @@ enum handler_return platform_irq(struct x86_iframe *frame)
 	unsigned int vector = frame->vector;
 
 	THREAD_STATS_INC(interrupts);
+	KTRACE(KTRACE_IRQ_ENTER, vector, 0);
 
 	// deliver the interrupt	
 	enum handler_return ret = INT_NO_RESCHEDULE;
@@ -232,6 +234,8 @@ enum handler_return platform_irq(struct x86_iframe *frame)
 	// ack the interrupt
 	issueEOI(vector);
 
+	KTRACE(KTRACE_IRQ_EXIT, vector, ret);
+
 	return ret;
 }
 
@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <debug.h>
+#include <assert.h>
+#include <string.h>
+#include <reg.h>
+#include <kernel/thread.h>
+#include <platform.h>
+#include <platform/mp.h>
+#include <platform/interrupts.h>
+#include <platform/pc.h>
+#include <arch/x86.h>
+#include "platform_p.h"
+
+#if WITH_SMP
+
+/* local apic registers */
+#define LAPIC_ID			0x020
+#define LAPIC_TPR			0x080
+#define LAPIC_EOI			0x0b0
+#define LAPIC_SVR			0x0f0
+#define LAPIC_ICR_LOW		0x300
+#define LAPIC_ICR_HIGH		0x310
+#define LAPIC_LVT_LINT0		0x350
+#define LAPIC_LVT_LINT1		0x360
+
+#define LAPIC_SVR_ENABLE	(1 << 8)
+
+#define LAPIC_LVT_MASKED	(1 << 16)
+#define LAPIC_DM_FIXED		(0 << 8)
+#define LAPIC_DM_NMI		(4 << 8)
+#define LAPIC_DM_INIT		(5 << 8)
+#define LAPIC_DM_STARTUP	(6 << 8)
+#define LAPIC_DM_EXTINT		(7 << 8)
+
+#define LAPIC_ICR_PENDING		(1 << 12)
+#define LAPIC_ICR_ASSERT		(1 << 14)
+#define LAPIC_ICR_ALL_BUT_SELF	(3 << 18)
+
+#define MSR_APIC_BASE		0x1b
+#define CPUID_FEATURE_APIC	(1 << 9)
+
+/* where the AP trampoline is copied, must be page aligned and below 1MB */
+#define AP_TRAMPOLINE_ADDR	0x8000
+
+extern uint8_t x86_ap_trampoline[];
+extern uint8_t x86_ap_trampoline_end[];
+extern volatile int x86_ap_next_cpu;
+
+static addr_t lapic_base;
+
+#define LAPIC_REG(reg) REG32(lapic_base + (reg))
+
+static uint64_t rdmsr(uint32_t msr)
+{
+	uint32_t low, high;
+
+	__asm__ __volatile__ ("rdmsr" : "=a" (low), "=d" (high) : "c" (msr));
+	return ((uint64_t)high << 32) | low;
+}
+
+static uint lapic_id(void)
+{
+	return *LAPIC_REG(LAPIC_ID) >> 24;
+}
+
+static void lapic_eoi(void)
+{
+	*LAPIC_REG(LAPIC_EOI) = 0;
+}
+
+static void lapic_send_icr(uint apic_id, uint32_t low)
+{
+	*LAPIC_REG(LAPIC_ICR_HIGH) = apic_id << 24;
+	*LAPIC_REG(LAPIC_ICR_LOW) = low;
+
+	while (*LAPIC_REG(LAPIC_ICR_LOW) & LAPIC_ICR_PENDING)
+		;
+}
+
+static void lapic_enable(bool boot_cpu)
+{
+	*LAPIC_REG(LAPIC_TPR) = 0;
+
+	if (boot_cpu) {
+		/* the 8259 stays wired to the boot cpu, as in virtual wire mode */
+		*LAPIC_REG(LAPIC_LVT_LINT0) = LAPIC_DM_EXTINT;
+		*LAPIC_REG(LAPIC_LVT_LINT1) = LAPIC_DM_NMI;
+	} else {
+		*LAPIC_REG(LAPIC_LVT_LINT0) = LAPIC_LVT_MASKED;
+		*LAPIC_REG(LAPIC_LVT_LINT1) = LAPIC_LVT_MASKED;
+	}
+
+	*LAPIC_REG(LAPIC_SVR) = LAPIC_SVR_ENABLE | INT_APIC_SPURIOUS;
+
+	x86_percpu[arch_curr_cpu_num()].apic_id = lapic_id();
+}
+
+static enum handler_return ipi_reschedule(void *arg)
+{
+	lapic_eoi();
+
+	return INT_RESCHEDULE;
+}
+
+static enum handler_return ipi_timer(void *arg)
+{
+	lapic_eoi();
+
+	return thread_timer_tick();
+}
+
+void platform_mp_send_ipi(uint32_t cpu_mask, enum mp_ipi ipi)
+{
+	uint vector = (ipi == MP_IPI_TIMER) ? INT_IPI_TIMER : INT_IPI_RESCHEDULE;
+
+	DEBUG_ASSERT(in_critical_section());
+
+	while (cpu_mask) {
+		uint cpu = __builtin_ctz(cpu_mask);
+		cpu_mask &= ~(1U << cpu);
+
+		lapic_send_icr(x86_percpu[cpu].apic_id, LAPIC_ICR_ASSERT | LAPIC_DM_FIXED | vector);
+	}
+}
+
+void platform_mp_secondary_init(void)
+{
+	lapic_enable(false);
+}
+
+void platform_init_mp(void)
+{
+	uint32_t a, b, c, d;
+	size_t len = x86_ap_trampoline_end - x86_ap_trampoline;
+
+	x86_cpuid(1, &a, &b, &c, &d);
+	if (!(d & CPUID_FEATURE_APIC)) {
+		dprintf(INFO, "no local apic, staying on one cpu\n");
+		return;
+	}
+
+	lapic_base = rdmsr(MSR_APIC_BASE) & 0xfffff000;
+
+	register_int_handler(INT_IPI_RESCHEDULE, &ipi_reschedule, NULL);
+	register_int_handler(INT_IPI_TIMER, &ipi_timer, NULL);
+
+	enter_critical_section();
+	lapic_enable(true);
+	exit_critical_section();
+
+	ASSERT(len <= PAGE_SIZE);
+	memcpy((void *)AP_TRAMPOLINE_ADDR, x86_ap_trampoline, len);
+
+	/* INIT every other cpu, then send two STARTUPs pointing at the trampoline */
+	lapic_send_icr(0, LAPIC_ICR_ALL_BUT_SELF | LAPIC_ICR_ASSERT | LAPIC_DM_INIT);
+	spin(10000);
+
+	int i;
+	for (i = 0; i < 2; i++) {
+		lapic_send_icr(0, LAPIC_ICR_ALL_BUT_SELF | LAPIC_ICR_ASSERT | LAPIC_DM_STARTUP | (AP_TRAMPOLINE_ADDR >> 12));
+		spin(200);
+	}
+
+	/* give them a moment to check in */
+	thread_sleep(100);
+
+	int online = 0;
+	for (i = 0; i < SMP_MAX_CPUS; i++) {
+		if (mp_active_cpus & (1U << i))
+			online++;
+	}
+
+	dprintf(INFO, "%d cpus online (%d found, max %d)\n", online, x86_ap_next_cpu, SMP_MAX_CPUS);
+}
+
+#endif
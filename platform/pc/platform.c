@@ -24,6 +24,7 @@
 #include <debug.h>
 #include <arch/x86/mmu.h>
 #include <platform.h>
+#include <lib/heap.h>
 #include "platform_p.h"
 #include <platform/pc.h>
 #include <platform/multiboot.h>
@@ -34,6 +35,7 @@
 
 extern multiboot_info_t *_multiboot_info;
 extern unsigned int _heap_end;
+extern int _end;
 
 void platform_init_mmu_mappings(void)
 {
@@ -41,6 +43,12 @@ void platform_init_mmu_mappings(void)
 }
 
 
+/* memory below this is left to the bios and the smp trampoline */
+#define PC_HIGHMEM_START 0x100000
+
+/* regions at least this big are tagged as room for large buffers */
+#define PC_LARGE_REGION (16 * 1024 * 1024)
+
 void platform_init_multiboot_info(void)
 {
 	unsigned int i;
@@ -59,15 +67,30 @@ void platform_init_multiboot_info(void)
 				dprintf(DEBUG, "base=%08x, length=%08x, type=%02x\n",
 					mmap[i].base_addr_low, mmap[i].length_low, mmap[i].type);
 				
-				if (mmap[i].type == MB_MMAP_TYPE_AVAILABLE && mmap[i].base_addr_low >= _heap_end) {
-					_heap_end = mmap[i].base_addr_low + mmap[i].length_low;
-				} else if (mmap[i].type != MB_MMAP_TYPE_AVAILABLE && mmap[i].base_addr_low >= _heap_end) {
-					/* 
-					 * break on first memory hole above default heap end for now.
-					 * later we can add facilities for adding free chunks to the
-					 * heap for each segregated memory region.
-					 */
-					 break;
+				/* we can only reach the bottom 4GB */
+				if (mmap[i].type != MB_MMAP_TYPE_AVAILABLE || mmap[i].base_addr_high != 0)
+					continue;
+
+				addr_t base = mmap[i].base_addr_low;
+				addr_t end = base + mmap[i].length_low;
+				if (mmap[i].length_high != 0 || end < base)
+					end = ~(addr_t)0;
+
+				if (end <= PC_HIGHMEM_START)
+					continue;
+				if (base < PC_HIGHMEM_START)
+					base = PC_HIGHMEM_START;
+
+				if (base <= (addr_t)&_end && end > (addr_t)&_end) {
+					/* the range the kernel was loaded into is the main heap */
+					_heap_end = end;
+				} else {
+					/* every other usable range becomes a heap region of its own */
+					uint flags = HEAP_REGION_DMA;
+					if (end - base >= PC_LARGE_REGION)
+						flags |= HEAP_REGION_LARGE;
+
+					heap_add_region((void *)base, end - base, flags);
 				}
 			}
 		}
@@ -98,5 +121,10 @@ void platform_init(void)
 	platform_init_keyboard();
 	
 	pci_init();
+
+#if WITH_SMP
+	/* start the other cpus now that the rest of the kernel is up */
+	platform_init_mp();
+#endif
 }
 
@@ -26,6 +26,7 @@
 void platform_init_interrupts(void);
 void platform_init_timer(void);
 void platform_init_uart(void);
+void platform_init_mp(void);
 
 #endif
 
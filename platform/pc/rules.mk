@@ -16,7 +16,12 @@ OBJS += \
 	$(LOCAL_DIR)/debug.o \
 	$(LOCAL_DIR)/console.o \
 	$(LOCAL_DIR)/keyboard.o \
-	$(LOCAL_DIR)/pci.o
+	$(LOCAL_DIR)/pci.o \
+	$(LOCAL_DIR)/mp.o
+
+DEFINES += \
+	PLATFORM_HAS_DYNAMIC_TIMER=1 \
+	PLATFORM_HAS_HIRES_TIMER=1
 
 LINKER_SCRIPT += \
 	$(BUILDDIR)/kernel.ld
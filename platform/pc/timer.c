@@ -36,16 +36,131 @@
 static platform_timer_callback t_callback;
 static void *callback_arg;
 
+/*
+ * all times are kept in 32.32 fixed point ms.
+ *
+ * PIT channel 2 free runs as a rate generator over the whole 16 bit range
+ * and is the clock: every read adds the counts since the previous read to
+ * clock_secs/clock_counts, which only has to happen more often than the counter
+ * wraps (~55ms). Channel 0 runs in one-shot mode (mode 0) and is only used
+ * to get an interrupt when the next trigger is due. Its intervals are
+ * capped well short of the channel 2 wrap so the interrupt also keeps the
+ * clock read often enough on an idle system. Reprogramming channel 0 never
+ * touches the clock, so interrupt latency can't make it drift.
+ */
 static uint64_t next_trigger_time;
 static uint64_t next_trigger_delta;
+static bool trigger_armed;
 
-static uint64_t timer_delta_time;
-static uint64_t timer_current_time;
-
-static uint16_t divisor;
+static uint64_t clock_secs;
+static uint32_t clock_counts;	/* PIT counts into the current second */
+static uint16_t clock_last_count;
 
 #define INTERNAL_FREQ 1193182ULL
-#define INTERNAL_FREQ_3X 3579546ULL
+
+/* half the channel 2 period, ~27ms, so a late interrupt still reads the clock in time */
+#define MAX_INTERVAL_COUNT 0x8000
+
+/* the longest one-shot interval in usecs we convert in one go, ~4.5 minutes */
+#define MAX_HIRES_INTERVAL 0x0fffffffULL
+
+/* the time in 32.32 fixed point ms that a number of PIT counts represents */
+static inline uint64_t pit_counts_to_time(uint32_t count)
+{
+	return (3685982306ULL * count) >> 10;
+}
+
+static uint16_t time_to_pit_counts(uint64_t delta)
+{
+	uint64_t count;
+
+	if (delta >= pit_counts_to_time(MAX_INTERVAL_COUNT))
+		return MAX_INTERVAL_COUNT;
+
+	count = (((delta >> 10) * INTERNAL_FREQ) / 1000) >> 22;
+	if (count == 0)
+		count = 1;
+
+	return count;
+}
+
+static void start_pit_clock(void)
+{
+	/* gate channel 2 on, with its output kept off the speaker */
+	outp(PC_SPEAKER_CONTROL_REG, (inp(PC_SPEAKER_CONTROL_REG) & ~0x02) | 0x01);
+
+	/*
+	 * timer 2, mode 2, binary counter, LSB followed by MSB
+	 * a count of 0 is the full 65536
+	 */
+	outp(I8253_CONTROL_REG, 0xb4);
+	outp(I8253_CHANNEL2_REG, 0);
+	outp(I8253_CHANNEL2_REG, 0);
+
+	clock_secs = 0;
+	clock_counts = 0;
+	clock_last_count = 0;
+}
+
+/* bring the clock up to date, inside a critical section */
+static uint64_t read_pit_clock(void)
+{
+	uint16_t count;
+
+	/* latch channel 2 */
+	outp(I8253_CONTROL_REG, 0x80);
+	count = inp(I8253_CHANNEL2_REG);
+	count |= inp(I8253_CHANNEL2_REG) << 8;
+
+	/* it counts down, and wraps modulo 65536 */
+	clock_counts += (uint16_t)(clock_last_count - count);
+	clock_last_count = count;
+
+	/* carry whole seconds out so the conversion can't overflow */
+	if (clock_counts >= INTERNAL_FREQ) {
+		clock_counts -= INTERNAL_FREQ;
+		clock_secs++;
+	}
+
+	return ((clock_secs * 1000) << 32) + pit_counts_to_time(clock_counts);
+}
+
+static void program_pit_oneshot(uint16_t count)
+{
+	/*
+	 * setup the Programmable Interval Timer
+	 * timer 0, mode 0, binary counter, LSB followed by MSB
+	 */
+	outp(I8253_CONTROL_REG, 0x30);
+	outp(I8253_DATA_REG, count & 0xff); // LSB
+	outp(I8253_DATA_REG, count >> 8); // MSB
+}
+
+static uint64_t get_current_time(void)
+{
+	uint64_t time;
+
+	enter_critical_section();
+	time = read_pit_clock();
+	exit_critical_section();
+
+	return time;
+}
+
+/* start a new hardware interval, running until the next trigger or the maximum interval */
+static void reprogram_interval(uint64_t now)
+{
+	uint16_t count = MAX_INTERVAL_COUNT;
+
+	if (trigger_armed) {
+		if (next_trigger_time > now)
+			count = time_to_pit_counts(next_trigger_time - now);
+		else
+			count = 1;
+	}
+
+	program_pit_oneshot(count);
+}
 
 status_t platform_set_periodic_timer(platform_timer_callback callback, void *arg, time_t interval)
 {
@@ -53,107 +168,107 @@ status_t platform_set_periodic_timer(platform_timer_callback callback, void *arg
 
 	t_callback = callback;
 	callback_arg = arg;
-	
+
+	uint64_t now = read_pit_clock();
+
 	next_trigger_delta = (uint64_t) interval << 32;
-	next_trigger_time = timer_current_time + next_trigger_delta;
+	next_trigger_time = now + next_trigger_delta;
+	trigger_armed = true;
+
+	reprogram_interval(now);
 
 	exit_critical_section();
 
 	return NO_ERROR;
 }
 
-time_t current_time(void)
+static void set_oneshot_trigger(platform_timer_callback callback, void *arg, uint64_t delta)
 {
-	time_t time;
-	
 	enter_critical_section();
-	time = (time_t) (timer_current_time >> 32);
+
+	t_callback = callback;
+	callback_arg = arg;
+
+	uint64_t now = read_pit_clock();
+
+	next_trigger_delta = 0;
+	next_trigger_time = now + delta;
+	trigger_armed = true;
+
+	reprogram_interval(now);
+
 	exit_critical_section();
-	
-	return time;
 }
 
-bigtime_t current_time_hires(void)
+status_t platform_set_oneshot_timer(platform_timer_callback callback, void *arg, time_t interval)
+{
+	set_oneshot_trigger(callback, arg, (uint64_t) interval << 32);
+
+	return NO_ERROR;
+}
+
+/* the PIT counts at ~1.19MHz, so intervals are honored to about a usec */
+status_t platform_set_oneshot_timer_hires(platform_timer_callback callback, void *arg, bigtime_t interval)
+{
+	/* keep the conversion from overflowing, a longer wait just takes an extra interrupt */
+	if (interval > MAX_HIRES_INTERVAL)
+		interval = MAX_HIRES_INTERVAL;
+
+	/* usecs to 32.32 fixed point ms, 2^42 / 1000 = 4398046511 */
+	set_oneshot_trigger(callback, arg, (interval * 4398046511ULL) >> 10);
+
+	return NO_ERROR;
+}
+
+void platform_stop_timer(void)
 {
-	bigtime_t time;
-	
 	enter_critical_section();
-	time = (bigtime_t) ((timer_current_time >> 22) * 1000) >> 10;
+
+	/* keep the counter ticking over so we still keep time, but stop calling back */
+	trigger_armed = false;
+
 	exit_critical_section();
-	
-	return time;
 }
-static enum handler_return os_timer_tick(void *arg)
+
+time_t current_time(void)
 {
-	uint64_t delta;
-	
-	timer_current_time += timer_delta_time;
-	
-	time_t time = current_time();
-	//bigtime_t btime = current_time_hires();
-	//printf_xy(71, 0, WHITE, "%08u", (uint32_t) time);
-	//printf_xy(63, 1, WHITE, "%016llu", (uint64_t) btime);
-	
-	if (t_callback && timer_current_time >= next_trigger_time) {
-		delta = timer_current_time - next_trigger_time;
-		next_trigger_time = timer_current_time + next_trigger_delta - delta;
-		
-		return t_callback(callback_arg, time);
-	} else {
-		return INT_NO_RESCHEDULE;
-	}
+	return (time_t) (get_current_time() >> 32);
 }
 
-static void set_pit_frequency(uint32_t frequency)
+bigtime_t current_time_hires(void)
 {
-	uint32_t count, remainder;
-	
-	/* figure out the correct divisor for the desired frequency */
-	if (frequency <= 18) {
-		count = 0xffff;
-	} else if (frequency >= INTERNAL_FREQ) {
-		count = 1;
-	} else {
-		count = INTERNAL_FREQ_3X / frequency;
-		remainder = INTERNAL_FREQ_3X % frequency;
-		
-		if (remainder >= INTERNAL_FREQ_3X / 2) {
-			count += 1;
-		}
-		
-		count /= 3;
-		remainder = count % 3;
-		
-		if (remainder >= 1) {
-			count += 1;
-		}
+	return (bigtime_t) ((get_current_time() >> 22) * 1000) >> 10;
+}
+
+static enum handler_return os_timer_tick(void *arg)
+{
+	bool fire = false;
+
+	uint64_t now = read_pit_clock();
+
+	if (trigger_armed && now >= next_trigger_time) {
+		fire = true;
+		if (next_trigger_delta != 0)
+			next_trigger_time += next_trigger_delta;
+		else
+			trigger_armed = false;
 	}
-		
-	divisor = count & 0xffff;
-	
-	/*
-	 * funky math that i don't feel like explaining. essentially 32.32 fixed
-	 * point representation of the configured timer delta.
-	 */
-	timer_delta_time = (3685982306ULL * count) >> 10;
-	
-	//dprintf(DEBUG, "set_pit_frequency: dt=%016llx\n", timer_delta_time);
-	//dprintf(DEBUG, "set_pit_frequency: divisor=%04x\n", divisor);
-	
-	/*
-	 * setup the Programmable Interval Timer
-	 * timer 0, mode 2, binary counter, LSB followed by MSB
-	 */
-	outp(I8253_CONTROL_REG, 0x34);
-	outp(I8253_DATA_REG, divisor & 0xff); // LSB
-	outp(I8253_DATA_REG, divisor >> 8); // MSB
+
+	/* start the next interval before calling back, which may rearm us again */
+	reprogram_interval(now);
+
+	if (fire && t_callback)
+		return t_callback(callback_arg, (time_t) (now >> 32));
+
+	return INT_NO_RESCHEDULE;
 }
 
 void platform_init_timer(void)
 {
-	timer_current_time = 0;
-	
-	set_pit_frequency(1000); // ~1ms granularity
+	trigger_armed = false;
+
+	start_pit_clock();
+	program_pit_oneshot(MAX_INTERVAL_COUNT);
 
 	register_int_handler(INT_PIT, &os_timer_tick, NULL);
 	unmask_interrupt(INT_PIT);
@@ -163,4 +278,3 @@ void platform_halt_timers(void)
 {
 	mask_interrupt(INT_PIT);
 }
-
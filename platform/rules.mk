@@ -3,5 +3,6 @@ LOCAL_DIR := $(GET_LOCAL_DIR)
 # shared platform code
 OBJS += \
 	$(LOCAL_DIR)/debug.o \
-	$(LOCAL_DIR)/init.o
+	$(LOCAL_DIR)/init.o \
+	$(LOCAL_DIR)/interrupts.o
 
@@ -0,0 +1,19 @@
+# top level project rules for the pc-x86-debug project
+# the pc-x86-test build with the optional scheduler, tracing and profiling code turned on
+#
+LOCAL_DIR := $(GET_LOCAL_DIR)
+
+TARGET := pc-x86
+MODULES += \
+	app/tests \
+	app/shell \
+	app/pcitests
+
+HEAP_IMPLEMENTATION := tlsf
+
+DEFINES += \
+	WITH_EDF=1 \
+	WITH_KTRACE=1 \
+	WITH_LOCK_PROFILING=1 \
+	WITH_IRQOFF_TRACE=1 \
+	WITH_HEAP_PROFILE=1
@@ -0,0 +1,12 @@
+# top level project rules for the pc-x86-smp-test project
+#
+LOCAL_DIR := $(GET_LOCAL_DIR)
+
+TARGET := pc-x86
+MODULES += \
+	app/tests \
+	app/shell
+
+DEFINES += \
+	WITH_SMP=1 \
+	SMP_MAX_CPUS=4